@@ -173,6 +173,18 @@ static inline u32 swap32(u32 v)
     (*((u32 *)x) = (v))
 #endif
 
+// Building with MULTI_INSTANCE gives every thread its own copy of the
+// emulation state, so that several instances can run side by side in one
+// process; it needs C++11 thread_local and the V8 cores.
+#ifdef MULTI_INSTANCE
+# if defined(USE_GBA_CORE_V7) || defined(USE_GB_CORE_V7)
+#  error MULTI_INSTANCE is only supported by the V8 cores
+# endif
+# define INSTANCE_LOCAL thread_local
+#else
+# define INSTANCE_LOCAL
+#endif
+
 #ifndef CTASSERT
 #define CTASSERT(x)  typedef char __assert ## y[(x) ? 1 : -1];
 #endif
@@ -0,0 +1,201 @@
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLOR_CONVERT_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "ColorConvert.h"
+#include "System.h"
+
+bool colorMapPlain = false;
+
+static inline u32 colorPlain(u32 c)
+{
+	return ((c & 0x1f) << systemRedShift) |
+	       (((c >> 5) & 0x1f) << systemGreenShift) |
+	       (((c >> 10) & 0x1f) << systemBlueShift);
+}
+
+#ifdef COLOR_CONVERT_SSE2
+static inline __m128i colorPlain16x8(__m128i c, __m128i rs, __m128i gs, __m128i bs)
+{
+	const __m128i mask = _mm_set1_epi16(0x1f);
+	__m128i r = _mm_and_si128(c, mask);
+	__m128i g = _mm_and_si128(_mm_srli_epi16(c, 5), mask);
+	__m128i b = _mm_and_si128(_mm_srli_epi16(c, 10), mask);
+	return _mm_or_si128(_mm_or_si128(_mm_sll_epi16(r, rs), _mm_sll_epi16(g, gs)), _mm_sll_epi16(b, bs));
+}
+
+static inline __m128i colorPlain32x4(__m128i c, __m128i rs, __m128i gs, __m128i bs)
+{
+	const __m128i mask = _mm_set1_epi32(0x1f);
+	__m128i r = _mm_and_si128(c, mask);
+	__m128i g = _mm_and_si128(_mm_srli_epi32(c, 5), mask);
+	__m128i b = _mm_and_si128(_mm_srli_epi32(c, 10), mask);
+	return _mm_or_si128(_mm_or_si128(_mm_sll_epi32(r, rs), _mm_sll_epi32(g, gs)), _mm_sll_epi32(b, bs));
+}
+#endif
+
+#ifdef __AVX2__
+static inline __m256i colorPlain32x8(__m256i c, __m128i rs, __m128i gs, __m128i bs)
+{
+	const __m256i mask = _mm256_set1_epi32(0x1f);
+	__m256i r = _mm256_and_si256(c, mask);
+	__m256i g = _mm256_and_si256(_mm256_srli_epi32(c, 5), mask);
+	__m256i b = _mm256_and_si256(_mm256_srli_epi32(c, 10), mask);
+	return _mm256_or_si256(_mm256_or_si256(_mm256_sll_epi32(r, rs), _mm256_sll_epi32(g, gs)), _mm256_sll_epi32(b, bs));
+}
+#endif
+
+template <class T>
+static inline void colorConvertRest16(u16 *dest, const T *src, int x, int count)
+{
+	if (colorMapPlain)
+	{
+		for (; x < count; x++)
+			dest[x] = colorPlain(src[x]);
+	}
+	else
+	{
+		for (; x < count; x++)
+			dest[x] = systemColorMap16[src[x] & 0xFFFF];
+	}
+}
+
+template <class T>
+static inline void colorConvertRest32(u32 *dest, const T *src, int x, int count)
+{
+	if (colorMapPlain)
+	{
+		for (; x < count; x++)
+			dest[x] = colorPlain(src[x]);
+	}
+	else
+	{
+		for (; x < count; x++)
+			dest[x] = systemColorMap32[src[x] & 0xFFFF];
+	}
+}
+
+template <class T>
+static inline void colorConvert24(u8 *dest, const T *src, int count)
+{
+	if (colorMapPlain)
+	{
+		for (int x = 0; x < count; x++, dest += 3)
+			*((u32 *)dest) = colorPlain(src[x]);
+	}
+	else
+	{
+		for (int x = 0; x < count; x++, dest += 3)
+			*((u32 *)dest) = systemColorMap32[src[x] & 0xFFFF];
+	}
+}
+
+void colorConvertLine16(u16 *dest, const u16 *src, int count)
+{
+	int x = 0;
+#ifdef COLOR_CONVERT_SSE2
+	if (colorMapPlain)
+	{
+		__m128i rs = _mm_cvtsi32_si128(systemRedShift);
+		__m128i gs = _mm_cvtsi32_si128(systemGreenShift);
+		__m128i bs = _mm_cvtsi32_si128(systemBlueShift);
+		for (; x + 8 <= count; x += 8)
+		{
+			__m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+			_mm_storeu_si128((__m128i *)&dest[x], colorPlain16x8(c, rs, gs, bs));
+		}
+	}
+#endif
+	colorConvertRest16(dest, src, x, count);
+}
+
+void colorConvertLine16(u16 *dest, const u32 *src, int count)
+{
+	int x = 0;
+#ifdef COLOR_CONVERT_SSE2
+	if (colorMapPlain)
+	{
+		__m128i rs	 = _mm_cvtsi32_si128(systemRedShift);
+		__m128i gs	 = _mm_cvtsi32_si128(systemGreenShift);
+		__m128i bs	 = _mm_cvtsi32_si128(systemBlueShift);
+		__m128i mask = _mm_set1_epi32(0x7fff);
+		for (; x + 8 <= count; x += 8)
+		{
+			// bit 15 doesn't matter, and without it the signed pack can't saturate
+			__m128i lo = _mm_and_si128(_mm_loadu_si128((const __m128i *)&src[x]), mask);
+			__m128i hi = _mm_and_si128(_mm_loadu_si128((const __m128i *)&src[x + 4]), mask);
+			_mm_storeu_si128((__m128i *)&dest[x], colorPlain16x8(_mm_packs_epi32(lo, hi), rs, gs, bs));
+		}
+	}
+#endif
+	colorConvertRest16(dest, src, x, count);
+}
+
+void colorConvertLine24(u8 *dest, const u16 *src, int count)
+{
+	colorConvert24(dest, src, count);
+}
+
+void colorConvertLine24(u8 *dest, const u32 *src, int count)
+{
+	colorConvert24(dest, src, count);
+}
+
+void colorConvertLine32(u32 *dest, const u16 *src, int count)
+{
+	int x = 0;
+#ifdef COLOR_CONVERT_SSE2
+	if (colorMapPlain)
+	{
+		__m128i rs = _mm_cvtsi32_si128(systemRedShift);
+		__m128i gs = _mm_cvtsi32_si128(systemGreenShift);
+		__m128i bs = _mm_cvtsi32_si128(systemBlueShift);
+#ifdef __AVX2__
+		for (; x + 8 <= count; x += 8)
+		{
+			__m256i c = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&src[x]));
+			_mm256_storeu_si256((__m256i *)&dest[x], colorPlain32x8(c, rs, gs, bs));
+		}
+#else
+		__m128i zero = _mm_setzero_si128();
+		for (; x + 8 <= count; x += 8)
+		{
+			__m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+			_mm_storeu_si128((__m128i *)&dest[x], colorPlain32x4(_mm_unpacklo_epi16(c, zero), rs, gs, bs));
+			_mm_storeu_si128((__m128i *)&dest[x + 4], colorPlain32x4(_mm_unpackhi_epi16(c, zero), rs, gs, bs));
+		}
+#endif
+	}
+#endif
+	colorConvertRest32(dest, src, x, count);
+}
+
+void colorConvertLine32(u32 *dest, const u32 *src, int count)
+{
+	int x = 0;
+#ifdef COLOR_CONVERT_SSE2
+	if (colorMapPlain)
+	{
+		__m128i rs = _mm_cvtsi32_si128(systemRedShift);
+		__m128i gs = _mm_cvtsi32_si128(systemGreenShift);
+		__m128i bs = _mm_cvtsi32_si128(systemBlueShift);
+#ifdef __AVX2__
+		for (; x + 8 <= count; x += 8)
+		{
+			__m256i c = _mm256_loadu_si256((const __m256i *)&src[x]);
+			_mm256_storeu_si256((__m256i *)&dest[x], colorPlain32x8(c, rs, gs, bs));
+		}
+#endif
+		for (; x + 4 <= count; x += 4)
+		{
+			__m128i c = _mm_loadu_si128((const __m128i *)&src[x]);
+			_mm_storeu_si128((__m128i *)&dest[x], colorPlain32x4(c, rs, gs, bs));
+		}
+	}
+#endif
+	colorConvertRest32(dest, src, x, count);
+}
@@ -0,0 +1,26 @@
+#ifndef VBA_COLORCONVERT_H
+#define VBA_COLORCONVERT_H
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include "../Port.h"
+
+// Set by utilUpdateSystemColorMaps() while systemColorMap16/32 hold nothing
+// but the shifts by systemRed/Green/BlueShift, so that the conversion can be
+// computed instead of looked up. Frontends filling the maps with their own
+// colours (gamma, LCD filters) must leave it false.
+extern bool colorMapPlain;
+
+// Convert count BGR555 pixels into the frontend's format at dest, which can
+// be any line of any frame buffer. The 24-bit version stores 4 bytes per
+// pixel and so writes one byte past the line.
+extern void colorConvertLine16(u16 *dest, const u16 *src, int count);
+extern void colorConvertLine16(u16 *dest, const u32 *src, int count);
+extern void colorConvertLine24(u8 *dest, const u16 *src, int count);
+extern void colorConvertLine24(u8 *dest, const u32 *src, int count);
+extern void colorConvertLine32(u32 *dest, const u16 *src, int count);
+extern void colorConvertLine32(u32 *dest, const u32 *src, int count);
+
+#endif // VBA_COLORCONVERT_H
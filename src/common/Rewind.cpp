@@ -0,0 +1,318 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "SystemGlobals.h"
+#include "Rewind.h"
+
+#define REWIND_STATE_SIZE_MIN 0x80000
+#define REWIND_STATE_SIZE_MAX 0x1000000
+
+struct RewindEntry
+{
+	int offset;
+	int length;
+	int stateSize;  // size of the snapshot the delta leads back to
+};
+
+static INSTANCE_LOCAL u8		   *rewindState		 = NULL; // latest snapshot
+static INSTANCE_LOCAL u8		   *rewindNext		 = NULL; // snapshot being taken
+static INSTANCE_LOCAL bool			rewindNextValid	 = false; // rewindNext holds the previous snapshot taken
+static INSTANCE_LOCAL u8		   *rewindDelta		 = NULL; // encoded delta being stored
+static INSTANCE_LOCAL int			rewindStateSize	 = 0;
+static INSTANCE_LOCAL int			rewindCapacity	 = 0;
+static INSTANCE_LOCAL u8		   *rewindRing		 = NULL;
+static INSTANCE_LOCAL int			rewindRingSize	 = 0;
+static INSTANCE_LOCAL RewindEntry *rewindEntries	 = NULL;
+static INSTANCE_LOCAL int			rewindMaxEntries = 0;
+static INSTANCE_LOCAL int			rewindFirst		 = 0;
+static INSTANCE_LOCAL int			rewindCount		 = 0;
+
+// worst case of rewindEncode(): one unchanged word between changed ones
+static inline int rewindDeltaBound(int length)
+{
+	return length + length / 2 + 16;
+}
+
+static u8 *rewindPutLength(u8 *p, u32 value)
+{
+	while (value >= 0x80)
+	{
+		*p++	= (u8)(value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (u8)value;
+	return p;
+}
+
+static const u8 *rewindGetLength(const u8 *p, u32 &value)
+{
+	int shift = 0;
+	value = 0;
+	do
+	{
+		value |= (u32)(*p & 0x7F) << shift;
+		shift += 7;
+	}
+	while (*p++ & 0x80);
+	return p;
+}
+
+// Encodes a ^ b as runs of unchanged words followed by runs of changed words,
+// the latter stored as the XOR of both; length is a multiple of 4
+static int rewindEncode(u8 *out, const u8 *a, const u8 *b, int length)
+{
+	const u32 *wa	 = (const u32 *)a;
+	const u32 *wb	 = (const u32 *)b;
+	int		   words = length >> 2;
+	u8		  *p	 = out;
+
+	int i = 0;
+	while (i < words)
+	{
+		int start = i;
+		while (i < words && wa[i] == wb[i])
+			i++;
+		if (i == words)
+			break;
+
+		int same = i - start;
+		start = i;
+		while (i < words && wa[i] != wb[i])
+			i++;
+
+		p = rewindPutLength(p, same);
+		p = rewindPutLength(p, i - start);
+		for (int j = start; j < i; j++)
+		{
+			u32 diff = wa[j] ^ wb[j];
+			memcpy(p, &diff, 4);
+			p += 4;
+		}
+	}
+
+	return p - out;
+}
+
+static void rewindDecode(u8 *state, const u8 *delta, int length)
+{
+	u32		 *w	  = (u32 *)state;
+	const u8 *end = delta + length;
+
+	while (delta < end)
+	{
+		u32 same, changed;
+		delta = rewindGetLength(delta, same);
+		delta = rewindGetLength(delta, changed);
+		w	 += same;
+		while (changed--)
+		{
+			u32 diff;
+			memcpy(&diff, delta, 4);
+			*w++  ^= diff;
+			delta += 4;
+		}
+	}
+}
+
+static bool rewindGrow()
+{
+	int capacity = rewindCapacity ? rewindCapacity * 2 : REWIND_STATE_SIZE_MIN;
+	if (capacity > REWIND_STATE_SIZE_MAX)
+		return false;
+
+	u8 *state = (u8 *)realloc(rewindState, capacity);
+	if (state == NULL)
+		return false;
+	rewindState = state;
+
+	u8 *next = (u8 *)realloc(rewindNext, capacity);
+	if (next == NULL)
+		return false;
+	rewindNext		= next;
+	rewindNextValid = false;
+
+	u8 *delta = (u8 *)realloc(rewindDelta, rewindDeltaBound(capacity));
+	if (delta == NULL)
+		return false;
+	rewindDelta = delta;
+
+	rewindCapacity = capacity;
+	return true;
+}
+
+static inline RewindEntry &rewindEntry(int index)
+{
+	return rewindEntries[(rewindFirst + index) % rewindMaxEntries];
+}
+
+static void rewindDropOldest()
+{
+	rewindFirst = (rewindFirst + 1) % rewindMaxEntries;
+	rewindCount--;
+}
+
+// Places the delta after the newest one, wrapping to the start of the ring
+// when it doesn't fit; the oldest deltas in the way are dropped.
+static void rewindStore(const u8 *delta, int length, int stateSize)
+{
+	if (rewindMaxEntries == 0)
+		return;
+	if (length > rewindRingSize)
+	{
+		// the older snapshots can't be reached anymore
+		rewindCount = 0;
+		return;
+	}
+	if (rewindCount == rewindMaxEntries)
+		rewindDropOldest();
+
+	int start = 0;
+	if (rewindCount)
+	{
+		RewindEntry &newest = rewindEntry(rewindCount - 1);
+		start = newest.offset + newest.length;
+	}
+	if (start + length > rewindRingSize)
+	{
+		while (rewindCount && rewindEntry(0).offset >= start)
+			rewindDropOldest();
+		start = 0;
+	}
+	while (rewindCount && rewindEntry(0).offset >= start && rewindEntry(0).offset < start + length)
+		rewindDropOldest();
+
+	RewindEntry &entry = rewindEntry(rewindCount++);
+	entry.offset	= start;
+	entry.length	= length;
+	entry.stateSize = stateSize;
+	memcpy(rewindRing + start, delta, length);
+}
+
+bool rewindInit(int bufferSize, int maxSnapshots)
+{
+	rewindCleanUp();
+
+	if (bufferSize <= 0 || maxSnapshots <= 0)
+		return false;
+
+	rewindRing = (u8 *)malloc(bufferSize);
+	if (rewindRing == NULL)
+		return false;
+	rewindRingSize = bufferSize;
+
+	// the latest snapshot isn't kept in the ring
+	rewindMaxEntries = maxSnapshots - 1;
+	if (rewindMaxEntries)
+	{
+		rewindEntries = (RewindEntry *)malloc(rewindMaxEntries * sizeof(RewindEntry));
+		if (rewindEntries == NULL)
+		{
+			rewindCleanUp();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void rewindCleanUp()
+{
+	free(rewindState);
+	free(rewindNext);
+	free(rewindDelta);
+	free(rewindRing);
+	free(rewindEntries);
+	rewindState		 = NULL;
+	rewindNext		 = NULL;
+	rewindDelta		 = NULL;
+	rewindRing		 = NULL;
+	rewindEntries	 = NULL;
+	rewindCapacity	 = 0;
+	rewindRingSize	 = 0;
+	rewindMaxEntries = 0;
+	rewindNextValid	 = false;
+	rewindClear();
+}
+
+void rewindClear()
+{
+	rewindStateSize = 0;
+	rewindFirst		= 0;
+	rewindCount		= 0;
+}
+
+bool rewindSave(const EmulatedSystem &emulator)
+{
+	if (rewindRing == NULL || emulator.emuWriteMemStateRaw == NULL)
+		return false;
+
+	if (rewindCapacity == 0 && !rewindGrow())
+		return false;
+
+	// rewindNext is only written by this function, so while it still holds the
+	// previous snapshot the emulator only has to copy what changed since
+	int (*write)(char *, int) = emulator.emuWriteMemStateRaw;
+	if (rewindNextValid && emulator.emuWriteMemStateIncremental)
+		write = emulator.emuWriteMemStateIncremental;
+
+	int size;
+	while ((size = write((char *)rewindNext, rewindCapacity)) == 0)
+	{
+		rewindNextValid = false;
+		if (!rewindGrow())
+			return false;
+		write = emulator.emuWriteMemStateRaw;
+	}
+	rewindNextValid = true;
+
+	if (rewindStateSize)
+	{
+		// both snapshots are compared up to the end of the larger one
+		int length = ((size > rewindStateSize ? size : rewindStateSize) + 3) & ~3;
+		memset(rewindNext + size, 0, length - size);
+		memset(rewindState + rewindStateSize, 0, length - rewindStateSize);
+
+		int deltaLength = rewindEncode(rewindDelta, rewindNext, rewindState, length);
+		rewindStore(rewindDelta, deltaLength, rewindStateSize);
+
+		// the delta also turns the latest snapshot into the new one
+		rewindDecode(rewindState, rewindDelta, deltaLength);
+	}
+	else
+		memcpy(rewindState, rewindNext, size);
+	rewindStateSize = size;
+
+	return true;
+}
+
+// Loads the latest snapshot, then steps back so that the next call loads the
+// one before it
+bool rewindLoad(const EmulatedSystem &emulator)
+{
+	if (rewindStateSize == 0 || emulator.emuReadMemStateRaw == NULL)
+		return false;
+
+	if (!emulator.emuReadMemStateRaw((char *)rewindState, rewindStateSize))
+		return false;
+
+	if (rewindCount)
+	{
+		RewindEntry &entry	= rewindEntry(rewindCount - 1);
+		int			 length = ((entry.stateSize > rewindStateSize ? entry.stateSize : rewindStateSize) + 3) & ~3;
+		memset(rewindState + rewindStateSize, 0, length - rewindStateSize);
+
+		rewindDecode(rewindState, rewindRing + entry.offset, entry.length);
+		rewindStateSize = entry.stateSize;
+		rewindCount--;
+	}
+	else
+		rewindStateSize = 0;
+
+	return true;
+}
+
+// number of snapshots that can be loaded
+int rewindAvailable()
+{
+	return rewindStateSize ? rewindCount + 1 : 0;
+}
@@ -0,0 +1,23 @@
+#ifndef VBA_REWIND_H
+#define VBA_REWIND_H
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include "../Port.h"
+
+struct EmulatedSystem;
+
+// Rewind buffer
+// The latest snapshot is kept as a whole uncompressed state; every older one
+// is stored as the run-length encoded XOR against the snapshot taken after it,
+// in a ring of a fixed size that drops the oldest snapshots when full.
+extern bool rewindInit(int bufferSize, int maxSnapshots);
+extern void rewindCleanUp();
+extern void rewindClear();
+extern bool rewindSave(const EmulatedSystem &emulator);
+extern bool rewindLoad(const EmulatedSystem &emulator);
+extern int  rewindAvailable();
+
+#endif // VBA_REWIND_H
@@ -15,14 +15,15 @@
 #endif
 
 // evil static variables
-static u32	 lastFrameTime	= 0;
-static int32 frameSkipCount	= 0;
-static int32 frameCount		= 0;
+static INSTANCE_LOCAL u32	 lastFrameTime	= 0;
+static INSTANCE_LOCAL int32 frameSkipCount	= 0;
+static INSTANCE_LOCAL int32 frameDrawing	= -1; // whether this frame is drawn, -1 until asked
+static INSTANCE_LOCAL int32 frameCount		= 0;
 
-static s16	 soundFilter[4000];
-static s16	 soundRight[5]  = { 0, 0, 0, 0, 0 };
-static s16	 soundLeft[5]   = { 0, 0, 0, 0, 0 };
-static int32 soundEchoIndex = 0;
+static INSTANCE_LOCAL s16	 soundFilter[4000];
+static INSTANCE_LOCAL s16	 soundRight[5]  = { 0, 0, 0, 0, 0 };
+static INSTANCE_LOCAL s16	 soundLeft[5]   = { 0, 0, 0, 0, 0 };
+static INSTANCE_LOCAL int32 soundEchoIndex = 0;
 
 // motion sensor
 void systemSetSensorX(int32 x)
@@ -283,6 +284,7 @@ void systemCleanUp()
 	// frame counting
 	frameCount	   = 0;
 	frameSkipCount = systemFramesToSkip();
+	frameDrawing   = -1;
 	lastFrameTime  = systemGetClock();
 
 	extButtons = 0;
@@ -306,6 +308,7 @@ void systemReset()
 	// frame counting
 	frameCount	   = 0;
 	frameSkipCount = systemFramesToSkip();
+	frameDrawing   = -1;
 	lastFrameTime  = systemGetClock();
 
 	extButtons = 0;
@@ -325,9 +328,13 @@ void systemReset()
 	}
 }
 
+// Decided on the first call in each frame and kept until the frame boundary,
+// so that the cores either render all the lines of a frame or none of them.
 bool systemFrameDrawingRequired()
 {
-	return frameSkipCount >= systemFramesToSkip();
+	if (frameDrawing < 0)
+		frameDrawing = frameSkipCount >= systemFramesToSkip();
+	return frameDrawing != 0;
 }
 
 void systemFrameBoundaryWork()
@@ -369,6 +376,7 @@ void systemFrameBoundaryWork()
 	{
 		++frameSkipCount;
 	}
+	frameDrawing = -1;
 
 	// write the input to the movie so that the modification by Lua script may be recorded
 	if (VBAMovieIsRecording())
@@ -88,7 +88,7 @@ extern void systemSetPause(bool pause);
 extern bool systemPausesNextFrame();
 extern bool systemLoadBIOS(const char *biosFileName, bool useBiosFile);
 
-extern int	systemCartridgeType;
+extern INSTANCE_LOCAL int	systemCartridgeType;
 extern int  systemSpeed;
 extern bool systemSoundOn;
 extern u16  systemColorMap16[0x10000];
@@ -101,7 +101,7 @@ extern int  systemColorDepth;
 extern int  systemDebug;
 extern int  systemVerbose;
 extern int  systemFrameSkip;
-extern int  systemSaveUpdateCounter;
+extern INSTANCE_LOCAL int  systemSaveUpdateCounter;
 
 // constances
 #define SYSTEM_SAVE_UPDATED 30
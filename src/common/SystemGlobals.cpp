@@ -1,9 +1,9 @@
 #include "SystemGlobals.h"
 
 // FIXME: it must be admitted that the naming schema is a whole mess
-EmulatedSystem theEmulator;
+INSTANCE_LOCAL EmulatedSystem theEmulator;
 
-EmulatedSystemCounters systemCounters =
+INSTANCE_LOCAL EmulatedSystemCounters systemCounters =
 {
 	// frameCount
 	0,
@@ -17,9 +17,9 @@ EmulatedSystemCounters systemCounters =
 	true,
 };
 
-int emulating = 0;
+INSTANCE_LOCAL int emulating = 0;
 
-u8 *bios = NULL;
+INSTANCE_LOCAL u8 *bios = NULL;
 
 struct Pix
 {
@@ -30,84 +30,90 @@ struct Pix
 	int height;
 };
 
-u8 *pix	 = NULL;
+INSTANCE_LOCAL u8 *pix	 = NULL;
 
-u16	  joypadButtons[4] = { 0, 0, 0, 0 };
-u16	  movieButtons[4] = { 0, 0, 0, 0 };
-u16	  currentButtons[4] = { 0, 0, 0, 0 };
-u16	  lastButtons[4] = { 0, 0, 0, 0 };
-u16	  nextButtons[4] = { 0, 0, 0, 0 };
+INSTANCE_LOCAL u16	  joypadButtons[4] = { 0, 0, 0, 0 };
+INSTANCE_LOCAL u16	  movieButtons[4] = { 0, 0, 0, 0 };
+INSTANCE_LOCAL u16	  currentButtons[4] = { 0, 0, 0, 0 };
+INSTANCE_LOCAL u16	  lastButtons[4] = { 0, 0, 0, 0 };
+INSTANCE_LOCAL u16	  nextButtons[4] = { 0, 0, 0, 0 };
 
-int32 sensorX  = 0;
-int32 sensorY  = 0;
+INSTANCE_LOCAL int32 sensorX  = 0;
+INSTANCE_LOCAL int32 sensorY  = 0;
 
-bool  newFrame		  = true;
-bool8 speedup		  = false;
-u32	  extButtons	  = 0;
-bool8 capturePrevious = false;
-int32 captureNumber	  = 0;
+INSTANCE_LOCAL bool  newFrame		  = true;
+INSTANCE_LOCAL bool8 speedup		  = false;
+INSTANCE_LOCAL u32	  extButtons	  = 0;
+INSTANCE_LOCAL bool8 capturePrevious = false;
+INSTANCE_LOCAL int32 captureNumber	  = 0;
 
-soundtick_t USE_TICKS_AS  = 0;
-soundtick_t soundTickStep = soundQuality * USE_TICKS_AS;
-soundtick_t soundTicks	  = 0;
+INSTANCE_LOCAL soundtick_t USE_TICKS_AS  = 0;
+INSTANCE_LOCAL soundtick_t soundTickStep = soundQuality * USE_TICKS_AS;
+INSTANCE_LOCAL soundtick_t soundTicks	  = 0;
 
-u32	  soundIndex		= 0;
-int32 soundPaused		= 1;
-int32 soundPlay			= 0;
-u32	  soundNextPosition = 0;
+INSTANCE_LOCAL u32	  soundIndex		= 0;
+INSTANCE_LOCAL int32 soundPaused		= 1;
+INSTANCE_LOCAL int32 soundPlay			= 0;
+INSTANCE_LOCAL u32	  soundNextPosition = 0;
 
-u8	soundBuffer[6][735];
-u32 soundBufferLen		= 1470;
-u32 soundBufferTotalLen = 14700;
-u32 soundBufferIndex	= 0;
+INSTANCE_LOCAL u8	soundBuffer[6][735];
+INSTANCE_LOCAL u32 soundBufferLen		= 1470;
+INSTANCE_LOCAL u32 soundBufferTotalLen = 14700;
+INSTANCE_LOCAL u32 soundBufferIndex	= 0;
 
-u16	  soundFinalWave[1470];
-u16	  soundFrameSound[735 * 30 * 2]; // for avi logging
-int32 soundFrameSoundWritten = 0;
+INSTANCE_LOCAL u16	  soundFinalWave[1470];
+INSTANCE_LOCAL u16	  soundFrameSound[735 * 30 * 2]; // for avi logging
+INSTANCE_LOCAL int32 soundFrameSoundWritten = 0;
 
-bool tempSaveSafe	  = true;
-int	 tempSaveID		  = 0;
-int	 tempSaveAttempts = 0;
+INSTANCE_LOCAL bool tempSaveSafe	  = true;
+INSTANCE_LOCAL int	 tempSaveID		  = 0;
+INSTANCE_LOCAL int	 tempSaveAttempts = 0;
 
 // settings
-bool  synchronize = true;
-int32 gbFrameSkip = 0;
-int32 frameSkip	  = 0;
+INSTANCE_LOCAL bool  synchronize = true;
+INSTANCE_LOCAL int32 gbFrameSkip = 0;
+INSTANCE_LOCAL int32 frameSkip	  = 0;
 
-bool  cpuDisableSfx = false;
-int32 layerSettings = 0xff00;
+INSTANCE_LOCAL bool  cpuDisableSfx = false;
+INSTANCE_LOCAL int32 layerSettings = 0xff00;
+
+INSTANCE_LOCAL bool8 cpuBlockCacheEnabled   = false;
+INSTANCE_LOCAL bool8 cpuThumbJitEnabled     = false;
+INSTANCE_LOCAL bool8 cpuIdleLoopSkip        = false;
+INSTANCE_LOCAL bool8 cpuRenderThreadEnabled = false;
 
 #ifdef USE_GB_CORE_V7
-bool gbNullInputHackEnabled		= false;
-bool gbNullInputHackTempEnabled = false;
+INSTANCE_LOCAL bool gbNullInputHackEnabled		= false;
+INSTANCE_LOCAL bool gbNullInputHackTempEnabled = false;
 #else
-bool gbV20GBFrameTimingHack		= false;
-bool gbV20GBFrameTimingHackTemp = false;
+INSTANCE_LOCAL bool gbV20GBFrameTimingHack		= false;
+INSTANCE_LOCAL bool gbV20GBFrameTimingHackTemp = false;
 #endif
 
 #ifdef USE_GBA_CORE_V7
-bool memLagEnabled	   = false;
-bool memLagTempEnabled = false;
+INSTANCE_LOCAL bool memLagEnabled	   = false;
+INSTANCE_LOCAL bool memLagTempEnabled = false;
 #endif
 
-bool8 useOldFrameTiming	  = false;
-bool8 useBios			  = false;
-bool8 skipBios			  = false;
-bool8 skipSaveGameBattery = false;
-bool8 skipSaveGameCheats  = false;
-bool8 cheatsEnabled		  = true;
-bool8 mirroringEnable	  = false;
-
-bool8 cpuEnhancedDetection = true;
-int32 cpuSaveType		   = 0;
-
-int32 soundVolume	  = 0;
-int32 soundQuality	  = 2;
-bool8 soundEcho		  = false;
-bool8 soundLowPass	  = false;
-bool8 soundReverse	  = false;
-int32 soundEnableFlag = 0x3ff;
-bool8 soundOffFlag	  = false;
+INSTANCE_LOCAL bool8 useOldFrameTiming	  = false;
+INSTANCE_LOCAL bool8 useBios			  = false;
+INSTANCE_LOCAL bool8 skipBios			  = false;
+INSTANCE_LOCAL bool8 skipSaveGameBattery = false;
+INSTANCE_LOCAL bool8 skipSaveGameCheats  = false;
+INSTANCE_LOCAL bool8 cheatsEnabled		  = true;
+INSTANCE_LOCAL bool8 mirroringEnable	  = false;
+
+INSTANCE_LOCAL bool8 cpuEnhancedDetection = true;
+INSTANCE_LOCAL int32 cpuSaveType		   = 0;
+
+INSTANCE_LOCAL int32 soundVolume	  = 0;
+INSTANCE_LOCAL int32 soundQuality	  = 2;
+INSTANCE_LOCAL bool8 soundEcho		  = false;
+INSTANCE_LOCAL bool8 soundLowPass	  = false;
+INSTANCE_LOCAL bool8 soundReverse	  = false;
+INSTANCE_LOCAL int32 soundEnableFlag = 0x3ff;
+INSTANCE_LOCAL bool8 soundOffFlag	  = false;
+INSTANCE_LOCAL bool8 soundSilent	  = false;
 
 // I am just too lazy...
-u8 osd[4 * 257 * 226];
+INSTANCE_LOCAL u8 osd[4 * 257 * 226];
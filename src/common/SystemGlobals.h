@@ -34,6 +34,13 @@ struct EmulatedSystem
 	bool (*emuReadMemState)(char *, int);
 	// write memory state (rewind)
 	bool (*emuWriteMemState)(char *, int);
+	// load uncompressed memory state
+	bool (*emuReadMemStateRaw)(char *, int);
+	// write uncompressed memory state, returns its size or 0
+	int (*emuWriteMemStateRaw)(char *, int);
+	// rewrite the uncompressed memory state the previous call wrote to the
+	// same buffer, copying only what changed; returns its size or 0
+	int (*emuWriteMemStateIncremental)(char *, int);
 	// write PNG file
 	bool (*emuWritePNG)(const char *);
 	// write BMP file
@@ -56,92 +63,99 @@ struct EmulatedSystemCounters
 	bool8 laggedLast;
 };
 
-extern struct EmulatedSystem theEmulator;
-extern struct EmulatedSystemCounters systemCounters;
+extern INSTANCE_LOCAL struct EmulatedSystem theEmulator;
+extern INSTANCE_LOCAL struct EmulatedSystemCounters systemCounters;
 
-extern int emulating;
+extern INSTANCE_LOCAL int emulating;
 
-extern u8 *bios;
-extern u8 *pix;
-extern u8 osd[];
+extern INSTANCE_LOCAL u8 *bios;
+extern INSTANCE_LOCAL u8 *pix;
+extern INSTANCE_LOCAL u8 osd[];
 
-extern u16 joypadButtons[4];
-extern u16 movieButtons[4];
-extern u16 currentButtons[4];
-extern u16 lastButtons[4];
-extern u16 nextButtons[4];
+extern INSTANCE_LOCAL u16 joypadButtons[4];
+extern INSTANCE_LOCAL u16 movieButtons[4];
+extern INSTANCE_LOCAL u16 currentButtons[4];
+extern INSTANCE_LOCAL u16 lastButtons[4];
+extern INSTANCE_LOCAL u16 nextButtons[4];
 
-extern int32 sensorX, sensorY;
+extern INSTANCE_LOCAL int32 sensorX, sensorY;
 
-extern bool	 newFrame;
-extern bool8 speedup;
-extern u32	 extButtons;
-extern bool8 capturePrevious;
-extern int32 captureNumber;
+extern INSTANCE_LOCAL bool	 newFrame;
+extern INSTANCE_LOCAL bool8 speedup;
+extern INSTANCE_LOCAL u32	 extButtons;
+extern INSTANCE_LOCAL bool8 capturePrevious;
+extern INSTANCE_LOCAL int32 captureNumber;
 
 typedef int32 soundtick_t;
 
-extern soundtick_t USE_TICKS_AS;
-extern soundtick_t soundTickStep;
-extern soundtick_t soundTicks;
+extern INSTANCE_LOCAL soundtick_t USE_TICKS_AS;
+extern INSTANCE_LOCAL soundtick_t soundTickStep;
+extern INSTANCE_LOCAL soundtick_t soundTicks;
 
-extern u32	 soundIndex;
-extern int32 soundPaused;
-extern int32 soundPlay;
-extern u32	 soundNextPosition;
+extern INSTANCE_LOCAL u32	 soundIndex;
+extern INSTANCE_LOCAL int32 soundPaused;
+extern INSTANCE_LOCAL int32 soundPlay;
+extern INSTANCE_LOCAL u32	 soundNextPosition;
 
-extern u8  soundBuffer[6][735];
-extern u32 soundBufferLen;
-extern u32 soundBufferTotalLen;
-extern u32 soundBufferIndex;
+extern INSTANCE_LOCAL u8  soundBuffer[6][735];
+extern INSTANCE_LOCAL u32 soundBufferLen;
+extern INSTANCE_LOCAL u32 soundBufferTotalLen;
+extern INSTANCE_LOCAL u32 soundBufferIndex;
 
-extern u16	 soundFinalWave[1470];
-extern u16	 soundFrameSound[735 * 30 * 2];
-extern int32 soundFrameSoundWritten;
+extern INSTANCE_LOCAL u16	 soundFinalWave[1470];
+extern INSTANCE_LOCAL u16	 soundFrameSound[735 * 30 * 2];
+extern INSTANCE_LOCAL int32 soundFrameSoundWritten;
 
-extern bool tempSaveSafe;
-extern int	tempSaveID;
-extern int	tempSaveAttempts;
+extern INSTANCE_LOCAL bool tempSaveSafe;
+extern INSTANCE_LOCAL int	tempSaveID;
+extern INSTANCE_LOCAL int	tempSaveAttempts;
 
 // settings that should have no effect on timing
-extern bool	 synchronize;   // ... except this one?
-extern int32 gbFrameSkip;
-extern int32 frameSkip;
+extern INSTANCE_LOCAL bool	 synchronize;   // ... except this one?
+extern INSTANCE_LOCAL int32 gbFrameSkip;
+extern INSTANCE_LOCAL int32 frameSkip;
 
-extern bool	 cpuDisableSfx;
-extern int32 layerSettings;
+extern INSTANCE_LOCAL bool	 cpuDisableSfx;
+extern INSTANCE_LOCAL int32 layerSettings;
+
+// settings that only affect speed, not the emulation results
+extern INSTANCE_LOCAL bool8 cpuBlockCacheEnabled;
+extern INSTANCE_LOCAL bool8 cpuThumbJitEnabled;
+extern INSTANCE_LOCAL bool8 cpuIdleLoopSkip;
+extern INSTANCE_LOCAL bool8 cpuRenderThreadEnabled; // needs MULTI_INSTANCE
 
 // other settings
 #ifdef USE_GB_CORE_V7
-extern bool gbNullInputHackEnabled;
-extern bool gbNullInputHackTempEnabled;
+extern INSTANCE_LOCAL bool gbNullInputHackEnabled;
+extern INSTANCE_LOCAL bool gbNullInputHackTempEnabled;
 #else
-extern bool gbV20GBFrameTimingHack;
-extern bool gbV20GBFrameTimingHackTemp;
+extern INSTANCE_LOCAL bool gbV20GBFrameTimingHack;
+extern INSTANCE_LOCAL bool gbV20GBFrameTimingHackTemp;
 #endif
 
 #ifdef USE_GBA_CORE_V7
-extern bool memLagEnabled;
-extern bool memLagTempEnabled;
+extern INSTANCE_LOCAL bool memLagEnabled;
+extern INSTANCE_LOCAL bool memLagTempEnabled;
 #endif
 
-extern bool8 useOldFrameTiming;
-extern bool8 useBios;
-extern bool8 skipBios;
-extern bool8 skipSaveGameBattery; // skip battery data when reading save states
-extern bool8 skipSaveGameCheats; // skip cheat list data when reading save states
-extern bool8 cheatsEnabled;
-extern bool8 mirroringEnable;
-
-extern bool8 cpuEnhancedDetection;
-extern int32 cpuSaveType;
-
-extern int32 soundVolume;
-extern int32 soundQuality;
-extern bool8 soundEcho;
-extern bool8 soundLowPass;
-extern bool8 soundReverse;
-extern int32 soundEnableFlag;
-extern bool8 soundOffFlag;
+extern INSTANCE_LOCAL bool8 useOldFrameTiming;
+extern INSTANCE_LOCAL bool8 useBios;
+extern INSTANCE_LOCAL bool8 skipBios;
+extern INSTANCE_LOCAL bool8 skipSaveGameBattery; // skip battery data when reading save states
+extern INSTANCE_LOCAL bool8 skipSaveGameCheats; // skip cheat list data when reading save states
+extern INSTANCE_LOCAL bool8 cheatsEnabled;
+extern INSTANCE_LOCAL bool8 mirroringEnable;
+
+extern INSTANCE_LOCAL bool8 cpuEnhancedDetection;
+extern INSTANCE_LOCAL int32 cpuSaveType;
+
+extern INSTANCE_LOCAL int32 soundVolume;
+extern INSTANCE_LOCAL int32 soundQuality;
+extern INSTANCE_LOCAL bool8 soundEcho;
+extern INSTANCE_LOCAL bool8 soundLowPass;
+extern INSTANCE_LOCAL bool8 soundReverse;
+extern INSTANCE_LOCAL int32 soundEnableFlag;
+extern INSTANCE_LOCAL bool8 soundOffFlag;
+extern INSTANCE_LOCAL bool8 soundSilent;
 
 #endif
@@ -16,6 +16,7 @@ extern "C" {
 #include "../NLS.h"
 #include "System.h"
 #include "Util.h"
+#include "ColorConvert.h"
 #include "../gba/Flash.h"
 #include "../gba/RTC.h"
 
@@ -27,7 +28,7 @@ extern "C" {
 #define _stricmp strcasecmp
 #endif // ! _MSC_VER
 
-extern int32 cpuSaveType;
+extern INSTANCE_LOCAL int32 cpuSaveType;
 
 extern int systemColorDepth;
 extern int systemRedShift;
@@ -37,11 +38,11 @@ extern int systemBlueShift;
 extern u16 systemColorMap16[0x10000];
 extern u32 systemColorMap32[0x10000];
 
-static int	   (ZEXPORT *utilGzWriteFunc)(gzFile, voidp, unsigned int) = NULL;
-static int	   (ZEXPORT *utilGzReadFunc)(gzFile, voidp, unsigned int)  = NULL;
-static int	   (ZEXPORT *utilGzCloseFunc)(gzFile) = NULL;
-static z_off_t (ZEXPORT *utilGzSeekFunc)(gzFile, z_off_t, int) = NULL;
-static z_off_t (ZEXPORT *utilGzTellFunc)(gzFile) = NULL;
+static INSTANCE_LOCAL int	   (ZEXPORT *utilGzWriteFunc)(gzFile, voidp, unsigned int) = NULL;
+static INSTANCE_LOCAL int	   (ZEXPORT *utilGzReadFunc)(gzFile, voidp, unsigned int)  = NULL;
+static INSTANCE_LOCAL int	   (ZEXPORT *utilGzCloseFunc)(gzFile) = NULL;
+static INSTANCE_LOCAL z_off_t (ZEXPORT *utilGzSeekFunc)(gzFile, z_off_t, int) = NULL;
+static INSTANCE_LOCAL z_off_t (ZEXPORT *utilGzTellFunc)(gzFile) = NULL;
 
 //Kludge to get it to compile in Linux, GCC cannot convert
 //gzwrite function pointer to the type of utilGzWriteFunc
@@ -522,7 +523,7 @@ void utilApplyIPS(const char *ips, u8 * *r, int *s)
 	fclose(f);
 }
 
-extern bool8 cpuIsMultiBoot;
+extern INSTANCE_LOCAL bool8 cpuIsMultiBoot;
 
 bool utilIsGBAImage(const char *file)
 {
@@ -1195,11 +1196,130 @@ gzFile utilMemGzOpen(char *memory, int available, char *mode)
 	return memgzopen(memory, available, mode);
 }
 
+// Uncompressed memory states
+// There is only one raw stream, kept in a static, so that opening it never
+// allocates anything; like the other streams, it lasts until the next open.
+struct utilMemRawStream
+{
+	char *memory;
+	int	  available;
+	int	  pos;
+	bool  overflow;
+	bool  update; // the memory holds the previous state written
+};
+
+static INSTANCE_LOCAL utilMemRawStream utilMemRaw;
+
+static int ZEXPORT utilMemRawWrite(gzFile file, voidp buffer, unsigned int len)
+{
+	utilMemRawStream *stream = (utilMemRawStream *)file;
+	if (len > (unsigned int)(stream->available - stream->pos))
+	{
+		stream->overflow = true;
+		return 0;
+	}
+	memcpy(stream->memory + stream->pos, buffer, len);
+	stream->pos += len;
+	return len;
+}
+
+static int ZEXPORT utilMemRawRead(gzFile file, voidp buffer, unsigned int len)
+{
+	utilMemRawStream *stream = (utilMemRawStream *)file;
+	if (len > (unsigned int)(stream->available - stream->pos))
+	{
+		stream->overflow = true;
+		len = stream->available - stream->pos;
+	}
+	memcpy(buffer, stream->memory + stream->pos, len);
+	stream->pos += len;
+	return len;
+}
+
+static int ZEXPORT utilMemRawClose(gzFile file)
+{
+	return ((utilMemRawStream *)file)->overflow ? Z_BUF_ERROR : Z_OK;
+}
+
+static z_off_t ZEXPORT utilMemRawSeek(gzFile file, z_off_t offset, int whence)
+{
+	utilMemRawStream *stream = (utilMemRawStream *)file;
+	if (whence == SEEK_CUR)
+		offset += stream->pos;
+	else if (whence != SEEK_SET)
+		return -1;
+	if (offset < 0 || offset > stream->available)
+		return -1;
+	stream->pos = offset;
+	return offset;
+}
+
+static z_off_t ZEXPORT utilMemRawTell(gzFile file)
+{
+	return ((utilMemRawStream *)file)->pos;
+}
+
+gzFile utilMemRawOpen(char *memory, int available)
+{
+	utilGzWriteFunc = utilMemRawWrite;
+	utilGzReadFunc	= utilMemRawRead;
+	utilGzCloseFunc = utilMemRawClose;
+	utilGzSeekFunc	= utilMemRawSeek;
+	utilGzTellFunc	= utilMemRawTell;
+
+	utilMemRaw.memory	 = memory;
+	utilMemRaw.available = available;
+	utilMemRaw.pos		 = 0;
+	utilMemRaw.overflow	 = false;
+	utilMemRaw.update	 = false;
+
+	return (gzFile)&utilMemRaw;
+}
+
+// Opens a raw stream for writing over a state written earlier with the same
+// layout, which lets utilGzWritePages() skip the unchanged pages
+gzFile utilMemRawReopen(char *memory, int available)
+{
+	gzFile file = utilMemRawOpen(memory, available);
+	utilMemRaw.update = true;
+	return file;
+}
+
+// true if a read or write went past the end of the raw stream
+bool utilMemRawOverflow(gzFile file)
+{
+	return ((utilMemRawStream *)file)->overflow;
+}
+
 int utilGzWrite(gzFile file, voidp buffer, unsigned int len)
 {
 	return utilGzWriteFunc(file, buffer, len);
 }
 
+// Writes a block made of 256 bytes pages, only copying the pages flagged in
+// dirty when the stream updates a raw state; any other stream gets it all
+int utilGzWritePages(gzFile file, voidp buffer, unsigned int len, const u8 *dirty)
+{
+	if (file != (gzFile)&utilMemRaw || !utilMemRaw.update)
+		return utilGzWrite(file, buffer, len);
+
+	if (len > (unsigned int)(utilMemRaw.available - utilMemRaw.pos))
+	{
+		utilMemRaw.overflow = true;
+		return 0;
+	}
+
+	char	   *dest = utilMemRaw.memory + utilMemRaw.pos;
+	const char *src	 = (const char *)buffer;
+	for (unsigned int offset = 0; offset < len; offset += 0x100)
+	{
+		if (dirty[offset >> 8])
+			memcpy(dest + offset, src + offset, len - offset < 0x100 ? len - offset : 0x100);
+	}
+	utilMemRaw.pos += len;
+	return len;
+}
+
 int utilGzRead(gzFile file, voidp buffer, unsigned int len)
 {
 	return utilGzReadFunc(file, buffer, len);
@@ -1310,6 +1430,8 @@ void utilUpdateSystemColorMaps()
 		break;
 	}
 	}
+
+	colorMapPlain = true;
 }
 
 //// BIOS stuff
@@ -48,7 +48,11 @@ extern void	 utilWriteInt(gzFile, int32);
 extern gzFile utilGzOpen(const char *file, const char *mode);
 extern gzFile utilGzReopen(int id, const char *mode);
 extern gzFile utilMemGzOpen(char *memory, int available, char *mode);
+extern gzFile utilMemRawOpen(char *memory, int available);
+extern gzFile utilMemRawReopen(char *memory, int available);
+extern bool utilMemRawOverflow(gzFile file);
 extern int utilGzWrite(gzFile file, voidp buffer, unsigned int len);
+extern int utilGzWritePages(gzFile file, voidp buffer, unsigned int len, const u8 *dirty);
 extern int utilGzRead(gzFile file, voidp buffer, unsigned int len);
 extern int utilGzClose(gzFile file);
 extern z_off_t utilGzSeek(gzFile file, z_off_t offset, int whence);
@@ -910,13 +910,13 @@ struct registerPointerMap
 	int dataSize;
 };
 
-extern gbRegister AF;
-extern gbRegister BC;
-extern gbRegister DE;
-extern gbRegister HL;
-extern gbRegister SP;
-extern gbRegister PC;
-extern u16 IFF;
+extern INSTANCE_LOCAL gbRegister AF;
+extern INSTANCE_LOCAL gbRegister BC;
+extern INSTANCE_LOCAL gbRegister DE;
+extern INSTANCE_LOCAL gbRegister HL;
+extern INSTANCE_LOCAL gbRegister SP;
+extern INSTANCE_LOCAL gbRegister PC;
+extern INSTANCE_LOCAL u16 IFF;
 
 #define RPM_ENTRY(name, var) \
 	{ name, (unsigned int *)&var, sizeof(var) },
@@ -1211,6 +1211,18 @@ static void CalculateMemHookRegions(LuaMemHookType hookType)
 //		++iter;
 //	}
 	hookedRegions[hookType].Calculate(hookedBytes);
+
+#ifndef USE_GBA_CORE_V7
+	// the CPU runs a loop without exec hooks when none are set, and skips idle
+	// loops only when no read hook is set
+	if ((hookType == LUAMEMHOOK_EXEC || hookType == LUAMEMHOOK_READ) && systemIsRunningGBA())
+		CPUExecFeaturesChanged();
+#endif
+#ifndef USE_GB_CORE_V7
+	// hooked GB pages leave the direct access tables
+	if (hookType == LUAMEMHOOK_READ || hookType == LUAMEMHOOK_WRITE)
+		gbUpdateMemoryPages();
+#endif
 }
 
 static void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
@@ -1282,6 +1294,16 @@ void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value
 	}
 }
 
+bool VBALuaHasMemHook(LuaMemHookType hookType)
+{
+	return hookedRegions[hookType].NotEmpty();
+}
+
+bool VBALuaMemHookCovers(LuaMemHookType hookType, unsigned int address, int size)
+{
+	return hookedRegions[hookType].NotEmpty() && hookedRegions[hookType].Contains(address, size);
+}
+
 static int memory_registerHook(lua_State *L, LuaMemHookType hookType, int defaultSize)
 {
 	// get first argument: address
@@ -1609,6 +1631,9 @@ static int memory_writebyte(lua_State *L)
 	if (systemIsRunningGBA())
 	{
 		CPUWriteByteQuick(addr, val);
+#ifndef USE_GBA_CORE_V7
+		CPUExternalWrite(addr, 1);
+#endif
 	}
 	else
 	{
@@ -1629,6 +1654,9 @@ static int memory_writeword(lua_State *L)
 	if (systemIsRunningGBA())
 	{
 		CPUWriteHalfWordQuick(addr, val);
+#ifndef USE_GBA_CORE_V7
+		CPUExternalWrite(addr, 2);
+#endif
 	}
 	else
 	{
@@ -1649,6 +1677,9 @@ static int memory_writedword(lua_State *L)
 	if (systemIsRunningGBA())
 	{
 		CPUWriteMemoryQuick(addr, val);
+#ifndef USE_GBA_CORE_V7
+		CPUExternalWrite(addr, 4);
+#endif
 	}
 	else
 	{
@@ -4113,23 +4144,23 @@ static int avi_resume(lua_State *L)
 
 static int sound_get(lua_State *L)
 {
-	extern int32 soundLevel1;
-	extern int32 soundLevel2;
-	extern int32 soundBalance;
-	extern int32 soundMasterOn;
-	extern int32 soundVIN;
-	extern int32 sound1On;
-	extern int32 sound1EnvelopeVolume;
-	extern int32 sound2On;
-	extern int32 sound2EnvelopeVolume;
-	extern int32 sound3On;
-	extern int32 sound3OutputLevel;
-	extern int32 sound3Bank;
-	extern int32 sound3DataSize;
-	extern int32 sound3ForcedOutput;
-	extern int32 sound4On;
-	extern int32 sound4EnvelopeVolume;
-	extern u8 sound3WaveRam[0x20];
+	extern INSTANCE_LOCAL int32 soundLevel1;
+	extern INSTANCE_LOCAL int32 soundLevel2;
+	extern INSTANCE_LOCAL int32 soundBalance;
+	extern INSTANCE_LOCAL int32 soundMasterOn;
+	extern INSTANCE_LOCAL int32 soundVIN;
+	extern INSTANCE_LOCAL int32 sound1On;
+	extern INSTANCE_LOCAL int32 sound1EnvelopeVolume;
+	extern INSTANCE_LOCAL int32 sound2On;
+	extern INSTANCE_LOCAL int32 sound2EnvelopeVolume;
+	extern INSTANCE_LOCAL int32 sound3On;
+	extern INSTANCE_LOCAL int32 sound3OutputLevel;
+	extern INSTANCE_LOCAL int32 sound3Bank;
+	extern INSTANCE_LOCAL int32 sound3DataSize;
+	extern INSTANCE_LOCAL int32 sound3ForcedOutput;
+	extern INSTANCE_LOCAL int32 sound4On;
+	extern INSTANCE_LOCAL int32 sound4EnvelopeVolume;
+	extern INSTANCE_LOCAL u8 sound3WaveRam[0x20];
 
 	int freqReg;
 	double freq;
@@ -60,18 +60,18 @@
 
 using namespace std;
 
-SMovie Movie;
-bool   loadingMovie = false;
+INSTANCE_LOCAL SMovie Movie;
+INSTANCE_LOCAL bool   loadingMovie = false;
 
 // probably bad idea to have so many global variables, but I hate to recompile almost everything after editing VBA.h
-bool autoConvertMovieWhenPlaying = false;
+INSTANCE_LOCAL bool autoConvertMovieWhenPlaying = false;
 
-static u16 initialInputs[4] = { 0 };
+static INSTANCE_LOCAL u16 initialInputs[4] = { 0 };
 
-static bool resetSignaled	  = false;
-static bool resetSignaledLast = false;
+static INSTANCE_LOCAL bool resetSignaled	  = false;
+static INSTANCE_LOCAL bool resetSignaledLast = false;
 
-static int prevEmulatorType, prevBorder, prevWinBorder, prevBorderAuto;
+static INSTANCE_LOCAL int prevEmulatorType, prevBorder, prevWinBorder, prevBorderAuto;
 
 // little-endian integer pop/push functions:
 static inline uint32 Pop32(const uint8 * &ptr)
@@ -326,7 +326,7 @@ static void preserve_movie_init_input()
 		}
 		else
 		{
-			extern int32 gbJoymask[4];
+			extern INSTANCE_LOCAL int32 gbJoymask[4];
 			for (int i = 0; i < 4; ++i)
 				initialInputs[i] = u16(gbJoymask[i] & 0xFFFF);
 		}
@@ -585,7 +585,7 @@ void VBAMovieGetRomInfo(const SMovie &movieInfo, char romTitle [12], uint32 &rom
 {
 	if (systemCartridgeType == IMAGE_GBA) // GBA
 	{
-		extern u8 *rom;
+		extern INSTANCE_LOCAL u8 *rom;
 		memcpy(romTitle, &rom[0xa0], 12); // GBA TITLE
 		memcpy(&romGameCode, &rom[0xac], 4); // GBA ROM GAME CODE
 		if ((movieInfo.header.optionFlags & MOVIE_SETTING_USEBIOSFILE) != 0)
@@ -596,7 +596,7 @@ void VBAMovieGetRomInfo(const SMovie &movieInfo, char romTitle [12], uint32 &rom
 	}
 	else // non-GBA
 	{
-		extern u8 *gbRom;
+		extern INSTANCE_LOCAL u8 *gbRom;
 		memcpy(romTitle, &gbRom[0x134], 12); // GB TITLE (note this can be 15 but is truncated to 12)
 		romGameCode = (uint32)gbRom[0x146]; // GB ROM UNIT CODE
 
@@ -628,8 +628,8 @@ static void SetPlayEmuSettings()
 	theApp.skipBiosIntro = (Movie.header.optionFlags & MOVIE_SETTING_SKIPBIOSINTRO) != 0;
 	theApp.useBiosFile	= (Movie.header.optionFlags & MOVIE_SETTING_USEBIOSFILE) != 0;
 #else
-	extern int	 saveType, sdlRtcEnable, sdlFlashSize;   // from SDL.cpp
-	extern bool8 useBios, skipBios, removeIntros;     // from SDL.cpp
+	extern int	 sdlRtcEnable, sdlFlashSize;   // from SDL.cpp
+	extern bool8 removeIntros;     // from SDL.cpp
 	useBios		 = (Movie.header.optionFlags & MOVIE_SETTING_USEBIOSFILE) != 0;
 	skipBios	 = (Movie.header.optionFlags & MOVIE_SETTING_SKIPBIOSINTRO) != 0;
 	removeIntros = false /*(Movie.header.optionFlags & MOVIE_SETTING_REMOVEINTROS) != 0*/;
@@ -900,8 +900,7 @@ static void SetRecordEmuSettings()
 	Movie.header.saveType  = theApp.winSaveType;
 	Movie.header.flashSize = theApp.winFlashSize;
 #else
-	extern int	 saveType, sdlRtcEnable, sdlFlashSize;   // from SDL.cpp
-	extern bool8 useBios, skipBios;     // from SDL.cpp
+	extern int	 sdlRtcEnable, sdlFlashSize;   // from SDL.cpp
 	if (useBios)
 		Movie.header.optionFlags |= MOVIE_SETTING_USEBIOSFILE;
 	if (skipBios)
@@ -33,6 +33,8 @@ enum LuaMemHookType
 	LUAMEMHOOK_COUNT
 };
 void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType);
+bool VBALuaHasMemHook(LuaMemHookType hookType);
+bool VBALuaMemHookCovers(LuaMemHookType hookType, unsigned int address, int size);
 
 enum LuaJoypadType
 {
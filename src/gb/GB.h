@@ -36,6 +36,8 @@ bool gbWriteSaveState(const char *);
 bool gbWriteMemSaveState(const char *, int);
 bool gbReadSaveState(const char *);
 bool gbReadMemSaveState(char *, int);
+bool gbReadMemSaveStateRaw(char *, int);
+int gbWriteMemSaveStateRaw(char *, int);
 void gbSgbRenderBorder();
 bool gbWritePNGFile(const char *);
 bool gbWriteBMPFile(const char *);
@@ -2535,6 +2535,21 @@ bool gbWriteMemSaveState(char *memory, int available)
 	return res;
 }
 
+// Uncompressed memory states, for tools saving and loading states at a high
+// rate; returns the size of the state, or 0 if it didn't fit
+int gbWriteMemSaveStateRaw(char *memory, int available)
+{
+	gzFile gzFile = utilMemRawOpen(memory, available);
+
+	bool res  = gbWriteSaveStateToStream(gzFile);
+	int	 size = utilGzTell(gzFile);
+
+	if (utilGzClose(gzFile) != Z_OK)
+		res = false;
+
+	return res ? size : 0;
+}
+
 bool gbWriteSaveState(const char *name)
 {
 	gzFile gzFile = utilGzOpen(name, "wb");
@@ -2875,6 +2890,20 @@ bool gbReadMemSaveState(char *memory, int available)
 	return res;
 }
 
+bool gbReadMemSaveStateRaw(char *memory, int size)
+{
+	gzFile gzFile = utilMemRawOpen(memory, size);
+
+	tempSaveSafe = false;
+	bool res = gbReadSaveStateFromStream(gzFile);
+	tempSaveSafe = true;
+
+	if (utilGzClose(gzFile) != Z_OK)
+		res = false;
+
+	return res;
+}
+
 bool gbReadSaveState(const char *name)
 {
 	gzFile gzFile = utilGzOpen(name, "rb");
@@ -3775,6 +3804,12 @@ struct EmulatedSystem GBSystem =
 	gbReadMemSaveState,
 	// emuWriteMemState
 	gbWriteMemSaveState,
+	// emuReadMemStateRaw
+	gbReadMemSaveStateRaw,
+	// emuWriteMemStateRaw
+	gbWriteMemSaveStateRaw,
+	// emuWriteMemStateIncremental
+	NULL,
 	// emuWritePNG
 	gbWritePNGFile,
 	// emuWriteBMP
@@ -12,6 +12,7 @@
 #include "../gbSGB.h"
 #include "../gbSound.h"
 #include "../../common/Util.h"
+#include "../../common/ColorConvert.h"
 #include "../../common/System.h"
 #include "../../common/SystemGlobals.h"
 #include "../../common/movie.h"
@@ -27,177 +28,181 @@ enum
 };
 
 bool gbUpdateSizes();
-bool inBios = false;
+INSTANCE_LOCAL bool inBios = false;
 
 // debugging
-bool memorydebug = false;
-char gbBuffer[2048];
+INSTANCE_LOCAL bool memorydebug = false;
+INSTANCE_LOCAL char gbBuffer[2048];
 
-extern u16 gbLineMix[160];
+extern INSTANCE_LOCAL u16 gbLineMix[160];
 
 // mappers
-void (*mapper)(u16, u8)		= NULL;
-void (*mapperRAM)(u16, u8)	= NULL;
-u8	 (*mapperReadRAM)(u16)	= NULL;
-void (*mapperUpdateClock)() = NULL;
+INSTANCE_LOCAL void (*mapper)(u16, u8)		= NULL;
+INSTANCE_LOCAL void (*mapperRAM)(u16, u8)	= NULL;
+INSTANCE_LOCAL u8	 (*mapperReadRAM)(u16)	= NULL;
+INSTANCE_LOCAL void (*mapperUpdateClock)() = NULL;
 
 // registers
-gbRegister PC;
-gbRegister SP;
-gbRegister AF;
-gbRegister BC;
-gbRegister DE;
-gbRegister HL;
-u16		   IFF = 0;
+INSTANCE_LOCAL gbRegister PC;
+INSTANCE_LOCAL gbRegister SP;
+INSTANCE_LOCAL gbRegister AF;
+INSTANCE_LOCAL gbRegister BC;
+INSTANCE_LOCAL gbRegister DE;
+INSTANCE_LOCAL gbRegister HL;
+INSTANCE_LOCAL u16		   IFF = 0;
 // 0xff04
-u8 register_DIV = 0;
+INSTANCE_LOCAL u8 register_DIV = 0;
 // 0xff05
-u8 register_TIMA = 0;
+INSTANCE_LOCAL u8 register_TIMA = 0;
 // 0xff06
-u8 register_TMA = 0;
+INSTANCE_LOCAL u8 register_TMA = 0;
 // 0xff07
-u8 register_TAC = 0;
+INSTANCE_LOCAL u8 register_TAC = 0;
 // 0xff0f
-u8 register_IF = 0;
+INSTANCE_LOCAL u8 register_IF = 0;
 // 0xff40
-u8 register_LCDC = 0;
+INSTANCE_LOCAL u8 register_LCDC = 0;
 // 0xff41
-u8 register_STAT = 0;
+INSTANCE_LOCAL u8 register_STAT = 0;
 // 0xff42
-u8 register_SCY = 0;
+INSTANCE_LOCAL u8 register_SCY = 0;
 // 0xff43
-u8 register_SCX = 0;
+INSTANCE_LOCAL u8 register_SCX = 0;
 // 0xff44
-u8 register_LY = 0;
+INSTANCE_LOCAL u8 register_LY = 0;
 // 0xff45
-u8 register_LYC = 0;
+INSTANCE_LOCAL u8 register_LYC = 0;
 // 0xff46
-u8 register_DMA = 0;
+INSTANCE_LOCAL u8 register_DMA = 0;
 // 0xff4a
-u8 register_WY = 0;
+INSTANCE_LOCAL u8 register_WY = 0;
 // 0xff4b
-u8 register_WX = 0;
+INSTANCE_LOCAL u8 register_WX = 0;
 // 0xff4f
-u8 register_VBK = 0;
+INSTANCE_LOCAL u8 register_VBK = 0;
 // 0xff51
-u8 register_HDMA1 = 0;
+INSTANCE_LOCAL u8 register_HDMA1 = 0;
 // 0xff52
-u8 register_HDMA2 = 0;
+INSTANCE_LOCAL u8 register_HDMA2 = 0;
 // 0xff53
-u8 register_HDMA3 = 0;
+INSTANCE_LOCAL u8 register_HDMA3 = 0;
 // 0xff54
-u8 register_HDMA4 = 0;
+INSTANCE_LOCAL u8 register_HDMA4 = 0;
 // 0xff55
-u8 register_HDMA5 = 0;
+INSTANCE_LOCAL u8 register_HDMA5 = 0;
 // 0xff70
-u8 register_SVBK = 0;
+INSTANCE_LOCAL u8 register_SVBK = 0;
 // 0xffff
-u8 register_IE = 0;
+INSTANCE_LOCAL u8 register_IE = 0;
 
 // ticks definition
-int32 GBDIV_CLOCK_TICKS = 64;
-int32 GBLCD_MODE_0_CLOCK_TICKS	 = 51;
-int32 GBLCD_MODE_1_CLOCK_TICKS	 = 1140;
-int32 GBLCD_MODE_2_CLOCK_TICKS	 = 20;
-int32 GBLCD_MODE_3_CLOCK_TICKS	 = 43;
-int32 GBLY_INCREMENT_CLOCK_TICKS = 114;
-int32 GBTIMER_MODE_0_CLOCK_TICKS = 256;
-int32 GBTIMER_MODE_1_CLOCK_TICKS = 4;
-int32 GBTIMER_MODE_2_CLOCK_TICKS = 16;
-int32 GBTIMER_MODE_3_CLOCK_TICKS = 64;
-int32 GBSERIAL_CLOCK_TICKS		 = 128;
-int32 GBSYNCHRONIZE_CLOCK_TICKS	 = 52920;
+INSTANCE_LOCAL int32 GBDIV_CLOCK_TICKS = 64;
+INSTANCE_LOCAL int32 GBLCD_MODE_0_CLOCK_TICKS	 = 51;
+INSTANCE_LOCAL int32 GBLCD_MODE_1_CLOCK_TICKS	 = 1140;
+INSTANCE_LOCAL int32 GBLCD_MODE_2_CLOCK_TICKS	 = 20;
+INSTANCE_LOCAL int32 GBLCD_MODE_3_CLOCK_TICKS	 = 43;
+INSTANCE_LOCAL int32 GBLY_INCREMENT_CLOCK_TICKS = 114;
+INSTANCE_LOCAL int32 GBTIMER_MODE_0_CLOCK_TICKS = 256;
+INSTANCE_LOCAL int32 GBTIMER_MODE_1_CLOCK_TICKS = 4;
+INSTANCE_LOCAL int32 GBTIMER_MODE_2_CLOCK_TICKS = 16;
+INSTANCE_LOCAL int32 GBTIMER_MODE_3_CLOCK_TICKS = 64;
+INSTANCE_LOCAL int32 GBSERIAL_CLOCK_TICKS		 = 128;
+INSTANCE_LOCAL int32 GBSYNCHRONIZE_CLOCK_TICKS	 = 52920;
 
 // state variables
 // general
-int32 gbClockTicks = 0;
-bool8 gbSystemMessage		= false;
-int32 gbGBCColorType		= 0;
-int32 gbRomType				= 0;
-int32 gbRemainingClockTicks = 0;
-int32 gbOldClockTicks		= 0;
-int32 gbIntBreak			= 0;
-int32 gbInterruptLaunched	= 0;
-u8	 gbCheatingDevice		= 0; // 1 = GS, 2 = GG
+INSTANCE_LOCAL int32 gbClockTicks = 0;
+INSTANCE_LOCAL bool8 gbSystemMessage		= false;
+INSTANCE_LOCAL int32 gbGBCColorType		= 0;
+INSTANCE_LOCAL int32 gbRomType				= 0;
+INSTANCE_LOCAL int32 gbRemainingClockTicks = 0;
+INSTANCE_LOCAL int32 gbOldClockTicks		= 0;
+INSTANCE_LOCAL int32 gbIntBreak			= 0;
+INSTANCE_LOCAL int32 gbInterruptLaunched	= 0;
+// ticks not yet taken off the counters below, and how many more
+// can go by before one of them is due (see gbEmulate)
+INSTANCE_LOCAL int32 gbPendingTicks		= 0;
+INSTANCE_LOCAL int32 gbEventHorizon		= 0;
+INSTANCE_LOCAL u8	 gbCheatingDevice		= 0; // 1 = GS, 2 = GG
 // breakpoint
-bool8 breakpoint = false;
+INSTANCE_LOCAL bool8 breakpoint = false;
 // interrupt
-int32 gbInt48Signal	= 0;
-int32 gbInterruptWait = 0;
+INSTANCE_LOCAL int32 gbInt48Signal	= 0;
+INSTANCE_LOCAL int32 gbInterruptWait = 0;
 // serial
-int32 gbSerialOn	= 0;
-int32 gbSerialTicks = 0;
-int32 gbSerialBits	= 0;
+INSTANCE_LOCAL int32 gbSerialOn	= 0;
+INSTANCE_LOCAL int32 gbSerialTicks = 0;
+INSTANCE_LOCAL int32 gbSerialBits	= 0;
 // timer
-int32 gbTimerOn			= false;
-int32 gbTimerTicks		= GBTIMER_MODE_0_CLOCK_TICKS;
-int32 gbTimerClockTicks = GBTIMER_MODE_0_CLOCK_TICKS;
-int32 gbTimerMode		= 0;
-bool8 gbIncreased		= false;
+INSTANCE_LOCAL int32 gbTimerOn			= false;
+INSTANCE_LOCAL int32 gbTimerTicks		= GBTIMER_MODE_0_CLOCK_TICKS;
+INSTANCE_LOCAL int32 gbTimerClockTicks = GBTIMER_MODE_0_CLOCK_TICKS;
+INSTANCE_LOCAL int32 gbTimerMode		= 0;
+INSTANCE_LOCAL bool8 gbIncreased		= false;
 // The internal timer is always active, and it is
 // not reset by writing to register_TIMA/TMA, but by
 // writing to register_DIV...
-int32 gbInternalTimer	= 0x55;
+INSTANCE_LOCAL int32 gbInternalTimer	= 0x55;
 const u8 gbTimerMask[4] = { 0xff, 0x3, 0xf, 0x3f };
 const u8 gbTimerBug[8]	= { 0x80, 0x80, 0x02, 0x02, 0x0, 0xff, 0x0, 0xff };
-int32 gbTimerModeChange = false;
-int32 gbTimerOnChange	= false;
+INSTANCE_LOCAL int32 gbTimerModeChange = false;
+INSTANCE_LOCAL int32 gbTimerOnChange	= false;
 // lcd
-bool  gbScreenOn		= true;
-
-int32 gbLcdMode			= 2;
-int32 gbLcdModeDelayed	= 2;
-int32 gbLcdTicks		= GBLCD_MODE_2_CLOCK_TICKS - 1;
-int32 gbLcdTicksDelayed = GBLCD_MODE_2_CLOCK_TICKS;
-int32 gbLcdLYIncrementTicks		   = 114;
-int32 gbLcdLYIncrementTicksDelayed = 115;
-int32 gbScreenTicks				   = 0;
-u8	  gbSCYLine[300];
-u8	  gbSCXLine[300];
-u8	  gbBgpLine[300];
-u8	  gbObp0Line[300];
-u8	  gbObp1Line[300];
-u8	  gbSpritesTicks[300];
-int32 gbLYChangeHappened	= false;
-int32 gbLCDChangeHappened	= false;
-int32 gbLine99Ticks			= 1;
-int32 gbRegisterLYLCDCOffOn = 0;
-int32 inUseRegister_WX		= 0;
-int32 inUseRegister_WY		= 0;
+INSTANCE_LOCAL bool  gbScreenOn		= true;
+
+INSTANCE_LOCAL int32 gbLcdMode			= 2;
+INSTANCE_LOCAL int32 gbLcdModeDelayed	= 2;
+INSTANCE_LOCAL int32 gbLcdTicks		= GBLCD_MODE_2_CLOCK_TICKS - 1;
+INSTANCE_LOCAL int32 gbLcdTicksDelayed = GBLCD_MODE_2_CLOCK_TICKS;
+INSTANCE_LOCAL int32 gbLcdLYIncrementTicks		   = 114;
+INSTANCE_LOCAL int32 gbLcdLYIncrementTicksDelayed = 115;
+INSTANCE_LOCAL int32 gbScreenTicks				   = 0;
+INSTANCE_LOCAL u8	  gbSCYLine[300];
+INSTANCE_LOCAL u8	  gbSCXLine[300];
+INSTANCE_LOCAL u8	  gbBgpLine[300];
+INSTANCE_LOCAL u8	  gbObp0Line[300];
+INSTANCE_LOCAL u8	  gbObp1Line[300];
+INSTANCE_LOCAL u8	  gbSpritesTicks[300];
+INSTANCE_LOCAL int32 gbLYChangeHappened	= false;
+INSTANCE_LOCAL int32 gbLCDChangeHappened	= false;
+INSTANCE_LOCAL int32 gbLine99Ticks			= 1;
+INSTANCE_LOCAL int32 gbRegisterLYLCDCOffOn = 0;
+INSTANCE_LOCAL int32 inUseRegister_WX		= 0;
+INSTANCE_LOCAL int32 inUseRegister_WY		= 0;
 
 // Used to keep track of the line that ellapse
 // when screen is off
-int32 gbWhiteScreen		= 0;
-bool8 gbBlackScreen		= false;
-int32 register_LCDCBusy = 0;
+INSTANCE_LOCAL int32 gbWhiteScreen		= 0;
+INSTANCE_LOCAL bool8 gbBlackScreen		= false;
+INSTANCE_LOCAL int32 register_LCDCBusy = 0;
 
 // div
-int32 gbDivTicks = GBDIV_CLOCK_TICKS;
+INSTANCE_LOCAL int32 gbDivTicks = GBDIV_CLOCK_TICKS;
 // cgb
-int32 gbVramBank		= 0;
-int32 gbWramBank		= 1;
+INSTANCE_LOCAL int32 gbVramBank		= 0;
+INSTANCE_LOCAL int32 gbWramBank		= 1;
 //sgb
-bool8 gbSgbResetFlag = false;
+INSTANCE_LOCAL bool8 gbSgbResetFlag = false;
 // gbHdmaDestination is 0x99d0 on startup (tested on HW)
 // but I'm not sure what gbHdmaSource is...
-int32 gbHdmaSource		= 0x99d0;
-int32 gbHdmaDestination = 0x99d0;
-int32 gbHdmaBytes		= 0x0000;
-int32 gbHdmaOn			= 0;
-int32 gbSpeed			= 0;
+INSTANCE_LOCAL int32 gbHdmaSource		= 0x99d0;
+INSTANCE_LOCAL int32 gbHdmaDestination = 0x99d0;
+INSTANCE_LOCAL int32 gbHdmaBytes		= 0x0000;
+INSTANCE_LOCAL int32 gbHdmaOn			= 0;
+INSTANCE_LOCAL int32 gbSpeed			= 0;
 // timing
-u32	  gbElapsedTime		 = 0;
-u32	  gbTimeNow			 = 0;
-int32 gbSynchronizeTicks = GBSYNCHRONIZE_CLOCK_TICKS;
+INSTANCE_LOCAL u32	  gbElapsedTime		 = 0;
+INSTANCE_LOCAL u32	  gbTimeNow			 = 0;
+INSTANCE_LOCAL int32 gbSynchronizeTicks = GBSYNCHRONIZE_CLOCK_TICKS;
 // emulator features
-int32 gbBattery		 = 0;
-bool8 gbBatteryError = false;
-int32 gbJoymask[4]	 = { 0, 0, 0, 0 };
+INSTANCE_LOCAL int32 gbBattery		 = 0;
+INSTANCE_LOCAL bool8 gbBatteryError = false;
+INSTANCE_LOCAL int32 gbJoymask[4]	 = { 0, 0, 0, 0 };
 
 // HACK
-static int32 stopCounter = 0; // this has to be saved
+static INSTANCE_LOCAL int32 stopCounter = 0; // this has to be saved
 
-u8 gbRamFill = 0xff;
+INSTANCE_LOCAL u8 gbRamFill = 0xff;
 
 int32 gbRomSizes[] = { 0x00008000, // 32K
 	                 0x00010000, // 64K
@@ -759,6 +764,114 @@ void gbCompareLYToWY()
 		}
 }
 
+// Takes gbPendingTicks off the counters, the way gbEmulate does after every
+// instruction when nothing is due yet.
+static void gbApplyPendingTicks()
+{
+	int ticks = gbPendingTicks;
+
+	gbPendingTicks	= 0;
+	gbEventHorizon -= ticks;
+
+	if (register_LCDCBusy)
+	{
+		register_LCDCBusy -= ticks;
+		if (register_LCDCBusy < 0)
+			register_LCDCBusy = 0;
+	}
+
+	if (gbSgbMode && gbSgbPacketTimeout)
+		gbSgbPacketTimeout -= ticks;
+
+	gbDivTicks -= ticks;
+
+	if (register_LCDC & 0x80)
+	{
+		gbLcdTicks		  -= ticks;
+		gbLcdTicksDelayed -= ticks;
+		gbLcdLYIncrementTicks		 -= ticks;
+		gbLcdLYIncrementTicksDelayed -= ticks;
+
+		gbMemory[0xff0f] = register_IF;
+		register_STAT	 = (register_STAT & 0xfc) | gbLcdModeDelayed;
+	}
+	else
+	{
+		if (!gbWhiteScreen)
+			gbScreenTicks -= ticks;
+		gbLcdLYIncrementTicks -= ticks;
+	}
+
+	gbMemory[0xff41] = register_STAT;
+
+#ifdef OLD_GB_LINK
+	if (gbSerialOn && (linkConnected || (gbMemory[0xff02] & 1)))
+#else
+	if (gbSerialOn && (gbMemory[0xff02] & 1))
+#endif
+		gbSerialTicks -= ticks;
+
+	soundTicks -= gbSpeed ? ticks : ticks * 2;
+
+	if (gbTimerOn)
+	{
+		gbTimerTicks	  = ((gbInternalTimer) & gbTimerMask[gbTimerMode]) + 1 - ticks;
+		gbTimerOnChange	  = false;
+		gbTimerModeChange = false;
+
+		gbMemory[0xff05] = register_TIMA;
+	}
+
+	gbInternalTimer -= ticks;
+	while (gbInternalTimer < 0)
+		gbInternalTimer += 0x100;
+}
+
+// Returns how many ticks can go by before a counter handled in gbEmulate
+// reaches the point where it has to act.
+static int gbGetEventHorizon()
+{
+	int horizon = gbDivTicks;
+
+	if (register_LCDC & 0x80)
+	{
+		int lcdTicks = gbLCDChangeHappened ? gbLcdTicksDelayed : gbLcdTicks;
+		int lyTicks	 = gbLYChangeHappened ? gbLcdLYIncrementTicksDelayed : gbLcdLYIncrementTicks;
+
+		if (lcdTicks < horizon)
+			horizon = lcdTicks;
+		if (lyTicks < horizon)
+			horizon = lyTicks;
+	}
+	else
+	{
+		if (gbLcdLYIncrementTicks < horizon)
+			horizon = gbLcdLYIncrementTicks;
+		if (!gbWhiteScreen && (gbScreenTicks < horizon))
+			horizon = gbScreenTicks;
+	}
+
+	if (gbSgbMode && gbSgbPacketTimeout && (gbSgbPacketTimeout < horizon))
+		horizon = gbSgbPacketTimeout;
+
+#ifdef OLD_GB_LINK
+	if (gbSerialOn && (linkConnected || (gbMemory[0xff02] & 1)) && (gbSerialTicks < horizon))
+#else
+	if (gbSerialOn && (gbMemory[0xff02] & 1) && (gbSerialTicks < horizon))
+#endif
+		horizon = gbSerialTicks;
+
+	// soundTicks runs twice as fast in single speed mode, and ticks on going below 0
+	int soundHorizon = (gbSpeed ? soundTicks : soundTicks / 2) + 1;
+	if (soundHorizon < horizon)
+		horizon = soundHorizon;
+
+	if (gbTimerOn && (((gbInternalTimer) & gbTimerMask[gbTimerMode]) + 1 < horizon))
+		horizon = ((gbInternalTimer) & gbTimerMask[gbTimerMode]) + 1;
+
+	return horizon;
+}
+
 void gbWriteMemoryWrapped(register u16 address, register u8 value)
 {
 	if (address < 0x8000)
@@ -1664,14 +1777,76 @@ void gbWriteMemoryWrapped(register u16 address, register u8 value)
 	gbMemory[address] = value;
 }
 
+INSTANCE_LOCAL u8 **gbReadPages[16];
+INSTANCE_LOCAL u8 **gbOpcodePages[16];
+INSTANCE_LOCAL u8 **gbWritePages[16];
+
+static bool gbCheatOnPage(int page)
+{
+	for (int i = page << 12; i < (page + 1) << 12; i++)
+	{
+		if (gbCheatMap[i])
+			return true;
+	}
+	return false;
+}
+
+void gbUpdateMemoryPages()
+{
+	for (int page = 0; page < 16; page++)
+	{
+		// the echo RAM at 0xe000 goes to 0xc000
+		u8 **map   = &gbMemoryMap[page == 0x0e ? 0x0c : page];
+		bool cheat = gbCheatOnPage(page);
+
+		// gbReadOpcode() has no mapper RAM handling
+		bool plain = page < 0x08 || (page >= 0x0a && page < 0x0f);
+		gbOpcodePages[page] = (plain && !cheat) ? map : NULL;
+
+		if (page == 0x0a || page == 0x0b)
+		{
+			plain = !mapperReadRAM && gbRamSizeMask >= ((page - 0x0a) << 12) + 0x0fff;
+#ifndef FINAL_VERSION
+			plain = plain && !memorydebug;
+#endif
+		}
+		plain = plain && !cheat && !VBALuaMemHookCovers(LUAMEMHOOK_READ, page << 12, 0x1000);
+		gbReadPages[page] = plain ? map : NULL;
+
+		plain = page >= 0x0c && page < 0x0f && !VBALuaMemHookCovers(LUAMEMHOOK_WRITE, page << 12, 0x1000);
+		gbWritePages[page] = plain ? map : NULL;
+	}
+}
+
 void gbWriteMemory(register u16 address, register u8 value)
 {
+	u8 **map = gbWritePages[address >> 12];
+	if (map)
+	{
+		(*map)[address & 0x0fff] = value;
+		return;
+	}
+
+	if (gbPendingTicks && address < 0xff80)
+		gbApplyPendingTicks();
+
 	gbWriteMemoryWrapped(address, value);
+
+	// an I/O register write can change any of the counters' next events
+	if ((address & 0xff80) == 0xff00)
+		gbEventHorizon = 0;
 	CallRegisteredLuaMemHook(address, 1, value, LUAMEMHOOK_WRITE);
 }
 
 u8 gbReadOpcode(register u16 address)
 {
+	u8 **map = gbOpcodePages[address >> 12];
+	if (map)
+		return (*map)[address & 0x0fff];
+
+	if (gbPendingTicks && address < 0xff80)
+		gbApplyPendingTicks();
+
 	if (gbCheatMap[address])
 		return gbCheatRead(address);
 
@@ -2136,6 +2311,13 @@ u8 gbReadMemoryWrapped(register u16 address)
 
 u8 gbReadMemory(register u16 address)
 {
+	u8 **map = gbReadPages[address >> 12];
+	if (map)
+		return (*map)[address & 0x0fff];
+
+	if (gbPendingTicks && address < 0xff80)
+		gbApplyPendingTicks();
+
 	u8 value = gbReadMemoryWrapped(address);
 	CallRegisteredLuaMemHook(address, 1, value, LUAMEMHOOK_READ);
 	return value;
@@ -2184,6 +2366,10 @@ void gbJoypad_interrupt()
 
 void gbSpeedSwitch()
 {
+	if (gbPendingTicks)
+		gbApplyPendingTicks();
+	gbEventHorizon = 0;
+
 	gbBlackScreen = true;
 	if (gbSpeed == 0)
 	{
@@ -2311,6 +2497,8 @@ void gbReset()
 	gbInterruptWait = 0;
 	gbDmaTicks		= 0;
 	gbClockTicks		= 0;
+	gbPendingTicks	= 0;
+	gbEventHorizon	= 0;
 
 	gbWhiteScreen	  = 0;
 	gbBlackScreen	  = false;
@@ -2849,6 +3037,8 @@ void gbReset()
 		gbMemoryMap[0x0b] = &gbRam[0x1000];
 	}
 
+	gbUpdateMemoryPages();
+
 	gbScreenOn		= true;
 	gbSystemMessage = false;
 
@@ -3747,7 +3937,7 @@ static bool gbReadBatteryFromStream(gzFile gzfile)
 	return retVal;
 }
 
-variable_desc gbSaveGameStruct[] = {
+INSTANCE_LOCAL variable_desc gbSaveGameStruct[] = {
 	{ &PC.W,					   sizeof(u16)	 },
 	{ &SP.W,					   sizeof(u16)	 },
 	{ &AF.W,					   sizeof(u16)	 },
@@ -3846,6 +4036,9 @@ variable_desc gbSaveGameStruct[] = {
 
 static bool gbWriteSaveStateToStream(gzFile gzFile)
 {
+	if (gbPendingTicks)
+		gbApplyPendingTicks();
+
 	utilWriteInt(gzFile, GBSAVE_GAME_VERSION);
 	utilGzWrite(gzFile, &gbRom[0x134], 15);
 	utilWriteInt(gzFile, useBios);
@@ -4000,6 +4193,21 @@ bool gbWriteMemSaveState(char *memory, int available)
 	return res;
 }
 
+// Uncompressed memory states, for tools saving and loading states at a high
+// rate; returns the size of the state, or 0 if it didn't fit
+int gbWriteMemSaveStateRaw(char *memory, int available)
+{
+	gzFile gzFile = utilMemRawOpen(memory, available);
+
+	bool res  = gbWriteSaveStateToStream(gzFile);
+	int	 size = utilGzTell(gzFile);
+
+	if (utilGzClose(gzFile) != Z_OK)
+		res = false;
+
+	return res ? size : 0;
+}
+
 bool gbWriteSaveState(const char *name)
 {
 	gzFile gzFile = utilGzOpen(name, "wb");
@@ -4015,6 +4223,10 @@ bool gbWriteSaveState(const char *name)
 
 static bool gbReadSaveStateFromStream(gzFile gzFile)
 {
+	if (gbPendingTicks)
+		gbApplyPendingTicks();
+	gbEventHorizon = 0;
+
 	char tempBackupName[128];
 	if (tempSaveSafe)
 	{
@@ -4537,6 +4749,20 @@ bool gbReadMemSaveState(char *memory, int available)
 	return res;
 }
 
+bool gbReadMemSaveStateRaw(char *memory, int size)
+{
+	gzFile gzFile = utilMemRawOpen(memory, size);
+
+	tempSaveSafe = false;
+	bool res = gbReadSaveStateFromStream(gzFile);
+	tempSaveSafe = true;
+
+	if (utilGzClose(gzFile) != Z_OK)
+		res = false;
+
+	return res;
+}
+
 bool gbReadSaveState(const char *name)
 {
 	gzFile gzFile = utilGzOpen(name, "rb");
@@ -4871,6 +5097,9 @@ bool gbUpdateSizes()
 
 int gbGetNextEvent(int _gbClockTicks)
 {
+	if (gbPendingTicks)
+		gbApplyPendingTicks();
+
 	if (register_LCDC & 0x80)
 	{
 		if (gbLcdTicks < _gbClockTicks)
@@ -4901,6 +5130,72 @@ int gbGetNextEvent(int _gbClockTicks)
 	return _gbClockTicks;
 }
 
+// Checks for "LDH A,(41h or 44h) / CP or AND n / JR cc,-6" at address,
+// a loop that does nothing but wait for LY or STAT to change.
+static bool gbIsPollLoop(u16 address)
+{
+	u8 **map = gbOpcodePages[address >> 12];
+	if (!map || (address & 0x0fff) > 0x0ffa)
+		return false;
+
+	const u8 *code = *map + (address & 0x0fff);
+	if ((code[0] != 0xf0) || (code[1] != 0x41 && code[1] != 0x44) ||
+	    (code[2] != 0xfe && code[2] != 0xe6) || ((code[4] & 0xe7) != 0x20) || (code[5] != 0xfa))
+		return false;
+
+	u16 reg = 0xff00 | code[1];
+	return !gbCheatMap[reg] &&
+	       !VBALuaMemHookCovers(LUAMEMHOOK_READ, reg, 1) &&
+	       !VBALuaMemHookCovers(LUAMEMHOOK_EXEC, address, 6);
+}
+
+// Returns how many ticks LY and STAT are sure to read the same, or 0.
+static int gbGetPollEvent()
+{
+	if (!(register_LCDC & 0x80) || gbInterruptWait)
+		return 0;
+
+	int ticks = gbGetNextEvent(0x7fffffff);
+
+	// LY reads as 0 for one tick near the end of line 153
+	if ((gbHardware & 7) && (gbLcdMode == 1) && (gbLcdTicks > 0x71) && (gbLcdTicks - 0x71 < ticks))
+		ticks = gbLcdTicks - 0x71;
+
+	return ticks;
+}
+
+// Returns the instruction at PC.W if it completes one of the opcode pairs that
+// gbEmulate runs back to back, or -1: LD A,(HL+) and the store that usually
+// follows it in copy loops, and DEC r followed by JR NZ.
+static int gbGetFusedOpcode(int opcode)
+{
+	u8 **map = gbOpcodePages[PC.W >> 12];
+	if (!map)
+		return -1;
+
+	int next = (*map)[PC.W & 0x0fff];
+	if (opcode == 0x2a)
+	{
+		switch (next)
+		{
+		case 0x02: // LD (BC),A
+		case 0x12: // LD (DE),A
+		case 0x22: // LDI (HL),A
+		case 0x77: // LD (HL),A
+		case 0xe0: // LDH (NN),A
+		case 0xe2: // LDH (C),A
+		case 0xea: // LD (NNNN),A
+			return next;
+		}
+		return -1;
+	}
+
+	if (((opcode & 0xc7) == 0x05) && (next == 0x20))
+		return next;
+
+	return -1;
+}
+
 static void gbDrawPixLine()
 {
 	switch (systemColorDepth)
@@ -4910,108 +5205,26 @@ static void gbDrawPixLine()
 		u16 *dest = (u16 *)pix +
 		            (gbBorderLineSkip + 2) * (register_LY + gbBorderRowSkip + 1)
 		            + gbBorderColumnSkip;
-		for (int x = 0; x < 160; )
-		{
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-			*dest++ = systemColorMap16[gbLineMix[x++]];
-		}
+		colorConvertLine16(dest, gbLineMix, 160);
+		dest += 160;
 		if (gbBorderOn)
 			dest += gbBorderColumnSkip;
-		*dest++ = 0; // for filters that read one pixel more
+		*dest = 0; // for filters that read one pixel more
 		break;
 	}
 	case 24:
-	{
-		u8 *dest = (u8 *)pix +
-		           3 * (gbBorderLineSkip * (register_LY + gbBorderRowSkip) +
-		                gbBorderColumnSkip);
-		for (int x = 0; x < 160; )
-		{
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[gbLineMix[x++]];
-			dest += 3;
-		}
+		colorConvertLine24((u8 *)pix +
+		                   3 * (gbBorderLineSkip * (register_LY + gbBorderRowSkip) +
+		                        gbBorderColumnSkip),
+		                   gbLineMix, 160);
 		break;
-	}
 	case 32:
-	{
-		u32 *dest = (u32 *)pix +
-		            (gbBorderLineSkip + 1) * (register_LY + gbBorderRowSkip + 1)
-		            + gbBorderColumnSkip;
-		for (int x = 0; x < 160; )
-		{
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-			*dest++ = systemColorMap32[gbLineMix[x++]];
-		}
+		colorConvertLine32((u32 *)pix +
+		                   (gbBorderLineSkip + 1) * (register_LY + gbBorderRowSkip + 1)
+		                   + gbBorderColumnSkip,
+		                   gbLineMix, 160);
 		break;
 	}
-	}
 }
 
 static inline void gbGetUserInput()
@@ -5079,10 +5292,45 @@ static inline void gbFrameBoundaryWork()
 	systemFrameBoundaryWork();
 }
 
+// gbCodes.h and gbCodesCB.h label every opcode with GB_OPCODE/GB_OPCODE_CB.
+// Building with GB_COMPUTED_GOTO on GCC or Clang makes them jump to it
+// through a table of label addresses instead of the switch. As every
+// instruction goes back through the timing code below, there is still only
+// one dispatch site, and the switch's jump table does as well, so the
+// switch is the default.
+#if defined(GB_COMPUTED_GOTO) && defined(__GNUC__)
+#define GB_OPCODE(n)	case n: gbOp##n:
+#define GB_OPCODE_CB(n) case n: gbOpCB##n:
+#define GB_DISPATCH(labels, opcode) goto *labels[opcode];
+
+#define GB_LABEL_ROW(p, h) \
+	&&p##0x##h##0, &&p##0x##h##1, &&p##0x##h##2, &&p##0x##h##3, \
+	&&p##0x##h##4, &&p##0x##h##5, &&p##0x##h##6, &&p##0x##h##7, \
+	&&p##0x##h##8, &&p##0x##h##9, &&p##0x##h##a, &&p##0x##h##b, \
+	&&p##0x##h##c, &&p##0x##h##d, &&p##0x##h##e, &&p##0x##h##f
+#define GB_LABEL_TABLE(p) \
+	GB_LABEL_ROW(p, 0), GB_LABEL_ROW(p, 1), GB_LABEL_ROW(p, 2), GB_LABEL_ROW(p, 3), \
+	GB_LABEL_ROW(p, 4), GB_LABEL_ROW(p, 5), GB_LABEL_ROW(p, 6), GB_LABEL_ROW(p, 7), \
+	GB_LABEL_ROW(p, 8), GB_LABEL_ROW(p, 9), GB_LABEL_ROW(p, a), GB_LABEL_ROW(p, b), \
+	GB_LABEL_ROW(p, c), GB_LABEL_ROW(p, d), GB_LABEL_ROW(p, e), GB_LABEL_ROW(p, f)
+#else
+#define GB_OPCODE(n)	case n:
+#define GB_OPCODE_CB(n) case n:
+#define GB_DISPATCH(labels, opcode)
+#endif
+
 void gbEmulate(int ticksToStop)
 {
 	gbBeforeEmulation();
 
+	// the counters may have been changed from outside since the last call
+	gbEventHorizon = 0;
+
+#ifdef GB_LABEL_TABLE
+	static const void *const gbOpcodeLabels[256]   = { GB_LABEL_TABLE(gbOp) };
+	static const void *const gbOpcodeLabelsCB[256] = { GB_LABEL_TABLE(gbOpCB) };
+#endif
+
 	gbRegister tempRegister;
 	u8		   tempValue;
 	s8		   offset;
@@ -5095,6 +5343,11 @@ void gbEmulate(int ticksToStop)
 	bool execute = false;
 	bool newVideoFrame = false;
 
+	// the last LY/STAT wait loop seen, see below
+	int pollPC	  = -1;
+	int pollTicks = 0;
+	int pollEvent = 0;
+
 	for (;;)
 	{
 #ifndef FINAL_VERSION
@@ -5154,6 +5407,10 @@ void gbEmulate(int ticksToStop)
 			// First we apply the gbClockTicks, then we execute the opcodes.
 			execute = true;
 
+			// anything run outside the wait loop spoils its round timing
+			if ((u16)(PC.W - pollPC) > 4)
+				pollPC = -1;
+
 			register int opcode;
 			opcode2 = opcode1 = opcode = gbReadOpcode(PC.W);
 			CallRegisteredLuaMemHook(PC.W, 1, opcode, LUAMEMHOOK_EXEC);
@@ -5190,6 +5447,8 @@ void gbEmulate(int ticksToStop)
 		if ((gbClockTicks == 0) && execute)
 		{
 			PC.W = oldPCW;
+			if (gbPendingTicks)
+				gbApplyPendingTicks();
 			return;
 		}
 
@@ -5221,6 +5480,20 @@ gbRedoLoop:
 				IFF &= 0x82;
 		}
 
+		ticksToStop -= gbClockTicks;
+
+		// Most instructions end before any of the counters below is due, so
+		// their ticks are only added up until gbEventHorizon is reached.
+		// Memory accesses that look at the counters catch them up first.
+		if (gbPendingTicks + gbClockTicks < gbEventHorizon)
+		{
+			gbPendingTicks += gbClockTicks;
+			goto gbCountersDone;
+		}
+
+		gbClockTicks  += gbPendingTicks;
+		gbPendingTicks = 0;
+
 		if (register_LCDCBusy)
 		{
 			register_LCDCBusy -= gbClockTicks;
@@ -5239,8 +5512,6 @@ gbRedoLoop:
 			}
 		}
 
-		ticksToStop -= gbClockTicks;
-
 		// DIV register emulation
 		gbDivTicks -= gbClockTicks;
 		while (gbDivTicks <= 0)
@@ -5551,15 +5822,14 @@ gbRedoLoop:
 						{
 							if (!gbSgbMask)
 							{
-								if (!gbBlackScreen)
-								{
-									gbRenderLine();
-									gbDrawSprites(true);
-								}
-
 								if (systemFrameDrawingRequired())
 								{
-									if (gbBlackScreen)
+									if (!gbBlackScreen)
+									{
+										gbRenderLine();
+										gbDrawSprites(true);
+									}
+									else
 									{
 										u16 color = gbColorOption ? gbColorFilter[0] : 0;
 										if (!gbCgbMode)
@@ -5572,6 +5842,10 @@ gbRedoLoop:
 									}
 									gbDrawPixLine();
 								}
+								else if (!gbBlackScreen)
+								{
+									gbSkipLine();
+								}
 							}
 						}
 						gbLcdTicksDelayed += GBLCD_MODE_0_CLOCK_TICKS - gbSpritesTicks[299];
@@ -5636,7 +5910,7 @@ gbRedoLoop:
 				{
 					gbWhiteScreen = 1;
 					u8 register_LYLcdOff = ((register_LY + 154) % 154);
-					for (register_LY = 0; register_LY <=  0x90; register_LY++)
+					for (register_LY = 0; register_LY <= 0x90 && systemFrameDrawingRequired(); register_LY++)
 					{
 						u16 color = gbColorOption ? gbColorFilter[0x7FFF] : 0x7FFF;
 						if (!gbCgbMode)
@@ -5668,7 +5942,7 @@ gbRedoLoop:
 
 					register_LY = ((register_LY + 1) % 154);
 					gbLcdLYIncrementTicks += GBLY_INCREMENT_CLOCK_TICKS;
-					if (register_LY < 144)
+					if (register_LY < 144 && systemFrameDrawingRequired())
 					{
 						u16 color = gbColorOption ? gbColorFilter[0x7FFF] : 0x7FFF;
 						if (!gbCgbMode)
@@ -5792,6 +6066,9 @@ gbRedoLoop:
 		while (gbInternalTimer < 0)
 			gbInternalTimer += 0x100;
 
+		gbEventHorizon = gbGetEventHorizon();
+
+gbCountersDone:
 		gbClockTicks = 0;
 
 		if (gbIntBreak == 1)
@@ -5816,6 +6093,7 @@ gbRedoLoop:
 		// Executes the opcode(s), and apply the instruction's remaining gbClockTicks (if any).
 		if (execute)
 		{
+gbExecuteOpcode:
 #include "gbCodes.h"
 
 			execute = false;
@@ -5825,11 +6103,72 @@ gbRedoLoop:
 				gbDmaTicks += gbClockTicks;
 				gbClockTicks	= 0;
 			}
+
+			// A taken JR back to a wait loop on LY or STAT: if nothing that
+			// could change them happened during the last round, the next
+			// rounds read the same value until gbGetPollEvent() runs out,
+			// so their ticks are added to gbDmaTicks instead of running them.
+			if (((opcode1 & 0xe7) == 0x20) && (PC.W == (u16)(oldPCW - 4)) && gbIsPollLoop(PC.W)
+#ifndef FINAL_VERSION
+			    && !systemDebug
+#endif
+			    )
+			{
+				int loopTicks = pollTicks - ticksToStop;
+				int nextEvent = gbGetPollEvent();
+				int skip	  = 0;
+
+				if ((PC.W == pollPC) && (loopTicks > 0) && (loopTicks < pollEvent) && !(IFF & 0xfe) &&
+				    !((register_IE & register_IF & 0x1f) && (IFF & 1)))
+				{
+					int limit = nextEvent - 1;
+					if (useOldFrameTiming && (ticksToStop - loopTicks - 1 < limit))
+						limit = ticksToStop - loopTicks - 1;
+
+					if (limit > 0)
+						skip = limit - limit % loopTicks;
+					gbDmaTicks += skip;
+				}
+
+				pollPC	  = PC.W;
+				pollTicks = ticksToStop - skip;
+				pollEvent = nextEvent - skip;
+			}
+
+			// The second instruction of a pair runs right away when the work
+			// between the two would do nothing: no interrupt, EI/HALT state,
+			// extra ticks or frame end pending, and all of its ticks staying
+			// below gbEventHorizon like in the first pass of the loop above.
+			int fused = ((opcode1 == 0x2a) || ((opcode1 & 0xc7) == 0x05)) ? gbGetFusedOpcode(opcode1) : -1;
+			if ((fused >= 0) && !gbDmaTicks && !newVideoFrame && !newFrame && emulating &&
+			    !(IFF & 0xfe) && !gbInterruptWait && !(register_IE & register_IF & 0x1f) &&
+			    (!useOldFrameTiming || (ticksToStop > 0)) &&
+			    (gbPendingTicks + gbCycles[fused] < gbEventHorizon) &&
+			    !VBALuaMemHookCovers(LUAMEMHOOK_EXEC, PC.W, 1)
+#ifndef FINAL_VERSION
+			    && !systemDebug
+#endif
+			    )
+			{
+				if ((u16)(PC.W - pollPC) > 4)
+					pollPC = -1;
+
+				oldPCW	= PC.W++;
+				opcode2 = opcode1 = fused;
+
+				ticksToStop	   -= gbCycles[fused];
+				gbPendingTicks += gbCycles[fused];
+				gbInterruptLaunched = 0;
+				gbBlackScreen		= false;
+				goto gbExecuteOpcode;
+			}
 		}
 
 		if (newVideoFrame)
 		{
 			newVideoFrame = false;
+			if (gbPendingTicks)
+				gbApplyPendingTicks();
 			gbFrameBoundaryWork();
 		}
 
@@ -5926,6 +6265,9 @@ gbRedoLoop:
 			break;
 		}
 	}
+
+	if (gbPendingTicks)
+		gbApplyPendingTicks();
 }
 
 struct EmulatedSystem GBSystem =
@@ -5956,6 +6298,12 @@ struct EmulatedSystem GBSystem =
 	gbReadMemSaveState,
 	// emuWriteMemState
 	gbWriteMemSaveState,
+	// emuReadMemStateRaw
+	gbReadMemSaveStateRaw,
+	// emuWriteMemStateRaw
+	gbWriteMemSaveStateRaw,
+	// emuWriteMemStateIncremental
+	NULL,
 	// emuWritePNG
 	gbWritePNGFile,
 	// emuWriteBMP
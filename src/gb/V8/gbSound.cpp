@@ -13,79 +13,79 @@
 
 extern u8 soundWavePattern[4][32];
 
-extern int32 soundLevel1;
-extern int32 soundLevel2;
-extern int32 soundBalance;
-extern int32 soundMasterOn;
-int32		 soundVIN = 0;
-extern int32 soundDebug;
-
-extern int32 sound1On;
-extern int32 sound1ATL;
-int32		 sound1ATLreload;
-int32		 freq1low;
-int32		 freq1high;
-extern int32 sound1Skip;
-extern int32 sound1Index;
-extern int32 sound1Continue;
-extern int32 sound1EnvelopeVolume;
-extern int32 sound1EnvelopeATL;
-extern int32 sound1EnvelopeUpDown;
-extern int32 sound1EnvelopeATLReload;
-extern int32 sound1SweepATL;
-extern int32 sound1SweepATLReload;
-extern int32 sound1SweepSteps;
-extern int32 sound1SweepUpDown;
-extern int32 sound1SweepStep;
-extern u8 *	 sound1Wave;
-
-extern int32 sound2On;
-extern int32 sound2ATL;
-int32		 sound2ATLreload;
-int32		 freq2low;
-int32		 freq2high;
-extern int32 sound2Skip;
-extern int32 sound2Index;
-extern int32 sound2Continue;
-extern int32 sound2EnvelopeVolume;
-extern int32 sound2EnvelopeATL;
-extern int32 sound2EnvelopeUpDown;
-extern int32 sound2EnvelopeATLReload;
-extern u8 *	 sound2Wave;
-
-extern int32 sound3On;
-extern int32 sound3ATL;
-int32		 sound3ATLreload;
-int32		 freq3low;
-int32		 freq3high;
-extern int32 sound3Skip;
-extern int32 sound3Index;
-extern int32 sound3Continue;
-extern int32 sound3OutputLevel;
-extern int32 sound3Last;
-
-extern int32 sound4On;
-extern int32 sound4Clock;
-extern int32 sound4ATL;
-int32		 sound4ATLreload;
-int32		 freq4;
-extern int32 sound4Skip;
-extern int32 sound4Index;
-extern int32 sound4ShiftRight;
-extern int32 sound4ShiftSkip;
-extern int32 sound4ShiftIndex;
-extern int32 sound4NSteps;
-extern int32 sound4CountDown;
-extern int32 sound4Continue;
-extern int32 sound4EnvelopeVolume;
-extern int32 sound4EnvelopeATL;
-extern int32 sound4EnvelopeUpDown;
-extern int32 sound4EnvelopeATLReload;
+extern INSTANCE_LOCAL int32 soundLevel1;
+extern INSTANCE_LOCAL int32 soundLevel2;
+extern INSTANCE_LOCAL int32 soundBalance;
+extern INSTANCE_LOCAL int32 soundMasterOn;
+INSTANCE_LOCAL int32		 soundVIN = 0;
+extern INSTANCE_LOCAL int32 soundDebug;
+
+extern INSTANCE_LOCAL int32 sound1On;
+extern INSTANCE_LOCAL int32 sound1ATL;
+INSTANCE_LOCAL int32		 sound1ATLreload;
+INSTANCE_LOCAL int32		 freq1low;
+INSTANCE_LOCAL int32		 freq1high;
+extern INSTANCE_LOCAL int32 sound1Skip;
+extern INSTANCE_LOCAL int32 sound1Index;
+extern INSTANCE_LOCAL int32 sound1Continue;
+extern INSTANCE_LOCAL int32 sound1EnvelopeVolume;
+extern INSTANCE_LOCAL int32 sound1EnvelopeATL;
+extern INSTANCE_LOCAL int32 sound1EnvelopeUpDown;
+extern INSTANCE_LOCAL int32 sound1EnvelopeATLReload;
+extern INSTANCE_LOCAL int32 sound1SweepATL;
+extern INSTANCE_LOCAL int32 sound1SweepATLReload;
+extern INSTANCE_LOCAL int32 sound1SweepSteps;
+extern INSTANCE_LOCAL int32 sound1SweepUpDown;
+extern INSTANCE_LOCAL int32 sound1SweepStep;
+extern INSTANCE_LOCAL u8 *	 sound1Wave;
+
+extern INSTANCE_LOCAL int32 sound2On;
+extern INSTANCE_LOCAL int32 sound2ATL;
+INSTANCE_LOCAL int32		 sound2ATLreload;
+INSTANCE_LOCAL int32		 freq2low;
+INSTANCE_LOCAL int32		 freq2high;
+extern INSTANCE_LOCAL int32 sound2Skip;
+extern INSTANCE_LOCAL int32 sound2Index;
+extern INSTANCE_LOCAL int32 sound2Continue;
+extern INSTANCE_LOCAL int32 sound2EnvelopeVolume;
+extern INSTANCE_LOCAL int32 sound2EnvelopeATL;
+extern INSTANCE_LOCAL int32 sound2EnvelopeUpDown;
+extern INSTANCE_LOCAL int32 sound2EnvelopeATLReload;
+extern INSTANCE_LOCAL u8 *	 sound2Wave;
+
+extern INSTANCE_LOCAL int32 sound3On;
+extern INSTANCE_LOCAL int32 sound3ATL;
+INSTANCE_LOCAL int32		 sound3ATLreload;
+INSTANCE_LOCAL int32		 freq3low;
+INSTANCE_LOCAL int32		 freq3high;
+extern INSTANCE_LOCAL int32 sound3Skip;
+extern INSTANCE_LOCAL int32 sound3Index;
+extern INSTANCE_LOCAL int32 sound3Continue;
+extern INSTANCE_LOCAL int32 sound3OutputLevel;
+extern INSTANCE_LOCAL int32 sound3Last;
+
+extern INSTANCE_LOCAL int32 sound4On;
+extern INSTANCE_LOCAL int32 sound4Clock;
+extern INSTANCE_LOCAL int32 sound4ATL;
+INSTANCE_LOCAL int32		 sound4ATLreload;
+INSTANCE_LOCAL int32		 freq4;
+extern INSTANCE_LOCAL int32 sound4Skip;
+extern INSTANCE_LOCAL int32 sound4Index;
+extern INSTANCE_LOCAL int32 sound4ShiftRight;
+extern INSTANCE_LOCAL int32 sound4ShiftSkip;
+extern INSTANCE_LOCAL int32 sound4ShiftIndex;
+extern INSTANCE_LOCAL int32 sound4NSteps;
+extern INSTANCE_LOCAL int32 sound4CountDown;
+extern INSTANCE_LOCAL int32 sound4Continue;
+extern INSTANCE_LOCAL int32 sound4EnvelopeVolume;
+extern INSTANCE_LOCAL int32 sound4EnvelopeATL;
+extern INSTANCE_LOCAL int32 sound4EnvelopeUpDown;
+extern INSTANCE_LOCAL int32 sound4EnvelopeATLReload;
 
 extern int32 soundFreqRatio[8];
 extern int32 soundShiftClock[16];
 
-bool8 gbDigitalSound = false;
+INSTANCE_LOCAL bool8 gbDigitalSound = false;
 
 void gbSoundEvent(register u16 address, register int data)
 {
@@ -828,9 +828,9 @@ void gbSoundReset()
 }
 
 // dummy
-static int32 soundTicks_int32;
-static int32 soundTickStep_int32;
-variable_desc gbSoundSaveStruct[] = {
+static INSTANCE_LOCAL int32 soundTicks_int32;
+static INSTANCE_LOCAL int32 soundTickStep_int32;
+INSTANCE_LOCAL variable_desc gbSoundSaveStruct[] = {
 	{ &soundPaused,				sizeof(int32) },
 	{ &soundPlay,				sizeof(int32) },
 	{ &soundTicks_int32,		sizeof(int32) },
@@ -11,12 +11,12 @@
 #include "gbCheats.h"
 #include "gbGlobals.h"
 
-gbCheat gbCheatList[100];
-int		gbCheatNumber = 0;
-int		gbNextCheat	  = 0;
-bool	gbCheatMap[0x10000];
+INSTANCE_LOCAL gbCheat gbCheatList[100];
+INSTANCE_LOCAL int		gbCheatNumber = 0;
+INSTANCE_LOCAL int		gbNextCheat	  = 0;
+INSTANCE_LOCAL bool	gbCheatMap[0x10000];
 
-extern bool8 cheatsEnabled;
+extern INSTANCE_LOCAL bool8 cheatsEnabled;
 
 #define GBCHEAT_IS_HEX(a) (((a) >= 'A' && (a) <= 'F') || ((a) >= '0' && (a) <= '9'))
 #define GBCHEAT_HEX_VALUE(a) ((a) >= 'A' ? (a) - 'A' + 10 : (a) - '0')
@@ -30,6 +30,9 @@ void gbCheatUpdateMap()
 		if (gbCheatList[i].enabled)
 			gbCheatMap[gbCheatList[i].address] = true;
 	}
+#ifndef USE_GB_CORE_V7
+	gbUpdateMemoryPages();
+#endif
 }
 
 void gbCheatsSaveGame(gzFile gzFile)
@@ -400,6 +403,9 @@ bool gbAddGgCheat(const char *code, const char *desc)
 	gbCheatList[i].enabled = true;
 
 	gbCheatMap[gbCheatList[i].address] = true;
+#ifndef USE_GB_CORE_V7
+	gbUpdateMemoryPages();
+#endif
 
 	gbCheatNumber++;
 
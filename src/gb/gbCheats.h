@@ -44,8 +44,8 @@ bool gbVerifyGgCode(const char *code);
 #define MAX_CHEATS 100
 #endif
 
-extern int	   gbCheatNumber;
-extern gbCheat gbCheatList[MAX_CHEATS];
-extern bool	   gbCheatMap[0x10000];
+extern INSTANCE_LOCAL int	   gbCheatNumber;
+extern INSTANCE_LOCAL gbCheat gbCheatList[MAX_CHEATS];
+extern INSTANCE_LOCAL bool	   gbCheatMap[0x10000];
 
 #endif // VBA_GB_CHEATS_H
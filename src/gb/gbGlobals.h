@@ -7,21 +7,21 @@
 
 #include "../Port.h"
 
-extern int32 gbRomSizeMask;
-extern int32 gbRomSize;
-extern int32 gbRamSize;
-extern int32 gbRamSizeMask;
-extern int32 gbTAMA5ramSize;
-
-extern u8 * gbRom;
-extern u8 * gbRam;
-extern u8 * gbVram;
-extern u8 * gbWram;
-extern u8 * gbMemory;
-extern u16 *gbLineBuffer;
-extern u8 * gbTAMA5ram;
-
-extern u8 *gbMemoryMap[16];
+extern INSTANCE_LOCAL int32 gbRomSizeMask;
+extern INSTANCE_LOCAL int32 gbRomSize;
+extern INSTANCE_LOCAL int32 gbRamSize;
+extern INSTANCE_LOCAL int32 gbRamSizeMask;
+extern INSTANCE_LOCAL int32 gbTAMA5ramSize;
+
+extern INSTANCE_LOCAL u8 * gbRom;
+extern INSTANCE_LOCAL u8 * gbRam;
+extern INSTANCE_LOCAL u8 * gbVram;
+extern INSTANCE_LOCAL u8 * gbWram;
+extern INSTANCE_LOCAL u8 * gbMemory;
+extern INSTANCE_LOCAL u16 *gbLineBuffer;
+extern INSTANCE_LOCAL u8 * gbTAMA5ram;
+
+extern INSTANCE_LOCAL u8 *gbMemoryMap[16];
 
 extern const u32 gbFrameRateDividend;
 extern const u32 gbFrameRateDivisor;
@@ -30,8 +30,8 @@ extern const double gbFrameRate;
 extern const u32 gbPixBufferSize;
 
 #ifdef USE_GB_CORE_V7
-extern bool gbEchoRAMFixOn;
-extern bool gbDMASpeedVersion;
+extern INSTANCE_LOCAL bool gbEchoRAMFixOn;
+extern INSTANCE_LOCAL bool gbDMASpeedVersion;
 #endif
 
 static inline u8 gbReadMemoryQuick(u16 address)
@@ -122,55 +122,66 @@ static inline u8 gbReadROMQuick32(u32 addr)
 		gbReadROMQuick(addr & gbRomSizeMask);
 }
 
-extern u16	 gbColorFilter[32768];
-extern int32 gbColorOption;
-extern int32 gbPaletteOption;
-extern int32 gbEmulatorType;
-extern int32 gbHardware;
-extern int32 gbBorderOn;
-extern int32 gbBorderAutomatic;
-extern int32 gbCgbMode;
-extern int32 gbSgbMode;
-extern int32 gbWindowLine;
-extern int32 gbSpeed;
-extern u8	 gbBgp[4];
-extern u8	 gbObp0[4];
-extern u8	 gbObp1[4];
-extern u16	 gbPalette[128];
+extern INSTANCE_LOCAL u16	 gbColorFilter[32768];
+extern INSTANCE_LOCAL int32 gbColorOption;
+extern INSTANCE_LOCAL int32 gbPaletteOption;
+extern INSTANCE_LOCAL int32 gbEmulatorType;
+extern INSTANCE_LOCAL int32 gbHardware;
+extern INSTANCE_LOCAL int32 gbBorderOn;
+extern INSTANCE_LOCAL int32 gbBorderAutomatic;
+extern INSTANCE_LOCAL int32 gbCgbMode;
+extern INSTANCE_LOCAL int32 gbSgbMode;
+extern INSTANCE_LOCAL int32 gbWindowLine;
+extern INSTANCE_LOCAL int32 gbSpeed;
+extern INSTANCE_LOCAL u8	 gbBgp[4];
+extern INSTANCE_LOCAL u8	 gbObp0[4];
+extern INSTANCE_LOCAL u8	 gbObp1[4];
+extern INSTANCE_LOCAL u16	 gbPalette[128];
 
 #ifdef USE_GB_CORE_V7
 #else
-extern bool	 genericflashcardEnable;
-extern bool	 gbScreenOn;
+extern INSTANCE_LOCAL bool	 genericflashcardEnable;
+extern INSTANCE_LOCAL bool	 gbScreenOn;
 extern u8	 oldRegister_WY;
 
 // gbSCXLine is used for the emulation (bug) of the SX change
 // found in the Artic Zone game.
-extern u8 gbSCXLine[300];
-extern u8 gbSCYLine[300];
+extern INSTANCE_LOCAL u8 gbSCXLine[300];
+extern INSTANCE_LOCAL u8 gbSCYLine[300];
 
 // gbBgpLine is used for the emulation of the
 // Prehistorik Man's title screen scroller.
-extern u8 gbBgpLine[300];
-extern u8 gbObp0Line [300];
-extern u8 gbObp1Line [300];
+extern INSTANCE_LOCAL u8 gbBgpLine[300];
+extern INSTANCE_LOCAL u8 gbObp0Line [300];
+extern INSTANCE_LOCAL u8 gbObp1Line [300];
 
 // gbSpritesTicks is used for the emulation of Parodius' Laser Beam.
-extern u8 gbSpritesTicks[300];
+extern INSTANCE_LOCAL u8 gbSpritesTicks[300];
+
+// The gbMemoryMap slot that plain accesses to each 4 KB page go through, or
+// NULL when the page needs the full decode (I/O registers, VRAM and OAM
+// timing, mapper RAM handlers, cheats, Lua memory hooks). Rebuilt by
+// gbUpdateMemoryPages() whenever one of those changes; bank switches only
+// repoint gbMemoryMap and leave the tables alone.
+extern INSTANCE_LOCAL u8 **gbReadPages[16];
+extern INSTANCE_LOCAL u8 **gbOpcodePages[16];
+extern INSTANCE_LOCAL u8 **gbWritePages[16];
+
+extern void gbUpdateMemoryPages();
 #endif
 
-extern u8 register_LCDC;
-extern u8 register_LY;
-extern u8 register_SCY;
-extern u8 register_SCX;
-extern u8 register_WY;
-extern u8 register_WX;
-extern u8 register_VBK;
+extern INSTANCE_LOCAL u8 register_LCDC;
+extern INSTANCE_LOCAL u8 register_LY;
+extern INSTANCE_LOCAL u8 register_SCY;
+extern INSTANCE_LOCAL u8 register_SCX;
+extern INSTANCE_LOCAL u8 register_WY;
+extern INSTANCE_LOCAL u8 register_WX;
+extern INSTANCE_LOCAL u8 register_VBK;
 
-extern int32 gbBorderLineSkip;
-extern int32 gbBorderRowSkip;
-extern int32 gbBorderColumnSkip;
-extern int32 gbDmaTicks;
+extern INSTANCE_LOCAL int32 gbBorderLineSkip;
+extern INSTANCE_LOCAL int32 gbBorderRowSkip;
+extern INSTANCE_LOCAL int32 gbBorderColumnSkip;
+extern INSTANCE_LOCAL int32 gbDmaTicks;
 
 extern void gbRenderLine();
 
@@ -178,8 +189,9 @@ extern void gbRenderLine();
 extern void gbDrawSprites();
 #else
 extern void gbDrawSprites(bool);
+extern void gbSkipLine();
 #endif
 
-extern u8 (*gbSerialFunction)(u8);
+extern INSTANCE_LOCAL u8 (*gbSerialFunction)(u8);
 
 #endif // VBA_GB_GLOBALS_H
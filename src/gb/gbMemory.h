@@ -150,15 +150,15 @@ struct mapperGS3
 	int32 mapperROMBank;
 };
 
-extern mapperMBC1  gbDataMBC1;
-extern mapperMBC2  gbDataMBC2;
-extern mapperMBC3  gbDataMBC3;
-extern mapperMBC5  gbDataMBC5;
-extern mapperHuC1  gbDataHuC1;
-extern mapperHuC3  gbDataHuC3;
-extern mapperTAMA5 gbDataTAMA5;
-extern mapperMMM01 gbDataMMM01;
-extern mapperGS3   gbDataGS3;
+extern INSTANCE_LOCAL mapperMBC1  gbDataMBC1;
+extern INSTANCE_LOCAL mapperMBC2  gbDataMBC2;
+extern INSTANCE_LOCAL mapperMBC3  gbDataMBC3;
+extern INSTANCE_LOCAL mapperMBC5  gbDataMBC5;
+extern INSTANCE_LOCAL mapperHuC1  gbDataHuC1;
+extern INSTANCE_LOCAL mapperHuC3  gbDataHuC3;
+extern INSTANCE_LOCAL mapperTAMA5 gbDataTAMA5;
+extern INSTANCE_LOCAL mapperMMM01 gbDataMMM01;
+extern INSTANCE_LOCAL mapperGS3   gbDataGS3;
 
 void mapperMBC1ROM(u16, u8);
 void mapperMBC1RAM(u16, u8);
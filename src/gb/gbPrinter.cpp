@@ -3,14 +3,14 @@
 
 #include "../common/System.h"
 
-u8	gbPrinterStatus = 0;
-int gbPrinterState	= 0;
-u8	gbPrinterData[0x280 * 9];
-u8	gbPrinterPacket[0x400];
-int gbPrinterCount	   = 0;
-int gbPrinterDataCount = 0;
-int gbPrinterDataSize  = 0;
-int gbPrinterResult	   = 0;
+INSTANCE_LOCAL u8	gbPrinterStatus = 0;
+INSTANCE_LOCAL int gbPrinterState	= 0;
+INSTANCE_LOCAL u8	gbPrinterData[0x280 * 9];
+INSTANCE_LOCAL u8	gbPrinterPacket[0x400];
+INSTANCE_LOCAL int gbPrinterCount	   = 0;
+INSTANCE_LOCAL int gbPrinterDataCount = 0;
+INSTANCE_LOCAL int gbPrinterDataSize  = 0;
+INSTANCE_LOCAL int gbPrinterResult	   = 0;
 
 bool gbPrinterCheckCRC()
 {
@@ -5,18 +5,18 @@
 #include "../common/System.h"
 #include "../common/Util.h"
 
-extern int32 cpuDmaCount;
+extern INSTANCE_LOCAL int32 cpuDmaCount;
 
-int32 eepromMode	= EEPROM_IDLE;
-int32 eepromByte	= 0;
-int32 eepromBits	= 0;
-int32 eepromAddress = 0;
-u8	  eepromData[0x2000];
-u8	  eepromBuffer[16];
-bool8 eepromInUse = false;
-int32 eepromSize  = 512;
+INSTANCE_LOCAL int32 eepromMode	= EEPROM_IDLE;
+INSTANCE_LOCAL int32 eepromByte	= 0;
+INSTANCE_LOCAL int32 eepromBits	= 0;
+INSTANCE_LOCAL int32 eepromAddress = 0;
+INSTANCE_LOCAL u8	  eepromData[0x2000];
+INSTANCE_LOCAL u8	  eepromBuffer[16];
+INSTANCE_LOCAL bool8 eepromInUse = false;
+INSTANCE_LOCAL int32 eepromSize  = 512;
 
-variable_desc eepromSaveData[] = {
+INSTANCE_LOCAL variable_desc eepromSaveData[] = {
 	{ &eepromMode,		sizeof(int32) },
 	{ &eepromByte,		sizeof(int32) },
 	{ &eepromBits,		sizeof(int32) },
@@ -30,7 +30,7 @@ variable_desc eepromSaveData[] = {
 void eepromInit()
 {
 #ifdef USE_GBA_CORE_V7
-	extern bool sramInitFix;
+	extern INSTANCE_LOCAL bool sramInitFix;
 	if (sramInitFix)
 	{
 		memset(eepromData, 0xff, 0x2000);
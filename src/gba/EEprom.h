@@ -16,9 +16,9 @@ extern void eepromWrite(u32 address, u8 value);
 extern void eepromInit();
 extern void eepromReset();
 extern void eepromErase();
-extern u8    eepromData[0x2000];
-extern bool8 eepromInUse;
-extern int32 eepromSize;
+extern INSTANCE_LOCAL u8    eepromData[0x2000];
+extern INSTANCE_LOCAL bool8 eepromInUse;
+extern INSTANCE_LOCAL int32 eepromSize;
 
 #define EEPROM_IDLE           0
 #define EEPROM_READADDRESS    1
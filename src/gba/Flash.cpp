@@ -19,22 +19,22 @@
 #define FLASH_PROGRAM            8
 #define FLASH_SETBANK            9
 
-u8	  flashSaveMemory[0x20000];
-int32 flashState		  = FLASH_READ_ARRAY;
-int32 flashReadState	  = FLASH_READ_ARRAY;
-int32 flashSize			  = 0x10000;
-int32 flashDeviceID		  = 0x1b;
-int32 flashManufacturerID = 0x32;
-int32 flashBank			  = 0;
+INSTANCE_LOCAL u8	  flashSaveMemory[0x20000];
+INSTANCE_LOCAL int32 flashState		  = FLASH_READ_ARRAY;
+INSTANCE_LOCAL int32 flashReadState	  = FLASH_READ_ARRAY;
+INSTANCE_LOCAL int32 flashSize			  = 0x10000;
+INSTANCE_LOCAL int32 flashDeviceID		  = 0x1b;
+INSTANCE_LOCAL int32 flashManufacturerID = 0x32;
+INSTANCE_LOCAL int32 flashBank			  = 0;
 
-static variable_desc flashSaveData[] = {
+static INSTANCE_LOCAL variable_desc flashSaveData[] = {
 	{ &flashState,		   sizeof(int32) },
 	{ &flashReadState,	   sizeof(int32) },
 	{ &flashSaveMemory[0], 0x10000		 },
 	{ NULL,				   0			 }
 };
 
-static variable_desc flashSaveData2[] = {
+static INSTANCE_LOCAL variable_desc flashSaveData2[] = {
 	{ &flashState,		   sizeof(int32) },
 	{ &flashReadState,	   sizeof(int32) },
 	{ &flashSize,		   sizeof(int32) },
@@ -42,7 +42,7 @@ static variable_desc flashSaveData2[] = {
 	{ NULL,				   0			 }
 };
 
-static variable_desc flashSaveData3[] = {
+static INSTANCE_LOCAL variable_desc flashSaveData3[] = {
 	{ &flashState,		   sizeof(int32) },
 	{ &flashReadState,	   sizeof(int32) },
 	{ &flashSize,		   sizeof(int32) },
@@ -20,7 +20,7 @@ extern void flashReset();
 extern void flashErase();
 extern void flashSetSize(int32 size);
 
-extern int32 flashSize;
-extern u8	 flashSaveMemory[0x20000];
+extern INSTANCE_LOCAL int32 flashSize;
+extern INSTANCE_LOCAL u8	 flashSaveMemory[0x20000];
 
 #endif // VBA_FLASH_H
@@ -28,14 +28,14 @@
 #else
 #define SAVE_GAME_VERSION  SAVE_GAME_VERSION_14
 #endif
-extern void (*cpuSaveGameFunc)(u32, u8);
+extern INSTANCE_LOCAL void (*cpuSaveGameFunc)(u32, u8);
 
 #ifdef BKPT_SUPPORT
-extern u8 freezeWorkRAM[0x40000];
-extern u8 freezeInternalRAM[0x8000];
-extern u8 freezeVRAM[0x18000];
-extern u8 freezePRAM[0x400];
-extern u8 freezeOAM[0x400];
+extern INSTANCE_LOCAL u8 freezeWorkRAM[0x40000];
+extern INSTANCE_LOCAL u8 freezeInternalRAM[0x8000];
+extern INSTANCE_LOCAL u8 freezeVRAM[0x18000];
+extern INSTANCE_LOCAL u8 freezePRAM[0x400];
+extern INSTANCE_LOCAL u8 freezeOAM[0x400];
 #endif
 
 extern bool CPUReadGSASnapshot(const char *);
@@ -54,6 +54,11 @@ extern void CPUUpdateRenderBuffers(bool force);
 extern bool CPUReadMemState(char *, int);
 extern bool CPUReadState(const char *);
 extern bool CPUWriteMemState(char *, int);
+extern bool CPUReadMemStateRaw(char *, int);
+extern int  CPUWriteMemStateRaw(char *, int);
+#ifndef USE_GBA_CORE_V7
+extern int  CPUWriteMemStateIncremental(char *, int);
+#endif
 extern bool CPUWriteState(const char *);
 extern bool CPUReadStateFromStream(gzFile);
 extern bool CPUWriteStateToStream(gzFile);
@@ -66,6 +71,12 @@ extern void CPUInit();
 extern void CPUReset();
 extern void CPULoop(int);
 extern void CPUCheckDMA(int, int);
+#ifndef USE_GBA_CORE_V7
+extern void CPUBlockCacheFlush();
+extern void CPUExternalWrite(u32 address, u32 size);
+extern void CPUExecFeaturesChanged();
+extern int  CPUSoundTicksDue();
+#endif
 #ifdef PROFILING
 extern void cpuProfil(char *buffer, int, u32, int);
 extern void cpuEnableProfiling(int hz);
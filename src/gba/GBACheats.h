@@ -59,15 +59,37 @@ int	 cheatsCheckKeys(u32 keys, u32 extended);
 #define MAX_CHEATS 100
 #endif
 
-extern int        cheatsNumber;
-extern CheatsData cheatsList[MAX_CHEATS];
+extern INSTANCE_LOCAL int        cheatsNumber;
+extern INSTANCE_LOCAL CheatsData cheatsList[MAX_CHEATS];
 
 #define CHEAT_IS_HEX(a) (((a) >= 'A' && (a) <= 'F') || ((a) >= '0' && (a) <= '9'))
 
+#ifndef USE_GBA_CORE_V7
+// ROM patches bypass the CPUWrite* functions, so code decoded from the
+// patched address has to be dropped; unchanged values leave the caches alone
+#define CHEAT_PATCH_ROM_16BIT(a, v) \
+    do { \
+        if (READ16LE(((u16 *)&rom[(a) & 0x1ffffff])) != (u16)(v)) \
+        { \
+            WRITE16LE(((u16 *)&rom[(a) & 0x1ffffff]), v); \
+            CPUExternalWrite(0x08000000 | ((a) & 0x1ffffff), 2); \
+        } \
+    } while (0)
+
+#define CHEAT_PATCH_ROM_32BIT(a, v) \
+    do { \
+        if (READ32LE(((u32 *)&rom[(a) & 0x1ffffff])) != (u32)(v)) \
+        { \
+            WRITE32LE(((u32 *)&rom[(a) & 0x1ffffff]), v); \
+            CPUExternalWrite(0x08000000 | ((a) & 0x1ffffff), 4); \
+        } \
+    } while (0)
+#else
 #define CHEAT_PATCH_ROM_16BIT(a, v) \
     WRITE16LE(((u16 *)&rom[(a) & 0x1ffffff]), v);
 
 #define CHEAT_PATCH_ROM_32BIT(a, v) \
     WRITE32LE(((u32 *)&rom[(a) & 0x1ffffff]), v);
+#endif
 
 #endif // GBA_CHEATS_H
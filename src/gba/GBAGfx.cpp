@@ -1,28 +1,442 @@
+#include <cstdlib>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GFX_MIX_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "../Port.h"
+#include "GBA.h"
+#include "GBAGlobals.h"
+#include "GBAGfx.h"
+#ifndef USE_GBA_CORE_V7
+#include "V8/GBACpu.h"
+#endif
 
 int coeff[32] = {
 	0,   1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
 	16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16
 };
 
-int32 layerEnable = 0xff00;
-
-u32  line0[240];
-u32  line1[240];
-u32  line2[240];
-u32  line3[240];
-u32  lineOBJ[240];
-u32  lineOBJWin[240];
-u32  lineMix[240];
-bool gfxInWin0[240];
-bool gfxInWin1[240];
-int lineOBJpixleft[128];
-
-int gfxBG2Changed = 0;
-int gfxBG3Changed = 0;
-
-int gfxBG2X       = 0;
-int gfxBG2Y       = 0;
-int gfxBG3X       = 0;
-int gfxBG3Y       = 0;
-int gfxLastVCOUNT = 0;
+INSTANCE_LOCAL int32 layerEnable = 0xff00;
+
+INSTANCE_LOCAL u32  line0[240];
+INSTANCE_LOCAL u32  line1[240];
+INSTANCE_LOCAL u32  line2[240];
+INSTANCE_LOCAL u32  line3[240];
+INSTANCE_LOCAL u32  lineOBJ[240];
+INSTANCE_LOCAL u32  lineOBJWin[240];
+INSTANCE_LOCAL u32  lineMix[240];
+INSTANCE_LOCAL bool gfxInWin0[240];
+INSTANCE_LOCAL bool gfxInWin1[240];
+INSTANCE_LOCAL int lineOBJpixleft[128];
+
+INSTANCE_LOCAL int gfxBG2Changed = 0;
+INSTANCE_LOCAL int gfxBG3Changed = 0;
+
+INSTANCE_LOCAL int gfxBG2X       = 0;
+INSTANCE_LOCAL int gfxBG2Y       = 0;
+INSTANCE_LOCAL int gfxBG3X       = 0;
+INSTANCE_LOCAL int gfxBG3Y       = 0;
+INSTANCE_LOCAL int gfxLastVCOUNT = 0;
+
+#ifndef USE_GBA_CORE_V7
+INSTANCE_LOCAL GfxTile *gfxTileCache = NULL;
+INSTANCE_LOCAL u32		gfxTileVramGen[0x200];
+INSTANCE_LOCAL u32		gfxTilePaletteGen[2];
+
+INSTANCE_LOCAL u8	 gfxOBJBin[160][128];
+INSTANCE_LOCAL u8	 gfxOBJBinCount[160];
+INSTANCE_LOCAL bool8 gfxOBJBinsValid = false;
+
+bool gfxTileCacheInit()
+{
+	// a zero key never matches, so the entries start out empty
+	if (gfxTileCache == NULL)
+		gfxTileCache = (GfxTile *)calloc(GFX_TILE_CACHE_SIZE, sizeof(GfxTile));
+	return gfxTileCache != NULL;
+}
+
+void gfxTileCacheCleanUp()
+{
+	free(gfxTileCache);
+	gfxTileCache = NULL;
+}
+
+// Retires the tiles and sprite bins made from the pages written by the CPU,
+// DMA or the frontends since the last call.
+void gfxVideoCacheUpdate()
+{
+	if (!cpuVideoDirty)
+		return;
+	cpuVideoDirty = false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (cpuVideoDirtyPages[i])
+			gfxTilePaletteGen[i]++;
+	}
+
+	u8 *dirty = &cpuVideoDirtyPages[CPU_DIRTY_VRAM - CPU_DIRTY_PALETTE_RAM];
+	for (int i = 0; i < 0x200; i++)
+	{
+		if (dirty[i])
+			gfxTileVramGen[i]++;
+	}
+
+	dirty = &cpuVideoDirtyPages[CPU_DIRTY_OAM - CPU_DIRTY_PALETTE_RAM];
+	if (dirty[0] | dirty[1] | dirty[2] | dirty[3])
+		gfxOBJBinsValid = false;
+
+	memset(cpuVideoDirtyPages, 0, sizeof(cpuVideoDirtyPages));
+}
+
+void gfxTileDecode(GfxTile *tile, u32 key, u32 address, int bank, u32 paletteGen)
+{
+	u16 *palette = (u16 *)paletteRAM;
+	u8 * data	 = &vram[address];
+	u32 *pixels	 = tile->pixels;
+	if (bank < 16)
+	{
+		palette += bank << 4;
+		for (int i = 0; i < 32; i++)
+		{
+			int lo = data[i] & 0x0F;
+			int hi = data[i] >> 4;
+			pixels[i * 2]	  = lo ? READ16LE(&palette[lo]) : 0x80000000;
+			pixels[i * 2 + 1] = hi ? READ16LE(&palette[hi]) : 0x80000000;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < 64; i++)
+			pixels[i] = data[i] ? READ16LE(&palette[data[i]]) : 0x80000000;
+	}
+	tile->key		 = key;
+	tile->vramGen	 = gfxTileVramGen[address >> 8];
+	tile->paletteGen = paletteGen;
+}
+
+// Sorts the sprites into the lines their Y range covers. The sizes are
+// derived as in gfxDrawSprites(); a double size affine sprite or OBJ window
+// covers twice its height, wrapping around from line 255 to line 0.
+void gfxOBJBinsBuild()
+{
+	memset(gfxOBJBinCount, 0, sizeof(gfxOBJBinCount));
+
+	u16 *sprites = (u16 *)oam;
+	for (int x = 0; x < 128; x++, sprites += 4)
+	{
+		u16 a0 = READ16LE(&sprites[0]);
+		u16 a1 = READ16LE(&sprites[1]);
+
+		if ((a0 >> 14) == 3)
+		{
+			a0 &= 0x3FFF;
+			a1 &= 0x3FFF;
+		}
+
+		int sizeY = 8 << (a1 >> 14);
+		if ((a0 >> 14) & 1)
+		{
+			if (sizeY > 8)
+				sizeY >>= 1;
+		}
+		else if ((a0 >> 14) & 2)
+		{
+			if (sizeY < 32)
+				sizeY <<= 1;
+		}
+		if ((a0 & 0x0300) == 0x0300)
+			sizeY <<= 1;
+
+		int sy = (a0 & 255);
+		if ((sy + sizeY) > 256)
+			sy -= 256;
+
+		for (int y = sy < 0 ? 0 : sy; y < sy + sizeY && y < 160; y++)
+			gfxOBJBin[y][gfxOBJBinCount[y]++] = x;
+	}
+
+	gfxOBJBinsValid = true;
+}
+#endif
+
+static inline int gfxWindowMask(int x, bool inWindow0, bool inWindow1)
+{
+	if (inWindow0 && gfxInWin0[x])
+		return WININ & 0xFF;
+	if (inWindow1 && gfxInWin1[x])
+		return WININ >> 8;
+	if (!(lineOBJWin[x] & 0x80000000))
+		return WINOUT >> 8;
+	return WINOUT & 0xFF;
+}
+
+static inline u32 gfxMixPixel(u32 *const *bg, int x, int layers, int mask, u32 backdrop)
+{
+	u32 color = backdrop;
+	int top	  = 0x20;
+
+	for (int i = 0; i < 4; i++)
+	{
+		if ((layers & mask & (1 << i)) && (u8)(bg[i][x] >> 24) < (u8)(color >> 24))
+		{
+			color = bg[i][x];
+			top	  = 1 << i;
+		}
+	}
+
+	if ((mask & 16) && (u8)(lineOBJ[x] >> 24) < (u8)(color >> 24))
+	{
+		color = lineOBJ[x];
+		top	  = 0x10;
+	}
+
+	int effect = (BLDMOD >> 6) & 3;
+
+	if (color & 0x00010000)
+	{
+		// semi-transparent OBJ
+		u32 back = backdrop;
+		int top2 = 0x20;
+
+		for (int i = 0; i < 4; i++)
+		{
+			if ((layers & mask & (1 << i)) && (u8)(bg[i][x] >> 24) < (u8)(back >> 24))
+			{
+				back = bg[i][x];
+				top2 = 1 << i;
+			}
+		}
+
+		if (top2 & (BLDMOD >> 8))
+			return gfxAlphaBlend(color, back,
+			                     coeff[COLEV & 0x1F],
+			                     coeff[(COLEV >> 8) & 0x1F]);
+	}
+	else if (!(mask & 32))
+		return color;
+	else if (effect == 1)
+	{
+		if (top & BLDMOD)
+		{
+			u32 back = backdrop;
+			int top2 = 0x20;
+
+			for (int i = 0; i < 5; i++)
+			{
+				u32 c = i < 4 ? bg[i][x] : lineOBJ[x];
+				if (((layers | 16) & mask & (1 << i)) && top != (1 << i) && (u8)(c >> 24) < (u8)(back >> 24))
+				{
+					back = c;
+					top2 = 1 << i;
+				}
+			}
+
+			if (top2 & (BLDMOD >> 8))
+				color = gfxAlphaBlend(color, back,
+				                      coeff[COLEV & 0x1F],
+				                      coeff[(COLEV >> 8) & 0x1F]);
+		}
+		return color;
+	}
+
+	if (BLDMOD & top)
+	{
+		if (effect == 2)
+			color = gfxIncreaseBrightness(color, coeff[COLY & 0x1F]);
+		else if (effect == 3)
+			color = gfxDecreaseBrightness(color, coeff[COLY & 0x1F]);
+	}
+	return color;
+}
+
+#ifdef GFX_MIX_SSE2
+static inline __m128i gfxSelect4(__m128i c, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(c, a), _mm_andnot_si128(c, b));
+}
+
+static inline __m128i gfxNonZero4(__m128i v)
+{
+	return _mm_cmpgt_epi32(v, _mm_setzero_si128());
+}
+
+static inline __m128i gfxInWin4(const bool *win)
+{
+	int w;
+	memcpy(&w, win, 4);
+	__m128i zero = _mm_setzero_si128();
+	return gfxNonZero4(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(w), zero), zero));
+}
+
+// The channels are small enough for 16-bit multiplies within the 32-bit
+// lanes. The result has the extra copy of green at bit 21 that the scalar
+// versions leave above the colour.
+static inline __m128i gfxPack4(__m128i r, __m128i g, __m128i b)
+{
+	return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 5)),
+	                    _mm_or_si128(_mm_slli_epi32(b, 10), _mm_slli_epi32(g, 21)));
+}
+
+static inline __m128i gfxAlphaBlend4(__m128i color, __m128i back, __m128i ca, __m128i cb)
+{
+	const __m128i c31 = _mm_set1_epi32(0x1F);
+	__m128i		  c[3];
+	for (int i = 0; i < 3; i++)
+	{
+		__m128i a = _mm_and_si128(_mm_srli_epi32(color, i * 5), c31);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(back, i * 5), c31);
+		a	 = _mm_add_epi32(_mm_mullo_epi16(a, ca), _mm_mullo_epi16(b, cb));
+		c[i] = _mm_min_epi16(_mm_srli_epi32(a, 4), c31);
+	}
+	return gfxPack4(c[0], c[1], c[2]);
+}
+
+static inline __m128i gfxBrightness4(__m128i color, __m128i cy, bool increase)
+{
+	const __m128i c31 = _mm_set1_epi32(0x1F);
+	__m128i		  c[3];
+	for (int i = 0; i < 3; i++)
+	{
+		__m128i a = _mm_and_si128(_mm_srli_epi32(color, i * 5), c31);
+		if (increase)
+			c[i] = _mm_add_epi32(a, _mm_srli_epi32(_mm_mullo_epi16(_mm_sub_epi32(c31, a), cy), 4));
+		else
+			c[i] = _mm_sub_epi32(a, _mm_srli_epi32(_mm_mullo_epi16(a, cy), 4));
+	}
+	return gfxPack4(c[0], c[1], c[2]);
+}
+#endif
+
+// Mixes 4 pixels at a time with SSE2, selecting every lane both ways and
+// masking, so that the output matches gfxMixPixel() bit for bit.
+template <bool windows>
+static inline void gfxMix(int layers, bool inWindow0, bool inWindow1)
+{
+	u16 *palette  = (u16 *)paletteRAM;
+	u32	 backdrop = (READ16LE(&palette[0]) | 0x30000000);
+	u32 *bg[4]	  = { line0, line1, line2, line3 };
+
+#ifdef GFX_MIX_SSE2
+	const __m128i zero	   = _mm_setzero_si128();
+	const __m128i bit31	   = _mm_set1_epi32(0x80000000);
+	const __m128i semiBit  = _mm_set1_epi32(0x00010000);
+	const __m128i fxBit	   = _mm_set1_epi32(0x20);
+	const __m128i target1  = _mm_set1_epi32(BLDMOD & 0x3F);
+	const __m128i target2  = _mm_set1_epi32((BLDMOD >> 8) & 0x3F);
+	const __m128i ca	   = _mm_set1_epi32(coeff[COLEV & 0x1F]);
+	const __m128i cb	   = _mm_set1_epi32(coeff[(COLEV >> 8) & 0x1F]);
+	const __m128i cy	   = _mm_set1_epi32(coeff[COLY & 0x1F]);
+	const __m128i vBack	   = _mm_set1_epi32(backdrop);
+	const __m128i vBackPri = _mm_set1_epi32(backdrop >> 24);
+	const __m128i vBackTop = _mm_set1_epi32(0x20);
+	int			  effect   = (BLDMOD >> 6) & 3;
+
+	for (int x = 0; x < 240; x += 4)
+	{
+		__m128i mask = _mm_set1_epi32(0x3F);
+		if (windows)
+		{
+			__m128i objWin = _mm_loadu_si128((const __m128i *)&lineOBJWin[x]);
+			mask = gfxSelect4(_mm_cmpeq_epi32(_mm_and_si128(objWin, bit31), zero),
+			                  _mm_set1_epi32(WINOUT >> 8), _mm_set1_epi32(WINOUT & 0xFF));
+			if (inWindow1)
+				mask = gfxSelect4(gfxInWin4(&gfxInWin1[x]), _mm_set1_epi32(WININ >> 8), mask);
+			if (inWindow0)
+				mask = gfxSelect4(gfxInWin4(&gfxInWin0[x]), _mm_set1_epi32(WININ & 0xFF), mask);
+		}
+
+		__m128i pix[5], pri[5], on[5];
+		for (int i = 0; i < 5; i++)
+		{
+			if (i < 4 && !(layers & (1 << i)))
+				continue;
+			__m128i bit = _mm_set1_epi32(1 << i);
+			pix[i] = _mm_loadu_si128((const __m128i *)(i < 4 ? &bg[i][x] : &lineOBJ[x]));
+			pri[i] = _mm_srli_epi32(pix[i], 24);
+			on[i]  = _mm_cmpeq_epi32(_mm_and_si128(mask, bit), bit);
+		}
+
+		__m128i color = vBack, prio = vBackPri, top = vBackTop;
+		for (int i = 0; i < 5; i++)
+		{
+			if (i < 4 && !(layers & (1 << i)))
+				continue;
+			__m128i take = _mm_and_si128(on[i], _mm_cmplt_epi32(pri[i], prio));
+			color = gfxSelect4(take, pix[i], color);
+			prio  = gfxSelect4(take, pri[i], prio);
+			top	  = gfxSelect4(take, _mm_set1_epi32(1 << i), top);
+		}
+
+		__m128i semi	= _mm_cmpeq_epi32(_mm_and_si128(color, semiBit), semiBit);
+		__m128i fx		= _mm_andnot_si128(semi, gfxNonZero4(_mm_and_si128(mask, fxBit)));
+		__m128i topHit	= gfxNonZero4(_mm_and_si128(top, target1));
+		__m128i blend	= zero;
+		__m128i blendOn = zero;
+		__m128i back	= vBack;
+
+		if (_mm_movemask_epi8(semi))
+		{
+			__m128i backPri = vBackPri, top2 = vBackTop;
+			for (int i = 0; i < 4; i++)
+			{
+				if (!(layers & (1 << i)))
+					continue;
+				__m128i take = _mm_and_si128(on[i], _mm_cmplt_epi32(pri[i], backPri));
+				back	= gfxSelect4(take, pix[i], back);
+				backPri = gfxSelect4(take, pri[i], backPri);
+				top2	= gfxSelect4(take, _mm_set1_epi32(1 << i), top2);
+			}
+			blendOn = _mm_and_si128(semi, gfxNonZero4(_mm_and_si128(top2, target2)));
+		}
+
+		__m128i fxBlend = _mm_and_si128(fx, topHit);
+		if (effect == 1 && _mm_movemask_epi8(fxBlend))
+		{
+			__m128i back2 = vBack, backPri = vBackPri, top2 = vBackTop;
+			for (int i = 0; i < 5; i++)
+			{
+				if (i < 4 && !(layers & (1 << i)))
+					continue;
+				__m128i bit	 = _mm_set1_epi32(1 << i);
+				__m128i take = _mm_andnot_si128(_mm_cmpeq_epi32(top, bit),
+				                                _mm_and_si128(on[i], _mm_cmplt_epi32(pri[i], backPri)));
+				back2	= gfxSelect4(take, pix[i], back2);
+				backPri = gfxSelect4(take, pri[i], backPri);
+				top2	= gfxSelect4(take, bit, top2);
+			}
+			back	= gfxSelect4(semi, back, back2);
+			blendOn = _mm_or_si128(blendOn, _mm_and_si128(fxBlend, gfxNonZero4(_mm_and_si128(top2, target2))));
+		}
+
+		// gfxAlphaBlend() leaves colours with bit 31 set alone
+		blend = _mm_and_si128(blendOn, _mm_cmpeq_epi32(_mm_and_si128(color, bit31), zero));
+		if (_mm_movemask_epi8(blend))
+			color = gfxSelect4(blend, gfxAlphaBlend4(color, back, ca, cb), color);
+
+		if (effect >= 2)
+		{
+			__m128i bright = _mm_and_si128(topHit, _mm_or_si128(_mm_andnot_si128(blendOn, semi), fx));
+			if (_mm_movemask_epi8(bright))
+				color = gfxSelect4(bright, gfxBrightness4(color, cy, effect == 2), color);
+		}
+
+		_mm_storeu_si128((__m128i *)&lineMix[x], color);
+	}
+#else
+	for (int x = 0; x < 240; x++)
+		lineMix[x] = gfxMixPixel(bg, x, layers, windows ? gfxWindowMask(x, inWindow0, inWindow1) : 0x3F, backdrop);
+#endif
+}
+
+void gfxMixLine(int layers)
+{
+	gfxMix<false>(layers, false, false);
+}
+
+void gfxMixLineWindows(int layers, bool inWindow0, bool inWindow1)
+{
+	gfxMix<true>(layers, inWindow0, inWindow1);
+}
@@ -73,28 +73,78 @@ void mode5RenderLine();
 void mode5RenderLineNoWindow();
 void mode5RenderLineAll();
 
-extern int32 layerEnable;
+extern INSTANCE_LOCAL int32 layerEnable;
 
 extern int	coeff[32];
-extern u32	line0[240];
-extern u32	line1[240];
-extern u32	line2[240];
-extern u32	line3[240];
-extern u32	lineOBJ[240];
-extern u32	lineOBJWin[240];
-extern u32	lineMix[240];
-extern bool gfxInWin0[240];
-extern bool gfxInWin1[240];
-extern int	lineOBJpixleft[128];
-
-extern int gfxBG2Changed;
-extern int gfxBG3Changed;
-
-extern int gfxBG2X;
-extern int gfxBG2Y;
-extern int gfxBG3X;
-extern int gfxBG3Y;
-extern int gfxLastVCOUNT;
+extern INSTANCE_LOCAL u32	line0[240];
+extern INSTANCE_LOCAL u32	line1[240];
+extern INSTANCE_LOCAL u32	line2[240];
+extern INSTANCE_LOCAL u32	line3[240];
+extern INSTANCE_LOCAL u32	lineOBJ[240];
+extern INSTANCE_LOCAL u32	lineOBJWin[240];
+extern INSTANCE_LOCAL u32	lineMix[240];
+extern INSTANCE_LOCAL bool gfxInWin0[240];
+extern INSTANCE_LOCAL bool gfxInWin1[240];
+extern INSTANCE_LOCAL int	lineOBJpixleft[128];
+
+extern INSTANCE_LOCAL int gfxBG2Changed;
+extern INSTANCE_LOCAL int gfxBG3Changed;
+
+extern INSTANCE_LOCAL int gfxBG2X;
+extern INSTANCE_LOCAL int gfxBG2Y;
+extern INSTANCE_LOCAL int gfxBG3X;
+extern INSTANCE_LOCAL int gfxBG3Y;
+extern INSTANCE_LOCAL int gfxLastVCOUNT;
+
+// Merge the BG lines selected by layers (1 for BG0 up to 8 for BG3) and the
+// OBJ line into lineMix, with the colour special effects of BLDMOD. The
+// Windows version first masks the layers through WIN0, WIN1 and the OBJ
+// window, as the modeNRenderLineAll() renderers need.
+extern void gfxMixLine(int layers);
+extern void gfxMixLineWindows(int layers, bool inWindow0, bool inWindow1);
+
+#ifndef USE_GBA_CORE_V7
+// Decoded tiles of the text backgrounds. An entry holds one 8x8 tile already
+// looked up in one palette bank (16 for 256 colours), 0x80000000 where it is
+// transparent, and stays valid until the VRAM page of the tile or the BG
+// palette page of the bank has been written since it was decoded.
+#define GFX_TILE_CACHE_SIZE 4096
+
+struct GfxTile
+{
+	u32 key;
+	u32 vramGen;
+	u32 paletteGen;
+	u32 pixels[64];
+};
+
+extern INSTANCE_LOCAL GfxTile *gfxTileCache;
+extern INSTANCE_LOCAL u32	   gfxTileVramGen[0x200];
+extern INSTANCE_LOCAL u32	   gfxTilePaletteGen[2];
+
+// The sprites whose Y range covers each visible line, in OAM order; rebuilt
+// after OAM writes. Sprites off the line only cost their 2 cycles, so the
+// renderers can skip them.
+extern INSTANCE_LOCAL u8	gfxOBJBin[160][128];
+extern INSTANCE_LOCAL u8	gfxOBJBinCount[160];
+extern INSTANCE_LOCAL bool8 gfxOBJBinsValid;
+
+extern bool gfxTileCacheInit();
+extern void gfxTileCacheCleanUp();
+extern void gfxVideoCacheUpdate();
+extern void gfxTileDecode(GfxTile *tile, u32 key, u32 address, int bank, u32 paletteGen);
+extern void gfxOBJBinsBuild();
+
+static inline const u32 *gfxTile(u32 address, int bank)
+{
+	u32		 key		= 0x80000000 | (bank << 17) | address;
+	GfxTile *tile		= &gfxTileCache[((address >> 5) ^ (bank << 7)) & (GFX_TILE_CACHE_SIZE - 1)];
+	u32		 paletteGen = bank < 16 ? gfxTilePaletteGen[bank >> 3] : gfxTilePaletteGen[0] + gfxTilePaletteGen[1];
+	if (tile->key != key || tile->vramGen != gfxTileVramGen[address >> 8] || tile->paletteGen != paletteGen)
+		gfxTileDecode(tile, key, address, bank, paletteGen);
+	return tile->pixels;
+}
+#endif
 
 static inline void gfxClearArray(u32 *array)
 {
@@ -107,8 +157,6 @@ static inline void gfxClearArray(u32 *array)
 static inline void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs,
                                      u32 *line)
 {
-	u16 *palette	= (u16 *)paletteRAM;
-	u8 * charBase	= &vram[((control >> 2) & 0x03) * 0x4000];
 	u16 *screenBase = (u16 *)&vram[((control >> 8) & 0x1f) * 0x800];
 	u32	 prio		= ((control & 3) << 25) + 0x1000000;
 	int	 sizeX		= 256;
@@ -157,6 +205,69 @@ static inline void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs,
 	}
 
 	int yshift = ((yyy >> 3) << 5);
+#ifndef USE_GBA_CORE_V7
+	gfxVideoCacheUpdate();
+
+	u32	 charOffset	  = ((control >> 2) & 0x03) * 0x4000;
+	int	 tileRow	  = yyy & 7;
+	u16 *screenSource = screenBase + 0x400 * (xxx >> 8) + ((xxx & 255) >> 3) + yshift;
+	int	 x			  = 0;
+	while (x < 240)
+	{
+		u16 data  = READ16LE(screenSource++);
+		int tileX = xxx & 7;
+		int tileY = (data & 0x0800) ? 7 - tileRow : tileRow;
+
+		const u32 *pixels;
+		if (control & 0x80)
+			pixels = gfxTile(charOffset + ((data & 0x3FF) << 6), 16);
+		else
+			pixels = gfxTile(charOffset + ((data & 0x3FF) << 5), data >> 12);
+		pixels += tileY << 3;
+
+		int count = 8 - tileX;
+		if (count > 240 - x)
+			count = 240 - x;
+
+		// transparent pixels keep 0x80000000 without the priority bits
+		if (data & 0x0400)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				u32 color = pixels[7 - tileX - i];
+				line[x + i] = color | (prio & ~(u32)((s32)color >> 31));
+			}
+		}
+		else
+		{
+			for (int i = 0; i < count; i++)
+			{
+				u32 color = pixels[tileX + i];
+				line[x + i] = color | (prio & ~(u32)((s32)color >> 31));
+			}
+		}
+
+		x	+= count;
+		xxx += count;
+		if (xxx == 256)
+		{
+			if (sizeX > 256)
+				screenSource = screenBase + 0x400 + yshift;
+			else
+			{
+				screenSource = screenBase + yshift;
+				xxx = 0;
+			}
+		}
+		else if (xxx >= sizeX)
+		{
+			xxx = 0;
+			screenSource = screenBase + yshift;
+		}
+	}
+#else
+	u16 *palette  = (u16 *)paletteRAM;
+	u8 * charBase = &vram[((control >> 2) & 0x03) * 0x4000];
 	if ((control) & 0x80)
 	{
 		u16 *screenSource = screenBase + 0x400 * (xxx >> 8) + ((xxx & 255) >> 3) + yshift;
@@ -250,6 +361,7 @@ static inline void gfxDrawTextScreen(u16 control, u16 hofs, u16 vofs,
 			}
 		}
 	}
+#endif
 	if (mosaicOn)
 	{
 		if (mosaicX > 1)
@@ -775,12 +887,31 @@ static inline void gfxDrawSprites(u32 *lineOBJ)
 	if (layerEnable & 0x1000)
 	{
 		int  m = 0;
-		u16 *sprites	   = (u16 *)oam;
 		u16 *spritePalette = &((u16 *)paletteRAM)[256];
 		int	 mosaicY	   = ((MOSAIC & 0xF000) >> 12) + 1;
 		int	 mosaicX	   = ((MOSAIC & 0xF00) >> 8) + 1;
+#ifndef USE_GBA_CORE_V7
+		gfxVideoCacheUpdate();
+		if (!gfxOBJBinsValid)
+			gfxOBJBinsBuild();
+
+		int next = 0;
+		for (int i = 0; i < gfxOBJBinCount[VCOUNT]; i++)
+		{
+			int x = gfxOBJBin[VCOUNT][i];
+			for (; next < x; next++)
+			{
+				lineOBJpixleft[next] = lineOBJpix;
+				lineOBJpix			-= 2;
+			}
+			next = x + 1;
+
+			u16 *sprites = &((u16 *)oam)[x << 2];
+#else
+		u16 *sprites = (u16 *)oam;
 		for (int x = 0; x < 128; x++)
 		{
+#endif
 			u16 a0 = READ16LE(sprites++);
 			u16 a1 = READ16LE(sprites++);
 			u16 a2 = READ16LE(sprites++);
@@ -1288,6 +1419,13 @@ static inline void gfxDrawSprites(u32 *lineOBJ)
 				}
 			}
 		}
+#ifndef USE_GBA_CORE_V7
+		for (; next < 128; next++)
+		{
+			lineOBJpixleft[next] = lineOBJpix;
+			lineOBJpix			-= 2;
+		}
+#endif
 	}
 }
 
@@ -1296,10 +1434,21 @@ static inline void gfxDrawOBJWin(u32 *lineOBJWin)
 	gfxClearArray(lineOBJWin);
 	if ((layerEnable & 0x9000) == 0x9000)
 	{
-		u16 *sprites = (u16 *)oam;
 		// u16 *spritePalette = &((u16 *)paletteRAM)[256];
+#ifndef USE_GBA_CORE_V7
+		gfxVideoCacheUpdate();
+		if (!gfxOBJBinsValid)
+			gfxOBJBinsBuild();
+
+		for (int i = 0; i < gfxOBJBinCount[VCOUNT]; i++)
+		{
+			int	 x		 = gfxOBJBin[VCOUNT][i];
+			u16 *sprites = &((u16 *)oam)[x << 2];
+#else
+		u16 *sprites = (u16 *)oam;
 		for (int x = 0; x < 128; x++)
 		{
+#endif
 			int lineOBJpix = lineOBJpixleft[x];
 			u16 a0		   = READ16LE(sprites++);
 			u16 a1		   = READ16LE(sprites++);
@@ -20,11 +20,11 @@
 #define VERBOSE_SOUNDOUTPUT       1024
 
 #ifdef BKPT_SUPPORT
-extern int	oldreg[18];
-extern char oldbuffer[10];
+extern INSTANCE_LOCAL int	oldreg[18];
+extern INSTANCE_LOCAL char oldbuffer[10];
 extern void (*dbgSignal)(int, int);
 extern void (*dbgOutput)(const char *, u32);
-extern bool debugger_last;
+extern INSTANCE_LOCAL bool debugger_last;
 #endif
 
 // moved from GBA.h
@@ -62,113 +62,113 @@ typedef union
 } reg_pair;
 
 // internal...
-extern reg_pair reg[45];
-extern u8		biosProtected[4];
-extern bool8	ioReadable[0x400];
-extern bool8	N_FLAG;
-extern bool8	C_FLAG;
-extern bool8	Z_FLAG;
-extern bool8	V_FLAG;
-extern bool8	armState;
-extern bool8	armIrqEnable;
-extern u32		armNextPC;
-extern int32	armMode;
-extern int32	saveType;
-extern bool8	speedHack;
+extern INSTANCE_LOCAL reg_pair reg[45];
+extern INSTANCE_LOCAL u8		biosProtected[4];
+extern INSTANCE_LOCAL bool8	ioReadable[0x400];
+extern INSTANCE_LOCAL bool8	N_FLAG;
+extern INSTANCE_LOCAL bool8	C_FLAG;
+extern INSTANCE_LOCAL bool8	Z_FLAG;
+extern INSTANCE_LOCAL bool8	V_FLAG;
+extern INSTANCE_LOCAL bool8	armState;
+extern INSTANCE_LOCAL bool8	armIrqEnable;
+extern INSTANCE_LOCAL u32		armNextPC;
+extern INSTANCE_LOCAL int32	armMode;
+extern INSTANCE_LOCAL int32	saveType;
+extern INSTANCE_LOCAL bool8	speedHack;
 
 #ifdef USE_GBA_CORE_V7
-extern bool		sramInitFix;
+extern INSTANCE_LOCAL bool		sramInitFix;
 #endif
 
 #ifndef FINAL_VERSION
-extern u32		armStopAddr;
+extern INSTANCE_LOCAL u32		armStopAddr;
 #endif
 
-extern u8 *rom;
-extern u8 *internalRAM;
-extern u8 *workRAM;
-extern u8 *paletteRAM;
-extern u8 *vram;
-extern u8 *oam;
-extern u8 *ioMem;
+extern INSTANCE_LOCAL u8 *rom;
+extern INSTANCE_LOCAL u8 *internalRAM;
+extern INSTANCE_LOCAL u8 *workRAM;
+extern INSTANCE_LOCAL u8 *paletteRAM;
+extern INSTANCE_LOCAL u8 *vram;
+extern INSTANCE_LOCAL u8 *oam;
+extern INSTANCE_LOCAL u8 *ioMem;
 
-extern u16 DISPCNT;
-extern u16 DISPSTAT;
-extern u16 VCOUNT;
-extern u16 BG0CNT;
-extern u16 BG1CNT;
-extern u16 BG2CNT;
-extern u16 BG3CNT;
-extern u16 BG0HOFS;
-extern u16 BG0VOFS;
-extern u16 BG1HOFS;
-extern u16 BG1VOFS;
-extern u16 BG2HOFS;
-extern u16 BG2VOFS;
-extern u16 BG3HOFS;
-extern u16 BG3VOFS;
-extern u16 BG2PA;
-extern u16 BG2PB;
-extern u16 BG2PC;
-extern u16 BG2PD;
-extern u16 BG2X_L;
-extern u16 BG2X_H;
-extern u16 BG2Y_L;
-extern u16 BG2Y_H;
-extern u16 BG3PA;
-extern u16 BG3PB;
-extern u16 BG3PC;
-extern u16 BG3PD;
-extern u16 BG3X_L;
-extern u16 BG3X_H;
-extern u16 BG3Y_L;
-extern u16 BG3Y_H;
-extern u16 WIN0H;
-extern u16 WIN1H;
-extern u16 WIN0V;
-extern u16 WIN1V;
-extern u16 WININ;
-extern u16 WINOUT;
-extern u16 MOSAIC;
-extern u16 BLDMOD;
-extern u16 COLEV;
-extern u16 COLY;
-extern u16 DM0SAD_L;
-extern u16 DM0SAD_H;
-extern u16 DM0DAD_L;
-extern u16 DM0DAD_H;
-extern u16 DM0CNT_L;
-extern u16 DM0CNT_H;
-extern u16 DM1SAD_L;
-extern u16 DM1SAD_H;
-extern u16 DM1DAD_L;
-extern u16 DM1DAD_H;
-extern u16 DM1CNT_L;
-extern u16 DM1CNT_H;
-extern u16 DM2SAD_L;
-extern u16 DM2SAD_H;
-extern u16 DM2DAD_L;
-extern u16 DM2DAD_H;
-extern u16 DM2CNT_L;
-extern u16 DM2CNT_H;
-extern u16 DM3SAD_L;
-extern u16 DM3SAD_H;
-extern u16 DM3DAD_L;
-extern u16 DM3DAD_H;
-extern u16 DM3CNT_L;
-extern u16 DM3CNT_H;
-extern u16 TM0D;
-extern u16 TM0CNT;
-extern u16 TM1D;
-extern u16 TM1CNT;
-extern u16 TM2D;
-extern u16 TM2CNT;
-extern u16 TM3D;
-extern u16 TM3CNT;
-extern u16 P1;
-extern u16 IE;
-extern u16 IF;
-extern u16 IME;
+extern INSTANCE_LOCAL u16 DISPCNT;
+extern INSTANCE_LOCAL u16 DISPSTAT;
+extern INSTANCE_LOCAL u16 VCOUNT;
+extern INSTANCE_LOCAL u16 BG0CNT;
+extern INSTANCE_LOCAL u16 BG1CNT;
+extern INSTANCE_LOCAL u16 BG2CNT;
+extern INSTANCE_LOCAL u16 BG3CNT;
+extern INSTANCE_LOCAL u16 BG0HOFS;
+extern INSTANCE_LOCAL u16 BG0VOFS;
+extern INSTANCE_LOCAL u16 BG1HOFS;
+extern INSTANCE_LOCAL u16 BG1VOFS;
+extern INSTANCE_LOCAL u16 BG2HOFS;
+extern INSTANCE_LOCAL u16 BG2VOFS;
+extern INSTANCE_LOCAL u16 BG3HOFS;
+extern INSTANCE_LOCAL u16 BG3VOFS;
+extern INSTANCE_LOCAL u16 BG2PA;
+extern INSTANCE_LOCAL u16 BG2PB;
+extern INSTANCE_LOCAL u16 BG2PC;
+extern INSTANCE_LOCAL u16 BG2PD;
+extern INSTANCE_LOCAL u16 BG2X_L;
+extern INSTANCE_LOCAL u16 BG2X_H;
+extern INSTANCE_LOCAL u16 BG2Y_L;
+extern INSTANCE_LOCAL u16 BG2Y_H;
+extern INSTANCE_LOCAL u16 BG3PA;
+extern INSTANCE_LOCAL u16 BG3PB;
+extern INSTANCE_LOCAL u16 BG3PC;
+extern INSTANCE_LOCAL u16 BG3PD;
+extern INSTANCE_LOCAL u16 BG3X_L;
+extern INSTANCE_LOCAL u16 BG3X_H;
+extern INSTANCE_LOCAL u16 BG3Y_L;
+extern INSTANCE_LOCAL u16 BG3Y_H;
+extern INSTANCE_LOCAL u16 WIN0H;
+extern INSTANCE_LOCAL u16 WIN1H;
+extern INSTANCE_LOCAL u16 WIN0V;
+extern INSTANCE_LOCAL u16 WIN1V;
+extern INSTANCE_LOCAL u16 WININ;
+extern INSTANCE_LOCAL u16 WINOUT;
+extern INSTANCE_LOCAL u16 MOSAIC;
+extern INSTANCE_LOCAL u16 BLDMOD;
+extern INSTANCE_LOCAL u16 COLEV;
+extern INSTANCE_LOCAL u16 COLY;
+extern INSTANCE_LOCAL u16 DM0SAD_L;
+extern INSTANCE_LOCAL u16 DM0SAD_H;
+extern INSTANCE_LOCAL u16 DM0DAD_L;
+extern INSTANCE_LOCAL u16 DM0DAD_H;
+extern INSTANCE_LOCAL u16 DM0CNT_L;
+extern INSTANCE_LOCAL u16 DM0CNT_H;
+extern INSTANCE_LOCAL u16 DM1SAD_L;
+extern INSTANCE_LOCAL u16 DM1SAD_H;
+extern INSTANCE_LOCAL u16 DM1DAD_L;
+extern INSTANCE_LOCAL u16 DM1DAD_H;
+extern INSTANCE_LOCAL u16 DM1CNT_L;
+extern INSTANCE_LOCAL u16 DM1CNT_H;
+extern INSTANCE_LOCAL u16 DM2SAD_L;
+extern INSTANCE_LOCAL u16 DM2SAD_H;
+extern INSTANCE_LOCAL u16 DM2DAD_L;
+extern INSTANCE_LOCAL u16 DM2DAD_H;
+extern INSTANCE_LOCAL u16 DM2CNT_L;
+extern INSTANCE_LOCAL u16 DM2CNT_H;
+extern INSTANCE_LOCAL u16 DM3SAD_L;
+extern INSTANCE_LOCAL u16 DM3SAD_H;
+extern INSTANCE_LOCAL u16 DM3DAD_L;
+extern INSTANCE_LOCAL u16 DM3DAD_H;
+extern INSTANCE_LOCAL u16 DM3CNT_L;
+extern INSTANCE_LOCAL u16 DM3CNT_H;
+extern INSTANCE_LOCAL u16 TM0D;
+extern INSTANCE_LOCAL u16 TM0CNT;
+extern INSTANCE_LOCAL u16 TM1D;
+extern INSTANCE_LOCAL u16 TM1CNT;
+extern INSTANCE_LOCAL u16 TM2D;
+extern INSTANCE_LOCAL u16 TM2CNT;
+extern INSTANCE_LOCAL u16 TM3D;
+extern INSTANCE_LOCAL u16 TM3CNT;
+extern INSTANCE_LOCAL u16 P1;
+extern INSTANCE_LOCAL u16 IE;
+extern INSTANCE_LOCAL u16 IF;
+extern INSTANCE_LOCAL u16 IME;
 
 extern const u32 frameRateDividend;
 extern const u32 frameRateDivisor;
@@ -3,6 +3,7 @@
 #include "../common/System.h" // SDL build needs this
 #include "../common/SystemGlobals.h"
 #include "../common/Util.h"
+#include "../apu/Blip_Buffer.h"
 #include "GBA.h"
 #include "GBAGlobals.h"
 #include "GBASound.h"
@@ -11,7 +12,18 @@
 #define SOUND_MAGIC_2 0x30000000
 #define NOISE_MAGIC (2097152.0 / 44100.0)
 
-extern bool8 stopState;
+// Blip time units per sound tick; every tick yields exactly one output sample.
+#define SOUND_BLIP_TICK 256
+// Most ticks kept in the Blip_Buffers before their samples are read; the
+// samples are otherwise read once per frame (735 ticks at 44.1 kHz).
+#define SOUND_BLIP_READ_BATCH 1024
+// DirectSound values popped between two catch-ups (see soundTimerOverflow).
+#define SOUND_DS_QUEUE_SIZE 256
+// Beyond these steps per tick the channels fall back to one level per tick.
+#define SOUND_BLIP_MAX_WAVE_STEP  0x08000000
+#define SOUND_BLIP_MAX_NOISE_STEP 0x00800000
+
+extern INSTANCE_LOCAL bool8 stopState;
 
 u8 soundWavePattern[4][32] = {
 	{ 0x01, 0x01, 0x01, 0x01,
@@ -78,92 +90,129 @@ int32 soundShiftClock[16] = {
 	1    // 15
 };
 
-int32 soundLevel1 = 0;
-int32 soundLevel2 = 0;
-int32 soundBalance = 0;
-int32 soundMasterOn = 0;
-int32 soundDebug = 0;
-
-int32 sound1On = 0;
-int32 sound1ATL = 0;
-int32 sound1Skip = 0;
-int32 sound1Index = 0;
-int32 sound1Continue = 0;
-int32 sound1EnvelopeVolume	  = 0;
-int32 sound1EnvelopeATL		  = 0;
-int32 sound1EnvelopeUpDown	  = 0;
-int32 sound1EnvelopeATLReload = 0;
-int32 sound1SweepATL		  = 0;
-int32 sound1SweepATLReload	  = 0;
-int32 sound1SweepSteps		  = 0;
-int32 sound1SweepUpDown		  = 0;
-int32 sound1SweepStep		  = 0;
-u8 *  sound1Wave			  = soundWavePattern[2];
-
-int32 sound2On = 0;
-int32 sound2ATL = 0;
-int32 sound2Skip = 0;
-int32 sound2Index = 0;
-int32 sound2Continue = 0;
-int32 sound2EnvelopeVolume	  = 0;
-int32 sound2EnvelopeATL		  = 0;
-int32 sound2EnvelopeUpDown	  = 0;
-int32 sound2EnvelopeATLReload = 0;
-u8 *  sound2Wave			  = soundWavePattern[2];
-
-int32 sound3On = 0;
-int32 sound3ATL			= 0;
-int32 sound3Skip		= 0;
-int32 sound3Index		= 0;
-int32 sound3Continue	= 0;
-int32 sound3OutputLevel = 0;
-int32 sound3Last		= 0;
-u8	  sound3WaveRam[0x20];
-int32 sound3Bank		 = 0;
-int32 sound3DataSize	 = 0;
-int32 sound3ForcedOutput = 0;
-
-int32 sound4On = 0;
-int32 sound4Clock = 0;
-int32 sound4ATL = 0;
-int32 sound4Skip = 0;
-int32 sound4Index = 0;
-int32 sound4ShiftRight		  = 0x7f;
-int32 sound4ShiftSkip		  = 0;
-int32 sound4ShiftIndex		  = 0;
-int32 sound4NSteps			  = 0;
-int32 sound4CountDown		  = 0;
-int32 sound4Continue		  = 0;
-int32 sound4EnvelopeVolume	  = 0;
-int32 sound4EnvelopeATL		  = 0;
-int32 sound4EnvelopeUpDown	  = 0;
-int32 sound4EnvelopeATLReload = 0;
-
-int32 soundDSFifoAIndex		 = 0;
-int32 soundDSFifoACount		 = 0;
-int32 soundDSFifoAWriteIndex = 0;
-bool8 soundDSAEnabled		 = false;
-int32 soundDSATimer = 0;
-u8	  soundDSFifoA[32];
-u8	  soundDSAValue = 0;
-
-int32 soundDSFifoBIndex		 = 0;
-int32 soundDSFifoBCount		 = 0;
-int32 soundDSFifoBWriteIndex = 0;
-bool8 soundDSBEnabled		 = false; // but bool8 is not big enough for int32
-int32 soundDSBTimer = 0;
-u8	  soundDSFifoB[32];
-u8	  soundDSBValue = 0;
-
-int32 soundControl = 0;
+INSTANCE_LOCAL int32 soundLevel1 = 0;
+INSTANCE_LOCAL int32 soundLevel2 = 0;
+INSTANCE_LOCAL int32 soundBalance = 0;
+INSTANCE_LOCAL int32 soundMasterOn = 0;
+INSTANCE_LOCAL int32 soundDebug = 0;
+
+INSTANCE_LOCAL int32 sound1On = 0;
+INSTANCE_LOCAL int32 sound1ATL = 0;
+INSTANCE_LOCAL int32 sound1Skip = 0;
+INSTANCE_LOCAL int32 sound1Index = 0;
+INSTANCE_LOCAL int32 sound1Continue = 0;
+INSTANCE_LOCAL int32 sound1EnvelopeVolume	  = 0;
+INSTANCE_LOCAL int32 sound1EnvelopeATL		  = 0;
+INSTANCE_LOCAL int32 sound1EnvelopeUpDown	  = 0;
+INSTANCE_LOCAL int32 sound1EnvelopeATLReload = 0;
+INSTANCE_LOCAL int32 sound1SweepATL		  = 0;
+INSTANCE_LOCAL int32 sound1SweepATLReload	  = 0;
+INSTANCE_LOCAL int32 sound1SweepSteps		  = 0;
+INSTANCE_LOCAL int32 sound1SweepUpDown		  = 0;
+INSTANCE_LOCAL int32 sound1SweepStep		  = 0;
+INSTANCE_LOCAL u8 *  sound1Wave			  = soundWavePattern[2];
+
+INSTANCE_LOCAL int32 sound2On = 0;
+INSTANCE_LOCAL int32 sound2ATL = 0;
+INSTANCE_LOCAL int32 sound2Skip = 0;
+INSTANCE_LOCAL int32 sound2Index = 0;
+INSTANCE_LOCAL int32 sound2Continue = 0;
+INSTANCE_LOCAL int32 sound2EnvelopeVolume	  = 0;
+INSTANCE_LOCAL int32 sound2EnvelopeATL		  = 0;
+INSTANCE_LOCAL int32 sound2EnvelopeUpDown	  = 0;
+INSTANCE_LOCAL int32 sound2EnvelopeATLReload = 0;
+INSTANCE_LOCAL u8 *  sound2Wave			  = soundWavePattern[2];
+
+INSTANCE_LOCAL int32 sound3On = 0;
+INSTANCE_LOCAL int32 sound3ATL			= 0;
+INSTANCE_LOCAL int32 sound3Skip		= 0;
+INSTANCE_LOCAL int32 sound3Index		= 0;
+INSTANCE_LOCAL int32 sound3Continue	= 0;
+INSTANCE_LOCAL int32 sound3OutputLevel = 0;
+INSTANCE_LOCAL int32 sound3Last		= 0;
+INSTANCE_LOCAL u8	  sound3WaveRam[0x20];
+INSTANCE_LOCAL int32 sound3Bank		 = 0;
+INSTANCE_LOCAL int32 sound3DataSize	 = 0;
+INSTANCE_LOCAL int32 sound3ForcedOutput = 0;
+
+INSTANCE_LOCAL int32 sound4On = 0;
+INSTANCE_LOCAL int32 sound4Clock = 0;
+INSTANCE_LOCAL int32 sound4ATL = 0;
+INSTANCE_LOCAL int32 sound4Skip = 0;
+INSTANCE_LOCAL int32 sound4Index = 0;
+INSTANCE_LOCAL int32 sound4ShiftRight		  = 0x7f;
+INSTANCE_LOCAL int32 sound4ShiftSkip		  = 0;
+INSTANCE_LOCAL int32 sound4ShiftIndex		  = 0;
+INSTANCE_LOCAL int32 sound4NSteps			  = 0;
+INSTANCE_LOCAL int32 sound4CountDown		  = 0;
+INSTANCE_LOCAL int32 sound4Continue		  = 0;
+INSTANCE_LOCAL int32 sound4EnvelopeVolume	  = 0;
+INSTANCE_LOCAL int32 sound4EnvelopeATL		  = 0;
+INSTANCE_LOCAL int32 sound4EnvelopeUpDown	  = 0;
+INSTANCE_LOCAL int32 sound4EnvelopeATLReload = 0;
+
+INSTANCE_LOCAL int32 soundDSFifoAIndex		 = 0;
+INSTANCE_LOCAL int32 soundDSFifoACount		 = 0;
+INSTANCE_LOCAL int32 soundDSFifoAWriteIndex = 0;
+INSTANCE_LOCAL bool8 soundDSAEnabled		 = false;
+INSTANCE_LOCAL int32 soundDSATimer = 0;
+INSTANCE_LOCAL u8	  soundDSFifoA[32];
+INSTANCE_LOCAL u8	  soundDSAValue = 0;
+
+INSTANCE_LOCAL int32 soundDSFifoBIndex		 = 0;
+INSTANCE_LOCAL int32 soundDSFifoBCount		 = 0;
+INSTANCE_LOCAL int32 soundDSFifoBWriteIndex = 0;
+INSTANCE_LOCAL bool8 soundDSBEnabled		 = false; // but bool8 is not big enough for int32
+INSTANCE_LOCAL int32 soundDSBTimer = 0;
+INSTANCE_LOCAL u8	  soundDSFifoB[32];
+INSTANCE_LOCAL u8	  soundDSBValue = 0;
+
+INSTANCE_LOCAL int32 soundControl = 0;
+
+// The channels add their level changes as band-limited deltas to these
+// buffers, whose samples soundBlipReadSamples reads back in batches. A
+// channel panned to both sides only goes to the center buffer.
+enum { SOUND_CENTER, SOUND_LEFT, SOUND_RIGHT };
+
+static INSTANCE_LOCAL Blip_Buffer soundBlip[3];
+static INSTANCE_LOCAL Blip_Synth<blip_good_quality, 0x10000> soundSynth;
+static INSTANCE_LOCAL int32 soundBlipQuality = 0;
+static INSTANCE_LOCAL int32 soundBlipRead	 = 0;
+static INSTANCE_LOCAL int32 soundGainFlag	 = 0;
+static INSTANCE_LOCAL int32 soundGain[6];
+static INSTANCE_LOCAL int32 soundPan[6];
+static INSTANCE_LOCAL int32 soundValue[6];
+static INSTANCE_LOCAL int32 soundAmp[6];
+static INSTANCE_LOCAL blip_sample_t soundBlipSamples[3][SOUND_BLIP_READ_BATCH];
+
+// The CPU only counts the sound ticks; the channels run them when something
+// they depend on or update is accessed, see soundCatchUp().
+static INSTANCE_LOCAL int32 soundTicksPending = 0;
+
+// adds the ticks the V8 core ran since the last call, the V7 core calls
+// soundTick() at every tick instead
+static inline void soundCountTicks()
+{
+#ifndef USE_GBA_CORE_V7
+	soundTicksPending += CPUSoundTicksDue();
+#endif
+}
+
+// The FIFO values popped at timer overflows while ticks are pending, each
+// stored as the tick it plays from << 9 | channel << 8 | value.
+static INSTANCE_LOCAL u32	soundDSQueue[SOUND_DS_QUEUE_SIZE];
+static INSTANCE_LOCAL int32 soundDSQueued = 0;
+static INSTANCE_LOCAL u8	soundDSPlaying[2]; // values of the tick being run
+
+static void soundMixGains();
 
 // dummy variables
-static int32  soundTicks_int32;
-static int32  soundTickStep_int32;
-static int32  soundDSBValue_int32;
-static int32  soundDSBEnabled_int32;
+static INSTANCE_LOCAL int32  soundTicks_int32;
+static INSTANCE_LOCAL int32  soundTickStep_int32;
+static INSTANCE_LOCAL int32  soundDSBValue_int32;
+static INSTANCE_LOCAL int32  soundDSBEnabled_int32;
 
-variable_desc soundSaveStruct[] = {
+INSTANCE_LOCAL variable_desc soundSaveStruct[] = {
 	{ &soundPaused,				sizeof(int32) },
 	{ &soundPlay,				sizeof(int32) },
 	{ &soundTicks_int32,		sizeof(int32) },
@@ -233,12 +282,12 @@ variable_desc soundSaveStruct[] = {
 	{ &soundDSBTimer,			sizeof(int32) },
 	{ &soundDSFifoB[0],			32			  },
 	{ &soundDSBValue_int32,		sizeof(int32) }, // save as int32 because of a mistake of the past.
-	{ &soundBuffer[0][0],		6 * 735		  },
+	{ &soundBuffer[0][0],		6 * 735		  }, // no longer written, kept for the layout
 	{ &soundFinalWave[0],		2 * 735		  },
 	{ NULL,						0			  }
 };
 
-variable_desc soundSaveStructV2[] = {
+INSTANCE_LOCAL variable_desc soundSaveStructV2[] = {
 	{ &sound3WaveRam[0],   0x20			 },
 	{ &sound3Bank,		   sizeof(int32) },
 	{ &sound3DataSize,	   sizeof(int32) },
@@ -257,6 +306,8 @@ void soundEvent(u32 address, u8 data)
 {
 	int freq = 0;
 
+	soundCatchUp();
+
 	switch (address)
 	{
 	case NR10:
@@ -486,10 +537,12 @@ void soundEvent(u32 address, u8 data)
 		soundLevel1	   = data & 7;
 		soundLevel2	   = (data >> 4) & 7;
 		ioMem[address] = data;
+		soundMixGains();
 		break;
 	case NR51:
 		soundBalance   = (data & soundEnableFlag);
 		ioMem[address] = data;
+		soundMixGains();
 		break;
 	case NR52:
 		data &= 0x80;
@@ -527,6 +580,10 @@ void soundEvent(u32 address, u8 data)
 
 void soundEvent(u32 address, u16 data)
 {
+	// the FIFO writes only matter once the values are popped
+	if (address < FIFOA_L)
+		soundCatchUp();
+
 	switch (address)
 	{
 	case SGCNT0_H:
@@ -537,7 +594,7 @@ void soundEvent(u32 address, u16 data)
 			soundDSFifoAWriteIndex = 0;
 			soundDSFifoAIndex	   = 0;
 			soundDSFifoACount	   = 0;
-			soundDSAValue = 0;
+			soundDSAValue = soundDSPlaying[0] = 0;
 			memset(soundDSFifoA, 0, 32);
 		}
 		soundDSAEnabled = (data & 0x0300) ? true : false;
@@ -547,12 +604,13 @@ void soundEvent(u32 address, u16 data)
 			soundDSFifoBWriteIndex = 0;
 			soundDSFifoBIndex	   = 0;
 			soundDSFifoBCount	   = 0;
-			soundDSBValue = 0;
+			soundDSBValue = soundDSPlaying[1] = 0;
 			memset(soundDSFifoB, 0, 32);
 		}
 		soundDSBEnabled = (data & 0x3000) ? true : false;
 		soundDSBTimer	= (data & 0x4000) ? 1 : 0;
 		*((u16 *)&ioMem[address]) = data;
+		soundMixGains();
 		break;
 	case FIFOA_L:
 	case FIFOA_H:
@@ -588,25 +646,175 @@ void soundEvent(u32 address, u16 data)
 	}
 }
 
-void soundChannel1()
+static void soundBlipReset()
 {
-	int vol = sound1EnvelopeVolume;
+	long rate = 44100 / soundQuality;
 
-	int freq  = 0;
-	int value = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		soundBlip[i].set_sample_rate(rate);
+		soundBlip[i].clock_rate(rate * SOUND_BLIP_TICK);
+	}
+	soundSynth.volume(1.0);
+
+	soundBlipRead = 0;
+	memset(soundValue, 0, sizeof(soundValue));
+	memset(soundAmp, 0, sizeof(soundAmp));
+	soundBlipQuality = soundQuality;
+	soundMixGains();
+}
+
+static void soundDelta(int ch, int time)
+{
+	int amp = soundValue[ch] * soundGain[ch];
+
+	if (amp != soundAmp[ch])
+	{
+		soundSynth.offset_inline(time + soundBlipRead * SOUND_BLIP_TICK, amp - soundAmp[ch],
+		                         &soundBlip[soundPan[ch]]);
+		soundAmp[ch] = amp;
+	}
+}
+
+static inline void soundOutput(int ch, int time, int value)
+{
+	if (value != soundValue[ch])
+	{
+		soundValue[ch] = value;
+		soundDelta(ch, time);
+	}
+}
+
+// same, for a change dist into the tick starting at time, whose phase
+// advances by step (SOUND_BLIP_TICK being 256)
+static inline void soundEdge(int ch, int time, u32 dist, u32 step, int value)
+{
+	if (value != soundValue[ch])
+	{
+		soundValue[ch] = value;
+		soundDelta(ch, time + (int)(dist / ((step >> 8) + 1)));
+	}
+}
+
+// Moves index on to the tick in which the phase, advancing by step per tick,
+// reaches next (next - index then being in (0, step]); false if that tick is
+// not among the ticks left.
+static inline bool soundSkipTo(u32 next, u32 step, u32 &index, int &tick, int ticks)
+{
+	u32 skip = (next - index - 1) / step;
+
+	if (skip >= (u32)(ticks - tick))
+		return false;
+
+	tick  += skip;
+	index += skip * step;
+	return true;
+}
 
-	if (sound1On && (sound1ATL || !sound1Continue))
+// Ends the run with the tick in which a counter losing soundQuality per tick
+// gets to zero or below
+static inline void soundRunUntil(int &run, int32 counter)
+{
+	int ticks = counter <= 0 ? 1 : (counter + soundQuality - 1) / soundQuality;
+
+	if (ticks < run)
+		run = ticks;
+}
+
+// same for an envelope, unless it has no period and can't go any further; it
+// then steps every tick without doing anything
+static inline void soundRunEnvelope(int &run, int32 counter, int32 reload, int32 volume, int32 up)
+{
+	if (counter <= 0 && !reload && (up ? volume == 15 : volume == 0))
+		return;
+
+	soundRunUntil(run, counter);
+}
+
+// The length of a channel not stopped by it keeps counting down, but stays
+// at zero if it gets there exactly.
+static inline int32 soundLengthCount(int32 length, int ticks)
+{
+	if (length > 0 && length % soundQuality == 0 && length / soundQuality <= ticks)
+		return 0;
+
+	return length - ticks * soundQuality;
+}
+
+// outputs the duty edges crossed while the phase advances by step in each of
+// the ticks, the first one starting at time
+static void soundSquare(int ch, int time, u32 index, u32 step, int ticks, const u8 *wave, int vol)
+{
+	if (step > SOUND_BLIP_MAX_WAVE_STEP)
 	{
-		sound1Index += soundQuality * sound1Skip;
-		sound1Index &= 0x1fffffff;
+		for (int tick = 0; tick < ticks; tick++, time += SOUND_BLIP_TICK)
+		{
+			index += step;
+			soundOutput(ch, time, ((s8)wave[(index & 0x1fffffff) >> 24]) * vol);
+		}
+		return;
+	}
+
+	soundOutput(ch, time, ((s8)wave[(index & 0x1fffffff) >> 24]) * vol);
+	if (!step)
+		return;
 
-		value = ((s8)sound1Wave[sound1Index >> 24]) * vol;
+	int tick = 0;
+	for (u32 next = (index | 0xffffff) + 1; soundSkipTo(next, step, index, tick, ticks); next += 0x1000000)
+	{
+		soundEdge(ch, time + tick * SOUND_BLIP_TICK, next - index, step,
+		          ((s8)wave[(next & 0x1fffffff) >> 24]) * vol);
 	}
+}
 
-	soundBuffer[0][soundIndex] = value;
+// Runs the channel for the ticks. They are taken in runs ending with the
+// next length, envelope or sweep step, the waveform only changing there.
+void soundChannel1(int ticks)
+{
+	int freq  = 0;
 
-	if (sound1On)
+	for (int time = 0; ticks > 0;)
 	{
+		int run = ticks;
+
+		if (sound1On)
+		{
+			if (sound1ATL && sound1Continue)
+				soundRunUntil(run, sound1ATL);
+			if (sound1EnvelopeATL)
+				soundRunEnvelope(run, sound1EnvelopeATL, sound1EnvelopeATLReload,
+				                 sound1EnvelopeVolume, sound1EnvelopeUpDown);
+			if (sound1SweepATL)
+				soundRunUntil(run, sound1SweepATL);
+		}
+
+		if (sound1On && (sound1ATL || !sound1Continue))
+		{
+			u32 step = soundQuality * sound1Skip;
+
+			if (!soundSilent)
+				soundSquare(0, time, sound1Index, step, run, sound1Wave, sound1EnvelopeVolume);
+
+			sound1Index += run * step;
+			sound1Index &= 0x1fffffff;
+		}
+		else if (!soundSilent)
+			soundOutput(0, time, 0);
+
+		time  += run * SOUND_BLIP_TICK;
+		ticks -= run;
+
+		if (!sound1On)
+			continue;
+
+		// nothing steps before the last tick of the run
+		if (sound1ATL)
+			sound1ATL = soundLengthCount(sound1ATL, run - 1);
+		if (sound1EnvelopeATL)
+			sound1EnvelopeATL -= (run - 1) * soundQuality;
+		if (sound1SweepATL)
+			sound1SweepATL -= (run - 1) * soundQuality;
+
 		if (sound1ATL)
 		{
 			sound1ATL -= soundQuality;
@@ -685,25 +893,45 @@ void soundChannel1()
 	}
 }
 
-void soundChannel2()
+void soundChannel2(int ticks)
 {
-	//  int freq = 0;
-	int vol = sound2EnvelopeVolume;
+	for (int time = 0; ticks > 0;)
+	{
+		int run = ticks;
 
-	int value = 0;
+		if (sound2On)
+		{
+			if (sound2ATL && sound2Continue)
+				soundRunUntil(run, sound2ATL);
+			if (sound2EnvelopeATL)
+				soundRunEnvelope(run, sound2EnvelopeATL, sound2EnvelopeATLReload,
+				                 sound2EnvelopeVolume, sound2EnvelopeUpDown);
+		}
 
-	if (sound2On && (sound2ATL || !sound2Continue))
-	{
-		sound2Index += soundQuality * sound2Skip;
-		sound2Index &= 0x1fffffff;
+		if (sound2On && (sound2ATL || !sound2Continue))
+		{
+			u32 step = soundQuality * sound2Skip;
 
-		value = ((s8)sound2Wave[sound2Index >> 24]) * vol;
-	}
+			if (!soundSilent)
+				soundSquare(1, time, sound2Index, step, run, sound2Wave, sound2EnvelopeVolume);
 
-	soundBuffer[1][soundIndex] = value;
+			sound2Index += run * step;
+			sound2Index &= 0x1fffffff;
+		}
+		else if (!soundSilent)
+			soundOutput(1, time, 0);
+
+		time  += run * SOUND_BLIP_TICK;
+		ticks -= run;
+
+		if (!sound2On)
+			continue;
+
+		if (sound2ATL)
+			sound2ATL = soundLengthCount(sound2ATL, run - 1);
+		if (sound2EnvelopeATL)
+			sound2EnvelopeATL -= (run - 1) * soundQuality;
 
-	if (sound2On)
-	{
 		if (sound2ATL)
 		{
 			sound2ATL -= soundQuality;
@@ -737,130 +965,213 @@ void soundChannel2()
 	}
 }
 
-void soundChannel3()
+static int soundChannel3Value(u32 index)
 {
-	int value = sound3Last;
+	int value;
 
-	if (sound3On && (sound3ATL || !sound3Continue))
+	if (sound3DataSize)
 	{
-		sound3Index += soundQuality * sound3Skip;
-		if (sound3DataSize)
-		{
-			sound3Index &= 0x3fffffff;
-			value		 = sound3WaveRam[sound3Index >> 25];
-		}
-		else
-		{
-			sound3Index &= 0x1fffffff;
-			value		 = sound3WaveRam[sound3Bank * 0x10 + (sound3Index >> 25)];
-		}
+		index &= 0x3fffffff;
+		value  = sound3WaveRam[index >> 25];
+	}
+	else
+	{
+		index &= 0x1fffffff;
+		value  = sound3WaveRam[sound3Bank * 0x10 + (index >> 25)];
+	}
 
-		if ((sound3Index & 0x01000000))
-		{
-			value &= 0x0f;
-		}
-		else
-		{
-			value >>= 4;
-		}
+	if ((index & 0x01000000))
+	{
+		value &= 0x0f;
+	}
+	else
+	{
+		value >>= 4;
+	}
 
-		value -= 8;
-		value *= 2;
+	value -= 8;
+	value *= 2;
 
-		if (sound3ForcedOutput)
+	if (sound3ForcedOutput)
+	{
+		value = ((value >> 1) + value) >> 1;
+	}
+	else
+	{
+		switch (sound3OutputLevel)
 		{
-			value = ((value >> 1) + value) >> 1;
+		case 0:
+			value = 0;
+			break;
+		case 1:
+			break;
+		case 2:
+			value = (value >> 1);
+			break;
+		case 3:
+			value = (value >> 2);
+			break;
 		}
-		else
+	}
+	//value += 1;
+	return value;
+}
+
+// outputs the samples crossed while the phase advances by step in each of the
+// ticks, the first one starting at time; returns the last one
+static int soundWave(int time, u32 index, u32 step, int ticks)
+{
+	int value = sound3Last;
+
+	if (step > SOUND_BLIP_MAX_WAVE_STEP)
+	{
+		for (int tick = 0; tick < ticks; tick++, time += SOUND_BLIP_TICK)
 		{
-			switch (sound3OutputLevel)
-			{
-			case 0:
-				value = 0;
-				break;
-			case 1:
-				break;
-			case 2:
-				value = (value >> 1);
-				break;
-			case 3:
-				value = (value >> 2);
-				break;
-			}
+			index += step;
+			value  = soundChannel3Value(index);
+			soundOutput(2, time, value);
 		}
-		//value += 1;
-		sound3Last = value;
+		return value;
 	}
 
-	soundBuffer[2][soundIndex] = value;
+	value = soundChannel3Value(index);
+	soundOutput(2, time, value);
+	if (!step)
+		return value;
+
+	int tick = 0;
+	for (u32 next = (index | 0xffffff) + 1; soundSkipTo(next, step, index, tick, ticks); next += 0x1000000)
+	{
+		value = soundChannel3Value(next);
+		soundEdge(2, time + tick * SOUND_BLIP_TICK, next - index, step, value);
+	}
+	return value;
+}
 
-	if (sound3On)
+void soundChannel3(int ticks)
+{
+	for (int time = 0; ticks > 0;)
 	{
-		if (sound3ATL)
+		int run = ticks;
+
+		if (sound3On && sound3ATL && sound3Continue)
+			soundRunUntil(run, sound3ATL);
+
+		if (sound3On && (sound3ATL || !sound3Continue))
 		{
-			sound3ATL -= soundQuality;
+			u32 step = soundQuality * sound3Skip;
+
+			if (!soundSilent)
+				sound3Last = soundWave(time, sound3Index, step, run);
+
+			sound3Index += run * step;
+			sound3Index &= sound3DataSize ? 0x3fffffff : 0x1fffffff;
+		}
+		else if (!soundSilent)
+			soundOutput(2, time, sound3Last);
 
-			if (sound3ATL <= 0 && sound3Continue)
+		time  += run * SOUND_BLIP_TICK;
+		ticks -= run;
+
+		if (sound3On && sound3ATL)
+		{
+			sound3ATL  = soundLengthCount(sound3ATL, run - 1);
+			if (sound3ATL)
 			{
-				ioMem[NR52] &= 0xfb;
-				sound3On	 = 0;
+				sound3ATL -= soundQuality;
+
+				if (sound3ATL <= 0 && sound3Continue)
+				{
+					ioMem[NR52] &= 0xfb;
+					sound3On	 = 0;
+				}
 			}
 		}
 	}
 }
 
-void soundChannel4()
+// Runs the noise for the ticks, the first one starting at time; the edges are
+// output only if the register shifts slowly enough, else one level per tick.
+static void soundNoise(int time, int ticks, int vol)
 {
-	int vol = sound4EnvelopeVolume;
+  #define NOISE_ONE_SAMP_SCALE  0x200000
 
-	int value = 0;
+	u32	 step  = soundQuality * sound4ShiftSkip;
+	bool edges = step <= SOUND_BLIP_MAX_NOISE_STEP && !soundSilent;
+	u32	 phase = sound4ShiftIndex;
 
-	if (sound4Clock <= 0x0c)
-	{
-		if (sound4On && (sound4ATL || !sound4Continue))
-		{
-	  #define NOISE_ONE_SAMP_SCALE  0x200000
+	if (!soundSilent)
+		soundOutput(3, time, ((sound4ShiftRight & 1) * 2 - 1) * vol);
 
-			sound4Index		 += soundQuality * sound4Skip;
-			sound4ShiftIndex += soundQuality * sound4ShiftSkip;
+	sound4Index = (int32)((sound4Index + (s64)ticks * soundQuality * sound4Skip) % NOISE_ONE_SAMP_SCALE);
+
+	int tick = 0;
+	while (step && soundSkipTo(NOISE_ONE_SAMP_SCALE, step, phase, tick, ticks))
+	{
+		u32 edge = NOISE_ONE_SAMP_SCALE - phase;
 
+		for (phase += step; phase >= NOISE_ONE_SAMP_SCALE; phase -= NOISE_ONE_SAMP_SCALE)
+		{
 			if (sound4NSteps)
-			{
-				while (sound4ShiftIndex >= NOISE_ONE_SAMP_SCALE)
-				{
-					sound4ShiftRight = (((sound4ShiftRight << 6) ^
-					                     (sound4ShiftRight << 5)) & 0x40) |
-					                   (sound4ShiftRight >> 1);
-					sound4ShiftIndex -= NOISE_ONE_SAMP_SCALE;
-				}
-			}
+				sound4ShiftRight = (((sound4ShiftRight << 6) ^
+				                     (sound4ShiftRight << 5)) & 0x40) |
+				                   (sound4ShiftRight >> 1);
 			else
-			{
-				while (sound4ShiftIndex >= NOISE_ONE_SAMP_SCALE)
-				{
-					sound4ShiftRight = (((sound4ShiftRight << 14) ^
-					                     (sound4ShiftRight << 13)) & 0x4000) |
-					                   (sound4ShiftRight >> 1);
+				sound4ShiftRight = (((sound4ShiftRight << 14) ^
+				                     (sound4ShiftRight << 13)) & 0x4000) |
+				                   (sound4ShiftRight >> 1);
 
-					sound4ShiftIndex -= NOISE_ONE_SAMP_SCALE;
-				}
+			if (edges)
+			{
+				soundEdge(3, time + tick * SOUND_BLIP_TICK, edge, step, ((sound4ShiftRight & 1) * 2 - 1) * vol);
+				edge += NOISE_ONE_SAMP_SCALE;
 			}
+		}
 
-			sound4Index		 %= NOISE_ONE_SAMP_SCALE;
-			sound4ShiftIndex %= NOISE_ONE_SAMP_SCALE;
+		if (!edges && !soundSilent)
+			soundOutput(3, time + tick * SOUND_BLIP_TICK, ((sound4ShiftRight & 1) * 2 - 1) * vol);
 
-			value = ((sound4ShiftRight & 1) * 2 - 1) * vol;
-		}
-		else
-		{
-			value = 0;
-		}
+		tick++;
 	}
 
-	soundBuffer[3][soundIndex] = value;
+	// the ticks left don't reach the next shift
+	if (step)
+		phase += (ticks - tick) * step;
+
+	sound4ShiftIndex = phase;
+}
 
-	if (sound4On)
+void soundChannel4(int ticks)
+{
+	for (int time = 0; ticks > 0;)
 	{
+		int run = ticks;
+
+		if (sound4On)
+		{
+			if (sound4ATL && sound4Continue)
+				soundRunUntil(run, sound4ATL);
+			if (sound4EnvelopeATL)
+				soundRunEnvelope(run, sound4EnvelopeATL, sound4EnvelopeATLReload,
+				                 sound4EnvelopeVolume, sound4EnvelopeUpDown);
+		}
+
+		if (sound4Clock <= 0x0c && sound4On && (sound4ATL || !sound4Continue))
+			soundNoise(time, run, sound4EnvelopeVolume);
+		else if (!soundSilent)
+			soundOutput(3, time, 0);
+
+		time  += run * SOUND_BLIP_TICK;
+		ticks -= run;
+
+		if (!sound4On)
+			continue;
+
+		if (sound4ATL)
+			sound4ATL = soundLengthCount(sound4ATL, run - 1);
+		if (sound4EnvelopeATL)
+			sound4EnvelopeATL -= (run - 1) * soundQuality;
+
 		if (sound4ATL)
 		{
 			sound4ATL -= soundQuality;
@@ -894,9 +1205,9 @@ void soundChannel4()
 	}
 }
 
-void soundDirectSoundA()
+void soundDirectSoundA(int time)
 {
-	soundBuffer[4][soundIndex] = soundDSAValue;
+	soundOutput(4, time, ((s8)soundDSPlaying[0]) >> ((ioMem[0x82] & 4) ? 0 : 1));
 }
 
 void soundDirectSoundATimer()
@@ -927,9 +1238,9 @@ void soundDirectSoundATimer()
 		soundDSAValue = 0;
 }
 
-void soundDirectSoundB()
+void soundDirectSoundB(int time)
 {
-	soundBuffer[5][soundIndex] = soundDSBValue;
+	soundOutput(5, time, ((s8)soundDSPlaying[1]) >> ((ioMem[0x82] & 8) ? 0 : 1));
 }
 
 void soundDirectSoundBTimer()
@@ -962,138 +1273,241 @@ void soundDirectSoundBTimer()
 	}
 }
 
+// The FIFOs are popped (and refilled by DMA) right away, but the channels
+// only play the new values from the next tick on, so the values are queued
+// instead of catching up.
+static void soundDSQueuePlay(int ch, u8 value)
+{
+	soundCountTicks();
+	if (soundDSQueued == SOUND_DS_QUEUE_SIZE)
+		soundCatchUp();
+	if (soundTicksPending == 0)
+	{
+		soundDSPlaying[ch] = value;
+		return;
+	}
+	soundDSQueue[soundDSQueued++] = (soundTicksPending << 9) | (ch << 8) | value;
+}
+
 void soundTimerOverflow(int timer)
 {
 	if (soundDSAEnabled && (soundDSATimer == timer))
 	{
 		soundDirectSoundATimer();
+		soundDSQueuePlay(0, soundDSAValue);
 	}
 	if (soundDSBEnabled && (soundDSBTimer == timer))
 	{
 		soundDirectSoundBTimer();
+		soundDSQueuePlay(1, soundDSBValue);
 	}
 }
 
-void soundMix()
+static void soundRoute(int ch, bool left, bool right, int gain)
 {
-	soundBalance = (ioMem[NR51] & soundEnableFlag);
+	// a channel on neither side keeps a zero gain
+	int pan = left ? (right ? SOUND_CENTER : SOUND_LEFT) : SOUND_RIGHT;
 
-	int cgbRatio = ioMem[0x82] & 3;
-	int dsaRatio = ioMem[0x82] & 4;
-	int dsbRatio = ioMem[0x82] & 8;
-
-	int cgbResL = 0;
-	if (soundBalance & 16)
-	{
-		cgbResL += ((s8)soundBuffer[0][soundIndex]);
-	}
-	if (soundBalance & 32)
+	if (pan != soundPan[ch] && soundAmp[ch])
 	{
-		cgbResL += ((s8)soundBuffer[1][soundIndex]);
-	}
-	if (soundBalance & 64)
-	{
-		cgbResL += ((s8)soundBuffer[2][soundIndex]);
-	}
-	if (soundBalance & 128)
-	{
-		cgbResL += ((s8)soundBuffer[3][soundIndex]);
+		soundSynth.offset_inline(soundBlipRead * SOUND_BLIP_TICK, -soundAmp[ch], &soundBlip[soundPan[ch]]);
+		soundAmp[ch] = 0;
 	}
 
-	int cgbResR = 0;
-	if (soundBalance & 1)
-	{
-		cgbResR += ((s8)soundBuffer[0][soundIndex]);
-	}
-	if (soundBalance & 2)
-	{
-		cgbResR += ((s8)soundBuffer[1][soundIndex]);
-	}
-	if (soundBalance & 4)
-	{
-		cgbResR += ((s8)soundBuffer[2][soundIndex]);
-	}
-	if (soundBalance & 8)
-	{
-		cgbResR += ((s8)soundBuffer[3][soundIndex]);
-	}
+	soundPan[ch]  = pan;
+	soundGain[ch] = (left || right) ? gain : 0;
+	soundDelta(ch, 0);
+}
 
-	int dsResL = 0;
-	if ((soundControl & 0x0200) && (soundEnableFlag & 0x100))
-	{
-		if (!dsaRatio)
-			dsResL = ((s8)soundBuffer[4][soundIndex]) >> 1;
-		else
-			dsResL = ((s8)soundBuffer[4][soundIndex]);
-	}
-	if ((soundControl & 0x2000) && (soundEnableFlag & 0x200))
-	{
-		if (!dsbRatio)
-			dsResL += ((s8)soundBuffer[5][soundIndex]) >> 1;
-		else
-			dsResL += ((s8)soundBuffer[5][soundIndex]);
-	}
+// called whenever NR50, NR51, SGCNT0_H or the enabled channels change
+static void soundMixGains()
+{
+	soundBalance  = (ioMem[NR51] & soundEnableFlag);
+	soundGainFlag = soundEnableFlag;
 
-	int dsResR = 0;
-	if ((soundControl & 0x0100) && (soundEnableFlag & 0x100))
-	{
-		if (!dsaRatio)
-			dsResR = ((s8)soundBuffer[4][soundIndex]) >> 1;
-		else
-			dsResR = ((s8)soundBuffer[4][soundIndex]);
-	}
+	if (soundBlipQuality != soundQuality)
+		return; // soundBlipReset is pending and calls back here
 
-	if ((soundControl & 0x1000) && (soundEnableFlag & 0x200))
-	{
-		if (!dsbRatio)
-			dsResR += ((s8)soundBuffer[5][soundIndex]) >> 1;
-		else
-			dsResR += ((s8)soundBuffer[5][soundIndex]);
-	}
-
-	dsResL  *= 170;
-	dsResR	*= 170;
-	cgbResL *= 52 * soundLevel1;
-	cgbResR *= 52 * soundLevel1;
+	int cgbGain = 52 * soundLevel1;
 
-	switch (cgbRatio)
+	switch (ioMem[0x82] & 3)
 	{
 	case 0:
 	case 3: // prohibited, but 25%
-		cgbResL >>= 2;
-		cgbResR >>= 2;
+		cgbGain >>= 2;
 		break;
 	case 1:
-		cgbResL >>= 1;
-		cgbResR >>= 1;
+		cgbGain >>= 1;
 		break;
 	case 2:
 		break;
 	}
 
-	systemSoundMix(cgbResL + dsResL, cgbResR + dsResR);
+	for (int ch = 0; ch < 4; ch++)
+		soundRoute(ch, soundBalance & (16 << ch), soundBalance & (1 << ch), cgbGain);
+
+	soundRoute(4, (soundControl & 0x0200) && (soundEnableFlag & 0x100),
+	           (soundControl & 0x0100) && (soundEnableFlag & 0x100), 170);
+	soundRoute(5, (soundControl & 0x2000) && (soundEnableFlag & 0x200),
+	           (soundControl & 0x1000) && (soundEnableFlag & 0x200), 170);
 }
 
-void soundTick()
+// Hands the samples of the ticks run since the last read over to the mixer.
+// The deltas of later ticks only reach later samples, so these are final.
+static void soundBlipReadSamples()
 {
-	if (systemSoundOn)
+	int count = soundBlipRead;
+	if (count == 0)
+		return;
+
+	for (int i = 0; i < 3; i++)
 	{
+		soundBlip[i].end_frame(count * SOUND_BLIP_TICK);
+		soundBlip[i].read_samples(soundBlipSamples[i], count);
+	}
+	soundBlipRead = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		int center = soundBlipSamples[SOUND_CENTER][i];
+		systemSoundMix(center + soundBlipSamples[SOUND_LEFT][i], center + soundBlipSamples[SOUND_RIGHT][i]);
+		systemSoundNext();
+	}
+}
+
+// Plays the DirectSound values from start on, the queued ones from their
+// ticks; the values queued for later ticks are left in the queue.
+static void soundDirectSound(int start, int ticks, int &queued, bool play)
+{
+	int time = 0;
+
+	for (;;)
+	{
+		if (play)
+		{
+			soundDirectSoundA(time);
+			soundDirectSoundB(time);
+		}
+
+		if (queued == soundDSQueued)
+			break;
+
+		int tick = soundDSQueue[queued] >> 9;
+		if (tick >= start + ticks)
+			break;
+
+		while (queued < soundDSQueued && (int)(soundDSQueue[queued] >> 9) == tick)
+		{
+			u32 entry = soundDSQueue[queued++];
+			soundDSPlaying[(entry >> 8) & 1] = entry & 0xff;
+		}
+		time = (tick - start) * SOUND_BLIP_TICK;
+	}
+}
+
+// Runs the ticks from start on, at most up to the next read of the samples,
+// and returns how many were run.
+static int soundRunTicks(int start, int ticks, int &queued)
+{
+	if (soundSilent)
+	{
+		// the channels still step their lengths, envelopes, sweep and
+		// indices (NR52 and NR13/14 are read back by games), only the
+		// waveforms and the mixing are skipped; the DirectSound FIFOs are
+		// driven by the timers either way
+		soundBlipReadSamples();
+		soundBlipQuality = 0; // rebuild the buffers if synthesis resumes
+		soundBalance	 = (ioMem[NR51] & soundEnableFlag);
+		soundGainFlag	 = soundEnableFlag;
+
 		if (soundMasterOn && !stopState)
 		{
-			soundChannel1();
-			soundChannel2();
-			soundChannel3();
-			soundChannel4();
-			soundDirectSoundA();
-			soundDirectSoundB();
-			soundMix();
+			soundChannel1(ticks);
+			soundChannel2(ticks);
+			soundChannel3(ticks);
+			soundChannel4(ticks);
 		}
-		else
+		soundDirectSound(start, ticks, queued, false);
+
+		for (int tick = 0; tick < ticks; tick++)
 		{
 			systemSoundMixSilence();
+			systemSoundNext();
 		}
-		systemSoundNext();
 	}
+	else if (systemSoundOn)
+	{
+		if (soundBlipQuality != soundQuality)
+		{
+			soundBlipReadSamples();
+			soundBlipReset();
+		}
+
+		if (soundGainFlag != soundEnableFlag)
+			soundMixGains();
+
+		if (ticks > SOUND_BLIP_READ_BATCH - soundBlipRead)
+			ticks = SOUND_BLIP_READ_BATCH - soundBlipRead;
+
+		if (soundMasterOn && !stopState)
+		{
+			soundChannel1(ticks);
+			soundChannel2(ticks);
+			soundChannel3(ticks);
+			soundChannel4(ticks);
+			soundDirectSound(start, ticks, queued, true);
+		}
+		else
+		{
+			for (int ch = 0; ch < 6; ch++)
+				soundOutput(ch, 0, 0);
+			soundDirectSound(start, ticks, queued, false);
+		}
+
+		soundBlipRead += ticks;
+		if (soundBlipRead == SOUND_BLIP_READ_BATCH)
+			soundBlipReadSamples();
+	}
+	else
+		soundDirectSound(start, ticks, queued, false);
+
+	return ticks;
+}
+
+// Runs the ticks counted since the last call. Called before the sound
+// registers are read or written, before the stop state changes and at the end
+// of each frame.
+void soundCatchUp()
+{
+	soundCountTicks();
+
+	int ticks = soundTicksPending;
+	int queued = 0;
+
+	soundTicksPending = 0;
+	for (int tick = 0; tick < ticks;)
+		tick += soundRunTicks(tick, ticks - tick, queued);
+
+	while (queued < soundDSQueued)
+	{
+		u32 entry = soundDSQueue[queued++];
+		soundDSPlaying[(entry >> 8) & 1] = entry & 0xff;
+	}
+	soundDSQueued = 0;
+}
+
+// Runs the pending ticks and hands all their samples over; called at the end
+// of each frame and before the state is saved
+void soundFlush()
+{
+	soundCatchUp();
+	soundBlipReadSamples();
+}
+
+// called every sound tick by the V7 core
+void soundTick()
+{
+	soundTicksPending++;
 }
 
 void soundReset()
@@ -1166,6 +1580,10 @@ void soundReset()
 
 	soundControl = 0;
 
+	soundTicksPending = 0;
+	soundDSQueued	  = 0;
+	soundDSPlaying[0] = soundDSPlaying[1] = 0;
+
 	sound1On = 0;
 	sound2On = 0;
 	sound3On = 0;
@@ -1185,6 +1603,8 @@ void soundReset()
 		sound3WaveRam[addr++] = 0x00;
 		sound3WaveRam[addr++] = 0xff;
 	}
+
+	soundBlipReset();
 }
 
 void soundSaveGame(gzFile gzFile)
@@ -1228,6 +1648,7 @@ void soundReadGame(gzFile gzFile, int version)
 	int quality = 1;
 	utilGzRead(gzFile, &quality, sizeof(int32));
 	systemSoundSetQuality(quality);
+	soundBlipReset();
 
 	sound1Wave = soundWavePattern[ioMem[NR11] >> 6];
 	sound2Wave = soundWavePattern[ioMem[NR21] >> 6];
@@ -1241,5 +1662,10 @@ void soundReadGame(gzFile gzFile, int version)
 	//}
 	soundDSBEnabled	 = (u8) (soundDSBEnabled_int32 & 0xFF);
 	soundDSBValue	 = (u8) (soundDSBValue_int32 & 0xFF);
+
+	soundTicksPending = 0;
+	soundDSQueued	  = 0;
+	soundDSPlaying[0] = soundDSAValue;
+	soundDSPlaying[1] = soundDSBValue;
 }
 
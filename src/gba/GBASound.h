@@ -39,6 +39,8 @@
 							 // FIXME: (16777216.0/280896.0)(fps) vs 60.0fps?
 
 extern void soundTick();
+extern void soundCatchUp();
+extern void soundFlush();
 extern void soundReset();
 extern void soundSaveGame(gzFile);
 extern void soundReadGame(gzFile, int);
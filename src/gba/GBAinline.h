@@ -14,7 +14,7 @@ typedef struct
 	u32 mask;
 } MemoryMap;
 
-extern MemoryMap memoryMap[256];
+extern INSTANCE_LOCAL MemoryMap memoryMap[256];
 
 #if 0
 
@@ -25,8 +25,8 @@ typedef struct
 	u32	 reserved3;
 } RTCCLOCKDATA;
 
-static RTCCLOCKDATA rtcClockData;
-static bool			rtcEnabled = false;
+static INSTANCE_LOCAL RTCCLOCKDATA rtcClockData;
+static INSTANCE_LOCAL bool			rtcEnabled = false;
 
 void rtcEnable(bool enable)
 {
@@ -772,6 +772,21 @@ bool CPUWriteMemState(char *memory, int available)
 	return res;
 }
 
+// Uncompressed memory states, for tools saving and loading states at a high
+// rate; returns the size of the state, or 0 if it didn't fit
+int CPUWriteMemStateRaw(char *memory, int available)
+{
+	gzFile gzFile = utilMemRawOpen(memory, available);
+
+	bool res  = CPUWriteStateToStream(gzFile);
+	int	 size = utilGzTell(gzFile);
+
+	if (utilGzClose(gzFile) != Z_OK)
+		res = false;
+
+	return res ? size : 0;
+}
+
 bool CPUReadStateFromStream(gzFile gzFile)
 {
 	char tempBackupName[128];
@@ -1044,6 +1059,20 @@ bool CPUReadMemState(char *memory, int available)
 	return res;
 }
 
+bool CPUReadMemStateRaw(char *memory, int size)
+{
+	gzFile gzFile = utilMemRawOpen(memory, size);
+
+	tempSaveSafe = false;
+	bool res = CPUReadStateFromStream(gzFile);
+	tempSaveSafe = true;
+
+	if (utilGzClose(gzFile) != Z_OK)
+		res = false;
+
+	return res;
+}
+
 bool CPUReadState(const char *file)
 {
 	gzFile gzFile = utilGzOpen(file, "rb");
@@ -3897,6 +3926,7 @@ updateLoop:
 			if (soundTicks < 1)
 			{
 				soundTick();
+				soundFlush();
 				soundTicks += soundTickStep;
 			}
 
@@ -4249,6 +4279,12 @@ struct EmulatedSystem GBASystem =
 	CPUReadMemState,
 	// emuWriteMemState
 	CPUWriteMemState,
+	// emuReadMemStateRaw
+	CPUReadMemStateRaw,
+	// emuWriteMemStateRaw
+	CPUWriteMemStateRaw,
+	// emuWriteMemStateIncremental
+	NULL,
 	// emuWritePNG
 	CPUWritePNGFile,
 	// emuWriteBMP
@@ -3,6 +3,7 @@
 #include "GBAGlobals.h"
 #include "GBAinline.h"
 #include "GBACpu.h"
+#include "../../common/SystemGlobals.h"
 #include "../../common/vbalua.h"
 
 #ifdef PROFILING
@@ -19,7 +20,7 @@
 
 ///////////////////////////////////////////////////////////////////////////
 
-static int clockTicks;
+static INSTANCE_LOCAL int clockTicks;
 
 static INSN_REGPARM void armUnknownInsn(u32 opcode)
 {
@@ -2879,11 +2880,271 @@ static void tester(void)
 
 #endif
 
-int armExecute()
+// Evaluates the condition field of an ARM opcode
+static inline bool armConditionPassed(u32 opcode)
+{
+	u32	 cond	  = opcode >> 28;
+	bool cond_res = true;
+	if (UNLIKELY(cond != 0x0E))    // most opcodes are AL (always)
+	{
+		switch (cond)
+		{
+		case 0x00:   // EQ
+			cond_res = Z_FLAG;
+			break;
+		case 0x01:   // NE
+			cond_res = !Z_FLAG;
+			break;
+		case 0x02:   // CS
+			cond_res = C_FLAG;
+			break;
+		case 0x03:   // CC
+			cond_res = !C_FLAG;
+			break;
+		case 0x04:   // MI
+			cond_res = N_FLAG;
+			break;
+		case 0x05:   // PL
+			cond_res = !N_FLAG;
+			break;
+		case 0x06:   // VS
+			cond_res = V_FLAG;
+			break;
+		case 0x07:   // VC
+			cond_res = !V_FLAG;
+			break;
+		case 0x08:   // HI
+			cond_res = C_FLAG && !Z_FLAG;
+			break;
+		case 0x09:   // LS
+			cond_res = !C_FLAG || Z_FLAG;
+			break;
+		case 0x0A:   // GE
+			cond_res = N_FLAG == V_FLAG;
+			break;
+		case 0x0B:   // LT
+			cond_res = N_FLAG != V_FLAG;
+			break;
+		case 0x0C:   // GT
+			cond_res = !Z_FLAG && (N_FLAG == V_FLAG);
+			break;
+		case 0x0D:   // LE
+			cond_res = Z_FLAG || (N_FLAG != V_FLAG);
+			break;
+		case 0x0E:   // AL (impossible, checked above)
+			cond_res = true;
+			break;
+		case 0x0F:
+		default:
+			// ???
+			cond_res = false;
+			break;
+		}
+	}
+	return cond_res;
+}
+
+// Block cache ////////////////////////////////////////////////////////////
+
+#define ARM_BLOCK_INSNS		 16
+#define ARM_BLOCK_CACHE_SIZE 1024
+
+struct ArmBlockInsn
+{
+	insnfunc_t func;
+	u32		   opcode;
+};
+
+struct ArmBlock
+{
+	u32			 address;
+	u32			 generation;
+	u32			 pageGeneration;
+	int			 count;
+	ArmBlockInsn insn[ARM_BLOCK_INSNS];
+};
+
+static INSTANCE_LOCAL ArmBlock armBlockCache[ARM_BLOCK_CACHE_SIZE];
+
+// true for the opcodes that may leave the straight-line code
+static inline bool armEndsBlock(u32 opcode)
+{
+	return (((opcode >> 25) & 7) == 5) ||                         // B, BL
+	       (((opcode >> 24) & 0x0F) == 0x0F) ||                   // SWI
+	       ((opcode & 0x0FFFFFF0) == 0x012FFF10) ||               // BX
+	       ((((opcode >> 25) & 7) == 4) && (opcode & 0x8000)) ||  // LDM {..., PC}
+	       (((opcode >> 12) & 0x0F) == 0x0F);                     // anything with Rd == PC
+}
+
+static ArmBlock *armGetBlock(u32 address)
+{
+	int page = CPUBlockCachePage(address);
+	if (page == CPU_BLOCK_CACHE_UNCACHED)
+		return NULL;
+
+	ArmBlock *block = &armBlockCache[(address >> 2) & (ARM_BLOCK_CACHE_SIZE - 1)];
+	if (block->address == address && block->generation == cpuBlockCacheGeneration &&
+	    (page == CPU_BLOCK_CACHE_ROM || block->pageGeneration == cpuBlockCachePageGen[page]))
+		return block;
+
+	block->address	  = address;
+	block->generation = cpuBlockCacheGeneration;
+	if (page != CPU_BLOCK_CACHE_ROM)
+	{
+		block->pageGeneration		= cpuBlockCachePageGen[page];
+		cpuBlockCachePageCode[page] = 1;
+	}
+
+	int count = 0;
+	do
+	{
+		u32 opcode = CPUReadMemoryQuick(address);
+		block->insn[count].func	  = armInsnTable[((opcode >> 16) & 0xFF0) | ((opcode >> 4) & 0x0F)];
+		block->insn[count].opcode = opcode;
+		count++;
+		address += 4;
+		if (armEndsBlock(opcode))
+			break;
+	}
+	while (count < ARM_BLOCK_INSNS && (address & 0xFF));
+	block->count = count;
+
+	return block;
+}
+
+// Same as armExecuteLoop(), but fetches and decodes from the block cache.
+// The prefetch queue is still maintained, so both loops can be mixed freely.
+template <int features>
+static int armExecuteCached()
+{
+	do
+	{
+		ArmBlock *block = armGetBlock(armNextPC);
+		int		  insns = 0;
+		if (block && block->insn[0].opcode == cpuPrefetch[0] &&
+		    (block->count == 1 || block->insn[1].opcode == cpuPrefetch[1]))
+			insns = block->count;
+
+		if (!insns)
+		{
+			// not cacheable or modified since it was prefetched
+			if (features & CPU_FEATURE_CHEATS)
+				CPUMasterCodeCheck();
+
+			if ((armNextPC & 0x0803FFFF) == 0x08020000)
+				busPrefetchCount = 0x100;
+
+			u32 opcode = cpuPrefetch[0];
+			cpuPrefetch[0] = cpuPrefetch[1];
+
+			busPrefetch = false;
+			if (busPrefetchCount & 0xFFFFFE00)
+				busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF);
+
+			clockTicks = 0;
+			u32 oldArmNextPC = armNextPC;
+
+			if (features & CPU_FEATURE_EXEC_HOOK)
+			{
+#ifndef FINAL_VERSION
+				if (armNextPC == armStopAddr)
+				{
+					armNextPC++;
+				}
+#endif
+
+				CallRegisteredLuaMemHook(armNextPC, 4, CPUReadMemoryQuick(armNextPC), LUAMEMHOOK_EXEC);
+			}
+
+			armNextPC  = reg[15].I;
+			reg[15].I += 4;
+			ARM_PREFETCH_NEXT;
+
+			bool cond_res = armConditionPassed(opcode);
+
+			if (cond_res)
+				(*armInsnTable[((opcode >> 16) & 0xFF0) | ((opcode >> 4) & 0x0F)])(opcode);
+#ifdef INSN_COUNTER
+			count(opcode, cond_res);
+#endif
+			if (clockTicks < 0)
+				return 0;
+			if (clockTicks == 0)
+				clockTicks = 1 + codeTicksAccessSeq32(oldArmNextPC);
+			cpuTotalTicks += clockTicks;
+			continue;
+		}
+
+		u32 invalidations = cpuBlockCacheInvalidations;
+		for (int i = 0; i < insns; i++)
+		{
+			if (features & CPU_FEATURE_CHEATS)
+				CPUMasterCodeCheck();
+
+			if ((armNextPC & 0x0803FFFF) == 0x08020000)
+				busPrefetchCount = 0x100;
+
+			u32 opcode = block->insn[i].opcode;
+			cpuPrefetch[0] = cpuPrefetch[1];
+
+			busPrefetch = false;
+			if (busPrefetchCount & 0xFFFFFE00)
+				busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF);
+
+			clockTicks = 0;
+			u32 oldArmNextPC = armNextPC;
+
+			if (features & CPU_FEATURE_EXEC_HOOK)
+			{
+#ifndef FINAL_VERSION
+				if (armNextPC == armStopAddr)
+				{
+					armNextPC++;
+				}
+#endif
+
+				CallRegisteredLuaMemHook(armNextPC, 4, opcode, LUAMEMHOOK_EXEC);
+			}
+
+			armNextPC  = reg[15].I;
+			reg[15].I += 4;
+			if (i + 2 < insns)
+				cpuPrefetch[1] = block->insn[i + 2].opcode;
+			else
+				ARM_PREFETCH_NEXT;
+
+			bool cond_res = armConditionPassed(opcode);
+
+			if (cond_res)
+				(*block->insn[i].func)(opcode);
+#ifdef INSN_COUNTER
+			count(opcode, cond_res);
+#endif
+			if (clockTicks < 0)
+				return 0;
+			if (clockTicks == 0)
+				clockTicks = 1 + codeTicksAccessSeq32(oldArmNextPC);
+			cpuTotalTicks += clockTicks;
+
+			// leave the block on jumps, mode changes, events and code writes
+			if (armNextPC != oldArmNextPC + 4 || invalidations != cpuBlockCacheInvalidations ||
+			    cpuTotalTicks >= cpuNextEvent || !armState || holdState || SWITicks)
+				break;
+		}
+	}
+	while (cpuTotalTicks < cpuNextEvent && armState && !holdState && !SWITicks);
+
+	return 1;
+}
+
+// features is a mask of CPU_FEATURE_*, see thumbExecuteLoop()
+template <int features>
+static int armExecuteLoop()
 {
 	do
 	{
-		CPUMasterCodeCheck();
+		if (features & CPU_FEATURE_CHEATS)
+			CPUMasterCodeCheck();
 
 		if ((armNextPC & 0x0803FFFF) == 0x08020000)
 			busPrefetchCount = 0x100;
@@ -2898,77 +3159,23 @@ int armExecute()
 		clockTicks = 0;
 		u32 oldArmNextPC = armNextPC;
 
-#ifndef FINAL_VERSION
-		if (armNextPC == armStopAddr)
+		if (features & CPU_FEATURE_EXEC_HOOK)
 		{
-			armNextPC++;
-		}
+#ifndef FINAL_VERSION
+			if (armNextPC == armStopAddr)
+			{
+				armNextPC++;
+			}
 #endif
 
-		CallRegisteredLuaMemHook(armNextPC, 4, CPUReadMemoryQuick(armNextPC), LUAMEMHOOK_EXEC);
+			CallRegisteredLuaMemHook(armNextPC, 4, CPUReadMemoryQuick(armNextPC), LUAMEMHOOK_EXEC);
+		}
 
 		armNextPC  = reg[15].I;
 		reg[15].I += 4;
 		ARM_PREFETCH_NEXT;
 
-		u32	 cond	  = opcode >> 28;
-		bool cond_res = true;
-		if (UNLIKELY(cond != 0x0E))    // most opcodes are AL (always)
-		{
-			switch (cond)
-			{
-			case 0x00:   // EQ
-				cond_res = Z_FLAG;
-				break;
-			case 0x01:   // NE
-				cond_res = !Z_FLAG;
-				break;
-			case 0x02:   // CS
-				cond_res = C_FLAG;
-				break;
-			case 0x03:   // CC
-				cond_res = !C_FLAG;
-				break;
-			case 0x04:   // MI
-				cond_res = N_FLAG;
-				break;
-			case 0x05:   // PL
-				cond_res = !N_FLAG;
-				break;
-			case 0x06:   // VS
-				cond_res = V_FLAG;
-				break;
-			case 0x07:   // VC
-				cond_res = !V_FLAG;
-				break;
-			case 0x08:   // HI
-				cond_res = C_FLAG && !Z_FLAG;
-				break;
-			case 0x09:   // LS
-				cond_res = !C_FLAG || Z_FLAG;
-				break;
-			case 0x0A:   // GE
-				cond_res = N_FLAG == V_FLAG;
-				break;
-			case 0x0B:   // LT
-				cond_res = N_FLAG != V_FLAG;
-				break;
-			case 0x0C:   // GT
-				cond_res = !Z_FLAG && (N_FLAG == V_FLAG);
-				break;
-			case 0x0D:   // LE
-				cond_res = Z_FLAG || (N_FLAG != V_FLAG);
-				break;
-			case 0x0E:   // AL (impossible, checked above)
-				cond_res = true;
-				break;
-			case 0x0F:
-			default:
-				// ???
-				cond_res = false;
-				break;
-			}
-		}
+		bool cond_res = armConditionPassed(opcode);
 
 		if (cond_res)
 			(*armInsnTable[((opcode >> 16) & 0xFF0) | ((opcode >> 4) & 0x0F)])(opcode);
@@ -2986,3 +3193,36 @@ int armExecute()
 	return 1;
 }
 
+static int (*const armExecuteLoops[CPU_FEATURE_MASK + 1])() =
+{
+	armExecuteLoop<0>,
+	armExecuteLoop<1>,
+	armExecuteLoop<2>,
+	armExecuteLoop<3>,
+	// no idle loop detection in ARM code
+	armExecuteLoop<0>,
+	armExecuteLoop<1>,
+	armExecuteLoop<2>,
+	armExecuteLoop<3>,
+};
+
+static int (*const armExecuteCachedLoops[CPU_FEATURE_MASK + 1])() =
+{
+	armExecuteCached<0>,
+	armExecuteCached<1>,
+	armExecuteCached<2>,
+	armExecuteCached<3>,
+	// no idle loop detection in ARM code
+	armExecuteCached<0>,
+	armExecuteCached<1>,
+	armExecuteCached<2>,
+	armExecuteCached<3>,
+};
+
+int armExecute()
+{
+	if (cpuBlockCacheEnabled)
+		return armExecuteCachedLoops[CPUExecFeatures()]();
+
+	return armExecuteLoops[CPUExecFeatures()]();
+}
@@ -5,6 +5,7 @@
 #include "GBAGlobals.h"
 #include "GBAinline.h"
 #include "GBACpu.h"
+#include "../../common/SystemGlobals.h"
 #include "../../common/vbalua.h"
 
 #ifdef PROFILING
@@ -15,9 +16,18 @@
 #define snprintf _snprintf
 #endif
 
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 
-static int clockTicks;
+static INSTANCE_LOCAL int clockTicks;
 
 static INSN_REGPARM void thumbUnknownInsn(u32 opcode)
 {
@@ -2323,13 +2333,1526 @@ static insnfunc_t thumbInsnTable[1024] = {
 	thumbF8,	thumbF8,	thumbF8,	thumbF8,	thumbF8,	thumbF8,	thumbF8,	thumbF8,
 };
 
+// Idle loop detection ////////////////////////////////////////////////////
+//
+// Busy-wait loops (polling VCOUNT, DISPSTAT or a flag set by an interrupt
+// handler) don't write anything and can't see anything change until the next
+// event. When such a loop reaches its head twice with the same CPU state, every
+// further iteration takes the same number of ticks, so all the complete
+// iterations before cpuNextEvent are skipped at once.
+
+#define THUMB_IDLE_LOOP_BYTES 32
+#define THUMB_IDLE_LOOP_LOADS 8
+#define THUMB_IDLE_CACHE_SIZE 64
+
+struct ThumbIdleLoad
+{
+	int base;  // register, or -1 when offset is the address
+	int index; // offset register, or -1
+	u32 offset;
+	u32 size;
+};
+
+struct ThumbIdleLoop
+{
+	u32			  head;
+	u32			  branch;
+	bool		  idle;
+	int			  numLoads;
+	ThumbIdleLoad load[THUMB_IDLE_LOOP_LOADS];
+	u16			  code[THUMB_IDLE_LOOP_BYTES / 2 + 1];
+};
+
+struct ThumbIdleState
+{
+	ThumbIdleLoop *loop;
+	u32			   reg[16];
+	bool8		   flags[4];
+	bool8		   busPrefetch;
+	u32			   busPrefetchCount;
+	u32			   prefetch[2];
+	int32		   ticks;
+};
+
+static INSTANCE_LOCAL ThumbIdleLoop  thumbIdleCache[THUMB_IDLE_CACHE_SIZE];
+static INSTANCE_LOCAL ThumbIdleState thumbIdle;
+
+// Checks that the code between head and branch only reads memory, and that
+// every load address stays the same for all iterations
+static bool thumbIdleAnalyze(ThumbIdleLoop *loop)
+{
+	u32 written = 0;
+	loop->numLoads = 0;
+
+	for (u32 pc = loop->head; pc <= loop->branch; pc += 2)
+	{
+		u32 opcode = CPUReadHalfWordQuick(pc);
+		loop->code[(pc - loop->head) >> 1] = opcode;
+
+		ThumbIdleLoad load;
+		load.base  = -2;
+		load.index = -1;
+		int dest = -1;
+
+		switch (opcode >> 11)
+		{
+		case 0x00: // LSL/LSR/ASR #Imm5
+		case 0x01:
+		case 0x02:
+		case 0x03: // ADD/SUB
+			dest = opcode & 7;
+			break;
+		case 0x04: // MOV #Offset8
+		case 0x06: // ADD #Offset8
+		case 0x07: // SUB #Offset8
+			dest = (opcode >> 8) & 7;
+			break;
+		case 0x05: // CMP #Offset8
+			break;
+		case 0x08:
+			if (opcode < 0x4400)
+			{
+				// ALU operations, TST/CMP/CMN only set the flags
+				int op = (opcode >> 6) & 15;
+				if (op != 8 && op != 10 && op != 11)
+					dest = opcode & 7;
+			}
+			else
+			{
+				// hi register ADD/CMP/MOV, no BX and no PC writes
+				int rd = (opcode & 7) | ((opcode >> 4) & 8);
+				if ((opcode & 0xFF00) == 0x4700 || rd == 15)
+					return false;
+				if ((opcode & 0xFF00) != 0x4500)
+					dest = rd;
+			}
+			break;
+		case 0x09: // LDR Rd, [PC, #Imm]
+			dest		= (opcode >> 8) & 7;
+			load.base	= -1;
+			load.offset = ((pc + 4) & 0xFFFFFFFC) + ((opcode & 255) << 2);
+			load.size	= 4;
+			break;
+		case 0x0A:
+		case 0x0B:
+		{
+			// register offset loads
+			static const u32 sizes[8] = { 0, 0, 0, 1, 4, 2, 1, 2 };
+			if (((opcode >> 9) & 7) < 3)
+				return false;
+			dest		= opcode & 7;
+			load.base	= (opcode >> 3) & 7;
+			load.index	= (opcode >> 6) & 7;
+			load.offset = 0;
+			load.size	= sizes[(opcode >> 9) & 7];
+			break;
+		}
+		case 0x0D: // LDR Rd, [Rb, #Imm]
+		case 0x0F: // LDRB Rd, [Rb, #Imm]
+		case 0x11: // LDRH Rd, [Rb, #Imm]
+		{
+			u32 size	= (opcode >> 11) == 0x0D ? 4 : ((opcode >> 11) == 0x0F ? 1 : 2);
+			dest		= opcode & 7;
+			load.base	= (opcode >> 3) & 7;
+			load.offset = ((opcode >> 6) & 31) * size;
+			load.size	= size;
+			break;
+		}
+		case 0x13: // LDR Rd, [SP, #Imm]
+			dest		= (opcode >> 8) & 7;
+			load.base	= 13;
+			load.offset = (opcode & 255) << 2;
+			load.size	= 4;
+			break;
+		case 0x14: // ADD Rd, PC/SP, #Imm
+		case 0x15:
+			dest = (opcode >> 8) & 7;
+			break;
+		case 0x1A: // Bcc, but not SWI
+		case 0x1B:
+		{
+			if ((opcode & 0xFE00) == 0xDE00)
+				return false;
+			u32 target = pc + 4 + ((s32)(s8)(opcode & 0xFF) << 1);
+			if (target < loop->head || target > loop->branch)
+				return false;
+			break;
+		}
+		case 0x1C: // B
+		{
+			u32 target = pc + 4 + ((s32)((opcode & 0x7FF) << 21) >> 20);
+			if (target < loop->head || target > loop->branch)
+				return false;
+			break;
+		}
+		default:
+			return false;
+		}
+
+		if (load.base != -2)
+		{
+			if (loop->numLoads == THUMB_IDLE_LOOP_LOADS)
+				return false;
+			loop->load[loop->numLoads++] = load;
+		}
+		if (dest >= 0)
+			written |= 1 << dest;
+	}
+
+	// the load addresses have to be loop invariant
+	for (int i = 0; i < loop->numLoads; i++)
+	{
+		ThumbIdleLoad &load = loop->load[i];
+		if (load.base >= 0 && (written & (1 << load.base)))
+			return false;
+		if (load.index >= 0 && (written & (1 << load.index)))
+			return false;
+	}
+	return true;
+}
+
+// true if reading the address can't change anything, and can't return
+// something else before the next event
+static bool thumbIdleReadable(u32 address, u32 size)
+{
+	switch (address >> 24)
+	{
+	case 0x04:
+		// the timer counters are computed from cpuTotalTicks, the sound
+		// registers change at the sound ticks, which aren't events
+		address &= 0x3FF;
+		if (address + size > 0x60 && address < 0x90)
+			return false;
+		return address + size <= 0x100 || address >= 0x110;
+	case 0x08:
+		// GPIO/RTC
+		return address + size <= 0x080000C4 || address >= 0x080000CA;
+	case 0x0D: // EEPROM
+	case 0x0E: // SRAM/Flash
+	case 0x0F:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static bool thumbIdleSkip(ThumbIdleLoop *loop)
+{
+	// the loop may have been replaced since it was analyzed
+	for (u32 pc = loop->head; pc <= loop->branch; pc += 2)
+		if (CPUReadHalfWordQuick(pc) != loop->code[(pc - loop->head) >> 1])
+			return false;
+
+	for (int i = 0; i < loop->numLoads; i++)
+	{
+		ThumbIdleLoad &load = loop->load[i];
+		u32 address = load.offset;
+		if (load.base >= 0)
+			address += reg[load.base].I;
+		if (load.index >= 0)
+			address += reg[load.index].I;
+		if (!thumbIdleReadable(address, load.size))
+			return false;
+	}
+	return true;
+}
+
+static void thumbIdleSave(ThumbIdleLoop *loop)
+{
+	thumbIdle.loop = loop;
+	for (int i = 0; i < 16; i++)
+		thumbIdle.reg[i] = reg[i].I;
+	thumbIdle.flags[0]		   = N_FLAG;
+	thumbIdle.flags[1]		   = Z_FLAG;
+	thumbIdle.flags[2]		   = C_FLAG;
+	thumbIdle.flags[3]		   = V_FLAG;
+	thumbIdle.busPrefetch	   = busPrefetch;
+	thumbIdle.busPrefetchCount = busPrefetchCount;
+	thumbIdle.prefetch[0]	   = cpuPrefetch[0];
+	thumbIdle.prefetch[1]	   = cpuPrefetch[1];
+	thumbIdle.ticks			   = cpuTotalTicks;
+}
+
+static bool thumbIdleSame()
+{
+	for (int i = 0; i < 16; i++)
+		if (thumbIdle.reg[i] != reg[i].I)
+			return false;
+	return thumbIdle.flags[0] == N_FLAG && thumbIdle.flags[1] == Z_FLAG &&
+	       thumbIdle.flags[2] == C_FLAG && thumbIdle.flags[3] == V_FLAG &&
+	       thumbIdle.busPrefetch == busPrefetch && thumbIdle.busPrefetchCount == busPrefetchCount &&
+	       thumbIdle.prefetch[0] == cpuPrefetch[0] && thumbIdle.prefetch[1] == cpuPrefetch[1];
+}
+
+// Called after every non sequential instruction, from is the address of
+// the branch and armNextPC its target
+static void thumbIdleBranch(u32 from)
+{
+	u32 to = armNextPC;
+
+	ThumbIdleLoop *loop = thumbIdle.loop;
+	if (loop && from - loop->head <= loop->branch - loop->head && to - loop->head <= loop->branch - loop->head)
+	{
+		// still inside the loop
+		if (from != loop->branch || to != loop->head)
+			return;
+
+		if (thumbIdleSame())
+		{
+			int32 iteration = cpuTotalTicks - thumbIdle.ticks;
+			if (iteration > 0 && cpuTotalTicks < cpuNextEvent && thumbIdleSkip(loop))
+				cpuTotalTicks += ((cpuNextEvent - cpuTotalTicks - 1) / iteration) * iteration;
+		}
+		thumbIdleSave(loop);
+		return;
+	}
+
+	thumbIdle.loop = NULL;
+	if (to >= from || from - to > THUMB_IDLE_LOOP_BYTES)
+		return;
+
+	loop = &thumbIdleCache[(to >> 1) & (THUMB_IDLE_CACHE_SIZE - 1)];
+	if (loop->head != to || loop->branch != from)
+	{
+		loop->head	 = to;
+		loop->branch = from;
+		loop->idle	 = thumbIdleAnalyze(loop);
+	}
+	if (loop->idle)
+		thumbIdleSave(loop);
+}
+
+// Block cache ////////////////////////////////////////////////////////////
+
+#define THUMB_BLOCK_INSNS	   16
+#define THUMB_BLOCK_CACHE_SIZE 2048
+
+struct ThumbBlockInsn
+{
+	insnfunc_t func;
+	u32		   opcode;
+};
+
+struct ThumbBlock
+{
+	u32			   address;
+	u32			   generation;
+	u32			   pageGeneration;
+	int			   count;
+	ThumbBlockInsn insn[THUMB_BLOCK_INSNS];
+};
+
+static INSTANCE_LOCAL ThumbBlock thumbBlockCache[THUMB_BLOCK_CACHE_SIZE];
+
+// true for the opcodes that may leave the straight-line code
+static inline bool thumbEndsBlock(u32 opcode)
+{
+	return (opcode >= 0xD000) ||                 // Bcc, SWI, B, BL
+	       ((opcode & 0xFF00) == 0x4700) ||      // BX
+	       ((opcode & 0xFF00) == 0xBD00) ||      // POP {..., PC}
+	       ((opcode & 0xFC87) == 0x4487);        // ADD/MOV PC, Rs
+}
+
+static ThumbBlock *thumbGetBlock(u32 address)
+{
+	int page = CPUBlockCachePage(address);
+	if (page == CPU_BLOCK_CACHE_UNCACHED)
+		return NULL;
+
+	// the region bits keep IWRAM code from evicting the ROM code it was copied from
+	ThumbBlock *block = &thumbBlockCache[((address >> 1) ^ (address >> 20)) & (THUMB_BLOCK_CACHE_SIZE - 1)];
+	if (block->address == address && block->generation == cpuBlockCacheGeneration &&
+	    (page == CPU_BLOCK_CACHE_ROM || block->pageGeneration == cpuBlockCachePageGen[page]))
+		return block;
+
+	block->address		  = address;
+	block->generation	  = cpuBlockCacheGeneration;
+	block->pageGeneration = 0;
+	if (page != CPU_BLOCK_CACHE_ROM)
+	{
+		block->pageGeneration		= cpuBlockCachePageGen[page];
+		cpuBlockCachePageCode[page] = 1;
+	}
+
+	int count = 0;
+	do
+	{
+		u32 opcode = CPUReadHalfWordQuick(address);
+		block->insn[count].func	  = thumbInsnTable[opcode >> 6];
+		block->insn[count].opcode = opcode;
+		count++;
+		address += 2;
+		if (thumbEndsBlock(opcode))
+			break;
+	}
+	while (count < THUMB_BLOCK_INSNS && (address & 0xFF));
+	block->count = count;
+
+	return block;
+}
+
+// x86-64 recompiler //////////////////////////////////////////////////////
+//
+// Turns a decoded block into host code. Every instruction still performs the
+// same prefetch, bus prefetch and clockTicks bookkeeping as thumbExecute(), so
+// timing is unchanged. The shifts by immediate, ADD/SUB/MOV/CMP, the ALU
+// operations, the high register operations, ADD PC/SP and the B, Bcc and BL
+// prefix instructions are translated inline, together with their code
+// waitstates. Loads and stores compute their address inline and call a helper
+// that does the access and its timing. PUSH/POP, LDM/STM, BX, BL, SWI, MUL,
+// shifts by register and writes to PC call their interpreter handler.
+// The generated code keeps &reg in rbx and addresses the CPU state from it.
+// The recompiler is only used by the loop without per-instruction features.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define THUMB_JIT
+
+#define THUMB_JIT_BUFFER_SIZE (4 * 1024 * 1024)
+#define THUMB_JIT_INSN_MAX	  384
+#define THUMB_JIT_BLOCK_MAX	  (THUMB_BLOCK_INSNS * THUMB_JIT_INSN_MAX + 64)
+
+// host registers
+#define JIT_EAX 0
+#define JIT_ECX 1
+#ifdef _WIN32
+#define JIT_ARG0 1 // ecx
+#define JIT_ARG1 2 // edx
+#else
+#define JIT_ARG0 7 // edi
+#define JIT_ARG1 6 // esi
+#endif
+
+// host condition codes
+#define JIT_CC_O  0x0
+#define JIT_CC_C  0x2
+#define JIT_CC_NC 0x3
+#define JIT_CC_Z  0x4
+#define JIT_CC_NZ 0x5
+#define JIT_CC_BE 0x6
+#define JIT_CC_S  0x8
+#define JIT_CC_GE 0xD
+
+// how an opcode is translated
+enum
+{
+	THUMB_JIT_CALL,   // interpreter handler
+	THUMB_JIT_ALU,    // inline, followed by the sequential code waitstates
+	THUMB_JIT_LOAD,
+	THUMB_JIT_STORE,
+	THUMB_JIT_BRANCH  // B and Bcc
+};
+
+typedef int (*thumbjitfunc_t)();
+
+static INSTANCE_LOCAL u8 *thumbJitBuffer	  = NULL;
+static INSTANCE_LOCAL u32 thumbJitBufferUsed = 0;
+static INSTANCE_LOCAL u32 thumbJitEpoch	  = 1;
+static INSTANCE_LOCAL bool thumbJitFailed	  = false;
+static INSTANCE_LOCAL bool thumbJitFar;      // some state is out of reach of rbx
+static INSTANCE_LOCAL u32 thumbJitInvalidations;
+static INSTANCE_LOCAL u8 *thumbJitPtr;
+
+// Looked up before the block cache, so a block is only decoded again when it
+// has to be recompiled
+#define THUMB_JIT_CACHE_SIZE 16384
+
+struct ThumbJitEntry
+{
+	u32 address;
+	u32 generation;
+	u32 pageGeneration;
+	u32 epoch;
+	u32 opcode[2]; // the prefetch queue the block starts with
+	int count;
+	u8 *code;
+};
+
+static INSTANCE_LOCAL ThumbJitEntry thumbJitCache[THUMB_JIT_CACHE_SIZE];
+
+static bool thumbJitAlloc()
+{
+	if (thumbJitFailed)
+		return false;
+	if (thumbJitBuffer)
+		return true;
+
+#ifdef _WIN32
+	thumbJitBuffer = (u8 *)VirtualAlloc(NULL, THUMB_JIT_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+	void *buffer = mmap(NULL, THUMB_JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANON, -1, 0);
+	thumbJitBuffer = (buffer == MAP_FAILED) ? NULL : (u8 *)buffer;
+#endif
+	if (!thumbJitBuffer)
+	{
+		thumbJitFailed = true;
+		return false;
+	}
+	thumbJitBufferUsed = 0;
+	return true;
+}
+
+static void thumbJitFree()
+{
+	if (thumbJitBuffer)
+	{
+#ifdef _WIN32
+		VirtualFree(thumbJitBuffer, 0, MEM_RELEASE);
+#else
+		munmap(thumbJitBuffer, THUMB_JIT_BUFFER_SIZE);
+#endif
+		thumbJitBuffer = NULL;
+	}
+	thumbJitFailed = false;
+	// the cached blocks still point into the old buffer
+	thumbJitEpoch++;
+}
+
+// Called from the generated code
+
+static inline int thumbJitMustLeave()
+{
+	return thumbJitInvalidations != cpuBlockCacheInvalidations ||
+	       cpuTotalTicks >= cpuNextEvent || armState || holdState || SWITicks;
+}
+
+static void thumbJitPrefetchNext()
+{
+	THUMB_PREFETCH_NEXT;
+}
+
+// ticks of a handler call; returns true when the block has to be left
+static int thumbJitEndInsn(u32 oldArmNextPC)
+{
+	if (clockTicks == 0)
+		clockTicks = codeTicksAccessSeq16(oldArmNextPC) + 1;
+	cpuTotalTicks += clockTicks;
+
+	return armNextPC != oldArmNextPC + 2 || thumbJitMustLeave();
+}
+
+// Same accesses and timing as thumb50 to thumb98. Loads write the value to
+// reg[dest]; both return true when the block has to be left, as a read hook
+// may have written to translated code.
+#define THUMB_JIT_LOAD(NAME, READ, TICKS) \
+    static int NAME(u32 address, int dest) \
+    { \
+		if (busPrefetchCount == 0) \
+			busPrefetch = busPrefetchEnable; \
+		u32 value = READ(address); \
+		reg[dest].I	   = value; \
+		clockTicks	   = 3 + TICKS(address) + codeTicksAccess16(armNextPC); \
+		cpuTotalTicks += clockTicks; \
+		return thumbJitMustLeave(); \
+	}
+
+#define THUMB_JIT_STORE(NAME, WRITE, TYPE, TICKS) \
+    static int NAME(u32 address, u32 value) \
+    { \
+		if (busPrefetchCount == 0) \
+			busPrefetch = busPrefetchEnable; \
+		WRITE(address, (TYPE)value); \
+		clockTicks	   = TICKS(address) + codeTicksAccess16(armNextPC) + 2; \
+		cpuTotalTicks += clockTicks; \
+		return thumbJitMustLeave(); \
+	}
+
+THUMB_JIT_LOAD(thumbJitLdr, CPUReadMemory, dataTicksAccess32)
+THUMB_JIT_LOAD(thumbJitLdrSp, CPUReadMemoryQuick, dataTicksAccess32)
+THUMB_JIT_LOAD(thumbJitLdrhReg, CPUReadHalfWord, dataTicksAccess32)
+THUMB_JIT_LOAD(thumbJitLdrh, CPUReadHalfWord, dataTicksAccess16)
+THUMB_JIT_LOAD(thumbJitLdrb, CPUReadByte, dataTicksAccess16)
+THUMB_JIT_LOAD(thumbJitLdsb, (s8)CPUReadByte, dataTicksAccess16)
+THUMB_JIT_LOAD(thumbJitLdsh, (s16)CPUReadHalfWordSigned, dataTicksAccess16)
+THUMB_JIT_STORE(thumbJitStr, CPUWriteMemory, u32, dataTicksAccess32)
+THUMB_JIT_STORE(thumbJitStrh, CPUWriteHalfWord, u16, dataTicksAccess16)
+THUMB_JIT_STORE(thumbJitStrb, CPUWriteByte, u8, dataTicksAccess16)
+
+// LDR Rd, [PC, #Imm]
+static int thumbJitLdrPc(u32 address, int dest)
+{
+	if (busPrefetchCount == 0)
+		busPrefetch = busPrefetchEnable;
+	reg[dest].I		 = CPUReadMemoryQuick(address);
+	busPrefetchCount = 0;
+	clockTicks		 = 3 + dataTicksAccess32(address) + codeTicksAccess16(armNextPC);
+	cpuTotalTicks	+= clockTicks;
+	return thumbJitMustLeave();
+}
+
+// taken B and Bcc
+static void thumbJitBranch(u32 target)
+{
+	UPDATE_OLDREG;
+	reg[15].I  = target;
+	armNextPC  = reg[15].I;
+	reg[15].I += 2;
+	THUMB_PREFETCH;
+	clockTicks = codeTicksAccessSeq16(armNextPC) + codeTicksAccessSeq16(armNextPC) +
+	             codeTicksAccess16(armNextPC) + 3;
+	busPrefetchCount = 0;
+	cpuTotalTicks	+= clockTicks;
+}
+
+// Code emission
+
+static inline void thumbJitEmit8(u8 b)
+{
+	*thumbJitPtr++ = b;
+}
+
+static inline void thumbJitEmit32(u32 v)
+{
+	thumbJitEmit8(v & 0xFF);
+	thumbJitEmit8((v >> 8) & 0xFF);
+	thumbJitEmit8((v >> 16) & 0xFF);
+	thumbJitEmit8(v >> 24);
+}
+
+// ModRM for [rbx + disp32]
+static void thumbJitMem(int r, const void *p)
+{
+	s64 disp = (const u8 *)p - (const u8 *)reg;
+	if (disp != (s32)disp)
+		thumbJitFar = true;
+	thumbJitEmit8(0x83 | (r << 3));
+	thumbJitEmit32((u32)disp);
+}
+
+// op r, [p]
+static void thumbJitOp(u8 op, int r, const void *p)
+{
+	thumbJitEmit8(op);
+	thumbJitMem(r, p);
+}
+
+// 0F op r, [p]
+static void thumbJitOp0F(u8 op, int r, const void *p)
+{
+	thumbJitEmit8(0x0F);
+	thumbJitOp(op, r, p);
+}
+
+// op rm, r between registers
+static void thumbJitOpReg(u8 op, int rm, int r)
+{
+	thumbJitEmit8(op);
+	thumbJitEmit8(0xC0 | (r << 3) | rm);
+}
+
+// add/or/and/sub/xor/cmp r, imm32 (n is the ModRM /digit)
+static void thumbJitOpImm(int n, int r, u32 imm)
+{
+	thumbJitEmit8(0x81);
+	thumbJitEmit8(0xC0 | (n << 3) | r);
+	thumbJitEmit32(imm);
+}
+
+// mov r, imm32
+static void thumbJitMovImm(int r, u32 imm)
+{
+	thumbJitEmit8(0xB8 + r);
+	thumbJitEmit32(imm);
+}
+
+// mov r, dword [p]
+static void thumbJitLoad(int r, const void *p)
+{
+	thumbJitOp(0x8B, r, p);
+}
+
+// mov dword [p], r
+static void thumbJitStore(int r, const void *p)
+{
+	thumbJitOp(0x89, r, p);
+}
+
+// mov dword [p], imm32
+static void thumbJitStore32(const void *p, u32 v)
+{
+	thumbJitOp(0xC7, 0, p);
+	thumbJitEmit32(v);
+}
+
+// mov byte [p], imm8
+static void thumbJitStore8(const void *p, u8 v)
+{
+	thumbJitOp(0xC6, 0, p);
+	thumbJitEmit8(v);
+}
+
+// cmp byte [p], imm8
+static void thumbJitCmp8(const void *p, u8 v)
+{
+	thumbJitOp(0x80, 7, p);
+	thumbJitEmit8(v);
+}
+
+// setcc byte [p]; leaves the host flags alone
+static void thumbJitSetcc(u8 cc, const void *p)
+{
+	thumbJitOp0F(0x90 | cc, 0, p);
+}
+
+// mov rax, func; call rax
+static void thumbJitCall(const void *func)
+{
+	u64 v = (u64)(size_t)func;
+	thumbJitEmit8(0x48);
+	thumbJitEmit8(0xB8);
+	thumbJitEmit32((u32)v);
+	thumbJitEmit32((u32)(v >> 32));
+	thumbJitEmit8(0xFF);
+	thumbJitEmit8(0xD0);
+}
+
+// jcc rel32 to a later target; returns the offset to patch
+static u8 *thumbJitJcc(u8 cc)
+{
+	thumbJitEmit8(0x0F);
+	thumbJitEmit8(0x80 | cc);
+	thumbJitEmit32(0);
+	return thumbJitPtr - 4;
+}
+
+// jmp rel32 to a later target
+static u8 *thumbJitJmp()
+{
+	thumbJitEmit8(0xE9);
+	thumbJitEmit32(0);
+	return thumbJitPtr - 4;
+}
+
+static void thumbJitPatch(u8 *rel, u8 *target)
+{
+	u32 v = (u32)(target - (rel + 4));
+	rel[0] = v & 0xFF;
+	rel[1] = (v >> 8) & 0xFF;
+	rel[2] = (v >> 16) & 0xFF;
+	rel[3] = v >> 24;
+}
+
+// add rsp, 32; pop rbx; mov eax, result; ret
+static void thumbJitReturn(u32 result)
+{
+	thumbJitEmit8(0x48);
+	thumbJitEmit8(0x83);
+	thumbJitEmit8(0xC4);
+	thumbJitEmit8(0x20);
+	thumbJitEmit8(0x5B);
+	thumbJitMovImm(JIT_EAX, result);
+	thumbJitEmit8(0xC3);
+}
+
+// N and Z from the host flags
+static void thumbJitSetNZ()
+{
+	thumbJitSetcc(JIT_CC_S, &N_FLAG);
+	thumbJitSetcc(JIT_CC_Z, &Z_FLAG);
+}
+
+// N, Z, C and V from the host flags; the ARM carry of a subtraction is the
+// inverted x86 borrow
+static void thumbJitSetNZCV(bool sub)
+{
+	thumbJitSetNZ();
+	thumbJitSetcc(sub ? JIT_CC_NC : JIT_CC_C, &C_FLAG);
+	thumbJitSetcc(JIT_CC_O, &V_FLAG);
+}
+
+// if (busPrefetchCount & 0xFFFFFF00) busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF)
+static void thumbJitPrefetchCount()
+{
+	thumbJitLoad(JIT_ECX, &busPrefetchCount);
+	thumbJitEmit8(0xF7); // test ecx, 0xFFFFFF00
+	thumbJitEmit8(0xC1);
+	thumbJitEmit32(0xFFFFFF00);
+	u8 *skip = thumbJitJcc(JIT_CC_Z);
+	thumbJitOpImm(4, JIT_ECX, 0xFF);
+	thumbJitOpImm(1, JIT_ECX, 0x100);
+	thumbJitStore(JIT_ECX, &busPrefetchCount);
+	thumbJitPatch(skip, thumbJitPtr);
+}
+
+// ecx = codeTicksAccessSeq16(address) + 1
+static void thumbJitSeqTicks(u32 address)
+{
+	int addr = (address >> 24) & 15;
+
+	if ((addr >= 0x08) && (addr <= 0x0D))
+	{
+		thumbJitLoad(JIT_EAX, &busPrefetchCount);
+		thumbJitEmit8(0xA8); // test al, 1
+		thumbJitEmit8(0x01);
+		u8 *noPrefetch = thumbJitJcc(JIT_CC_Z);
+
+		// busPrefetchCount = ((busPrefetchCount & 0xFF) >> 1) | (busPrefetchCount & 0xFFFFFF00)
+		thumbJitOpReg(0x89, JIT_ECX, JIT_EAX); // mov ecx, eax
+		thumbJitOpImm(4, JIT_ECX, 0xFFFFFF00);
+		thumbJitEmit8(0x0F);                   // movzx eax, al
+		thumbJitEmit8(0xB6);
+		thumbJitEmit8(0xC0);
+		thumbJitEmit8(0xD1);                   // shr eax, 1
+		thumbJitEmit8(0xE8);
+		thumbJitOpReg(0x09, JIT_EAX, JIT_ECX); // or eax, ecx
+		thumbJitStore(JIT_EAX, &busPrefetchCount);
+		thumbJitOpReg(0x31, JIT_ECX, JIT_ECX); // xor ecx, ecx
+		u8 *done = thumbJitJmp();
+
+		thumbJitPatch(noPrefetch, thumbJitPtr);
+		thumbJitOpImm(7, JIT_EAX, 0xFF);
+		u8 *seq = thumbJitJcc(JIT_CC_BE);
+		thumbJitStore32(&busPrefetchCount, 0);
+		thumbJitOp0F(0xB6, JIT_ECX, &memoryWait[addr]);
+		u8 *nonSeqDone = thumbJitJmp();
+
+		thumbJitPatch(seq, thumbJitPtr);
+		thumbJitOp0F(0xB6, JIT_ECX, &memoryWaitSeq[addr]);
+
+		thumbJitPatch(done, thumbJitPtr);
+		thumbJitPatch(nonSeqDone, thumbJitPtr);
+	}
+	else
+	{
+		thumbJitStore32(&busPrefetchCount, 0);
+		thumbJitOp0F(0xB6, JIT_ECX, &memoryWaitSeq[addr]);
+	}
+
+	thumbJitEmit8(0xFF); // inc ecx
+	thumbJitEmit8(0xC1);
+}
+
+// clockTicks = ecx; cpuTotalTicks += ecx; jumps to the returned offset on
+// the next event
+static u8 *thumbJitAddTicks(bool last)
+{
+	thumbJitStore(JIT_ECX, &clockTicks);
+	thumbJitOp(0x01, JIT_ECX, &cpuTotalTicks);
+	if (last)
+		return NULL;
+
+	thumbJitLoad(JIT_EAX, &cpuTotalTicks);
+	thumbJitOp(0x3B, JIT_EAX, &cpuNextEvent);
+	return thumbJitJcc(JIT_CC_GE);
+}
+
+static int thumbJitKind(u32 opcode)
+{
+	switch (opcode >> 12)
+	{
+	case 0x0:
+	case 0x1:
+	case 0x2:
+	case 0x3:
+	case 0xA:
+		return THUMB_JIT_ALU;
+	case 0x4:
+		if (opcode < 0x4400)
+		{
+			// shifts by register and MUL have their own timing
+			switch ((opcode >> 6) & 15)
+			{
+			case 0x2:
+			case 0x3:
+			case 0x4:
+			case 0x7:
+			case 0xD:
+				return THUMB_JIT_CALL;
+			}
+			return THUMB_JIT_ALU;
+		}
+		if (opcode < 0x4800)
+		{
+			int op = (opcode >> 8) & 3;
+			if (op == 3)
+				return THUMB_JIT_CALL;                  // BX
+			if (op != 2 && !(opcode & 0xC0))
+				return THUMB_JIT_CALL;                  // undefined
+			if (op != 1 && (opcode & 0x87) == 0x87)
+				return THUMB_JIT_CALL;                  // ADD/MOV PC, Rs
+			return THUMB_JIT_ALU;
+		}
+		return THUMB_JIT_LOAD;
+	case 0x5:
+		return ((opcode >> 9) & 7) < 3 ? THUMB_JIT_STORE : THUMB_JIT_LOAD;
+	case 0x6:
+	case 0x7:
+	case 0x8:
+	case 0x9:
+		return (opcode & 0x0800) ? THUMB_JIT_LOAD : THUMB_JIT_STORE;
+	case 0xB:
+		return (opcode & 0xFF00) == 0xB000 ? THUMB_JIT_ALU : THUMB_JIT_CALL;
+	case 0xD:
+		return ((opcode >> 8) & 15) < 14 ? THUMB_JIT_BRANCH : THUMB_JIT_CALL;
+	case 0xE:
+		return (opcode & 0x0800) ? THUMB_JIT_CALL : THUMB_JIT_BRANCH;
+	case 0xF:
+		return (opcode & 0x0800) ? THUMB_JIT_CALL : THUMB_JIT_ALU;
+	default:
+		return THUMB_JIT_CALL;
+	}
+}
+
+// LSL/LSR/ASR Rd, Rs, #Imm5
+static void thumbJitShift(u32 opcode)
+{
+	u32 *dest  = &reg[opcode & 7].I;
+	int	 shift = (opcode >> 6) & 31;
+	int	 type  = opcode >> 11;
+
+	thumbJitLoad(JIT_EAX, &reg[(opcode >> 3) & 7].I);
+	if (shift)
+	{
+		static const int digit[3] = { 4, 5, 7 }; // shl, shr, sar
+		thumbJitEmit8(0xC1);
+		thumbJitEmit8(0xC0 | (digit[type] << 3));
+		thumbJitEmit8(shift);
+		thumbJitSetcc(JIT_CC_C, &C_FLAG);
+		thumbJitSetNZ();
+		thumbJitStore(JIT_EAX, dest);
+	}
+	else if (type == 0)
+	{
+		// LSL #0 keeps C
+		thumbJitOpReg(0x85, JIT_EAX, JIT_EAX);
+		thumbJitSetNZ();
+		thumbJitStore(JIT_EAX, dest);
+	}
+	else if (type == 1)
+	{
+		// LSR #32
+		thumbJitEmit8(0x0F); // bt eax, 31
+		thumbJitEmit8(0xBA);
+		thumbJitEmit8(0xE0);
+		thumbJitEmit8(31);
+		thumbJitSetcc(JIT_CC_C, &C_FLAG);
+		thumbJitStore32(dest, 0);
+		thumbJitStore8(&N_FLAG, 0);
+		thumbJitStore8(&Z_FLAG, 1);
+	}
+	else
+	{
+		// ASR #32
+		thumbJitEmit8(0xC1); // sar eax, 31
+		thumbJitEmit8(0xF8);
+		thumbJitEmit8(31);
+		thumbJitOpReg(0x85, JIT_EAX, JIT_EAX);
+		thumbJitSetcc(JIT_CC_NZ, &C_FLAG);
+		thumbJitSetNZ();
+		thumbJitStore(JIT_EAX, dest);
+	}
+}
+
+// AND, EOR, ADC, SBC, TST, NEG, CMP, CMN, ORR, BIC and MVN Rd, Rs
+static void thumbJitAluOp(u32 opcode)
+{
+	u32 *dest	= &reg[opcode & 7].I;
+	u32 *source = &reg[(opcode >> 3) & 7].I;
+
+	switch ((opcode >> 6) & 15)
+	{
+	case 0x0: // AND
+	case 0x8: // TST
+		thumbJitLoad(JIT_EAX, dest);
+		thumbJitOp(0x23, JIT_EAX, source);
+		thumbJitSetNZ();
+		if (!(opcode & 0x0200))
+			thumbJitStore(JIT_EAX, dest);
+		break;
+	case 0x1: // EOR
+	case 0xC: // ORR
+		thumbJitLoad(JIT_EAX, dest);
+		thumbJitOp((opcode & 0x0200) ? 0x0B : 0x33, JIT_EAX, source);
+		thumbJitSetNZ();
+		thumbJitStore(JIT_EAX, dest);
+		break;
+	case 0x5: // ADC
+		thumbJitLoad(JIT_EAX, dest);
+		thumbJitCmp8(&C_FLAG, 1);
+		thumbJitEmit8(0xF5); // cmc
+		thumbJitOp(0x13, JIT_EAX, source);
+		thumbJitSetNZCV(false);
+		thumbJitStore(JIT_EAX, dest);
+		break;
+	case 0x6: // SBC
+		thumbJitLoad(JIT_EAX, dest);
+		thumbJitCmp8(&C_FLAG, 1);
+		thumbJitOp(0x1B, JIT_EAX, source);
+		thumbJitSetNZCV(true);
+		thumbJitStore(JIT_EAX, dest);
+		break;
+	case 0x9: // NEG
+		thumbJitLoad(JIT_EAX, source);
+		thumbJitEmit8(0xF7); // neg eax
+		thumbJitEmit8(0xD8);
+		thumbJitSetNZCV(true);
+		thumbJitStore(JIT_EAX, dest);
+		break;
+	case 0xA: // CMP
+		thumbJitLoad(JIT_EAX, dest);
+		thumbJitOp(0x3B, JIT_EAX, source);
+		thumbJitSetNZCV(true);
+		break;
+	case 0xB: // CMN
+		thumbJitLoad(JIT_EAX, dest);
+		thumbJitOp(0x03, JIT_EAX, source);
+		thumbJitSetNZCV(false);
+		break;
+	case 0xE: // BIC
+		thumbJitLoad(JIT_ECX, source);
+		thumbJitEmit8(0xF7); // not ecx
+		thumbJitEmit8(0xD1);
+		thumbJitLoad(JIT_EAX, dest);
+		thumbJitOpReg(0x21, JIT_EAX, JIT_ECX); // and eax, ecx
+		thumbJitSetNZ();
+		thumbJitStore(JIT_EAX, dest);
+		break;
+	case 0xF: // MVN
+		thumbJitLoad(JIT_EAX, source);
+		thumbJitEmit8(0xF7); // not eax
+		thumbJitEmit8(0xD0);
+		thumbJitOpReg(0x85, JIT_EAX, JIT_EAX);
+		thumbJitSetNZ();
+		thumbJitStore(JIT_EAX, dest);
+		break;
+	}
+}
+
+// Instructions of kind THUMB_JIT_ALU; pc is the address of the opcode
+static void thumbJitAlu(u32 opcode, u32 pc)
+{
+	if (opcode < 0x1800)
+	{
+		thumbJitShift(opcode);
+	}
+	else if (opcode < 0x2000)
+	{
+		// ADD/SUB Rd, Rs, Rn and ADD/SUB Rd, Rs, #Offset3
+		bool sub = (opcode & 0x0200) != 0;
+		int	 rn	 = (opcode >> 6) & 7;
+		thumbJitLoad(JIT_EAX, &reg[(opcode >> 3) & 7].I);
+		if (opcode & 0x0400)
+			thumbJitOpImm(sub ? 5 : 0, JIT_EAX, rn);
+		else
+			thumbJitOp(sub ? 0x2B : 0x03, JIT_EAX, &reg[rn].I);
+		thumbJitSetNZCV(sub);
+		thumbJitStore(JIT_EAX, &reg[opcode & 7].I);
+	}
+	else if (opcode < 0x4000)
+	{
+		// MOV/CMP/ADD/SUB Rd, #Offset8
+		u32 *dest = &reg[(opcode >> 8) & 7].I;
+		u32	 imm  = opcode & 0xFF;
+		int	 op	  = (opcode >> 11) & 3;
+		if (op == 0)
+		{
+			thumbJitStore32(dest, imm);
+			thumbJitStore8(&N_FLAG, 0);
+			thumbJitStore8(&Z_FLAG, imm ? 0 : 1);
+			return;
+		}
+
+		static const int digit[4] = { 0, 7, 0, 5 }; // -, cmp, add, sub
+		thumbJitLoad(JIT_EAX, dest);
+		thumbJitOpImm(digit[op], JIT_EAX, imm);
+		thumbJitSetNZCV(op != 2);
+		if (op != 1)
+			thumbJitStore(JIT_EAX, dest);
+	}
+	else if (opcode < 0x4400)
+	{
+		thumbJitAluOp(opcode);
+	}
+	else if (opcode < 0x4800)
+	{
+		// ADD, CMP and MOV with high registers; PC reads as pc + 4
+		u32 *dest	= &reg[(opcode & 7) | ((opcode >> 4) & 8)].I;
+		u32 *source = &reg[(opcode >> 3) & 15].I;
+		switch ((opcode >> 8) & 3)
+		{
+		case 0:
+			thumbJitLoad(JIT_EAX, source);
+			thumbJitOp(0x01, JIT_EAX, dest); // add [dest], eax
+			break;
+		case 1:
+			thumbJitLoad(JIT_EAX, dest);
+			thumbJitOp(0x3B, JIT_EAX, source);
+			thumbJitSetNZCV(true);
+			break;
+		default:
+			thumbJitLoad(JIT_EAX, source);
+			thumbJitStore(JIT_EAX, dest);
+			break;
+		}
+	}
+	else if (opcode < 0xA800)
+	{
+		// ADD Rd, PC, #Imm
+		thumbJitStore32(&reg[(opcode >> 8) & 7].I, ((pc + 4) & 0xFFFFFFFC) + ((opcode & 255) << 2));
+	}
+	else if (opcode < 0xB000)
+	{
+		// ADD Rd, SP, #Imm
+		thumbJitLoad(JIT_EAX, &reg[13].I);
+		thumbJitOpImm(0, JIT_EAX, (opcode & 255) << 2);
+		thumbJitStore(JIT_EAX, &reg[(opcode >> 8) & 7].I);
+	}
+	else if (opcode < 0xF000)
+	{
+		// ADD SP, #Imm
+		int offset = (opcode & 127) << 2;
+		if (opcode & 0x80)
+			offset = -offset;
+		thumbJitOp(0x81, 0, &reg[13].I);
+		thumbJitEmit32((u32)offset);
+	}
+	else
+	{
+		// BLL #offset
+		int offset = (opcode & 0x7FF);
+		if (opcode & 0x0400)
+			thumbJitStore32(&reg[14].I, pc + 4 + ((offset << 12) | 0xFF800000));
+		else
+			thumbJitStore32(&reg[14].I, pc + 4 + (offset << 12));
+	}
+}
+
+// Instructions of kind THUMB_JIT_LOAD and THUMB_JIT_STORE
+static void thumbJitMemory(u32 opcode, u32 pc, bool store)
+{
+	const void *func;
+	int			dest = opcode & 7;
+
+	if (opcode < 0x5000)
+	{
+		// LDR Rd, [PC, #Imm]
+		dest = (opcode >> 8) & 7;
+		thumbJitMovImm(JIT_ARG0, ((pc + 4) & 0xFFFFFFFC) + ((opcode & 0xFF) << 2));
+		func = (const void *)thumbJitLdrPc;
+	}
+	else if (opcode < 0x6000)
+	{
+		// [Rs, Rn]
+		static const void *const funcs[8] =
+		{
+			(const void *)thumbJitStr,	   (const void *)thumbJitStrh,
+			(const void *)thumbJitStrb,	   (const void *)thumbJitLdsb,
+			(const void *)thumbJitLdr,	   (const void *)thumbJitLdrhReg,
+			(const void *)thumbJitLdrb,	   (const void *)thumbJitLdsh
+		};
+		thumbJitLoad(JIT_ARG0, &reg[(opcode >> 3) & 7].I);
+		thumbJitOp(0x03, JIT_ARG0, &reg[(opcode >> 6) & 7].I);
+		func = funcs[(opcode >> 9) & 7];
+	}
+	else if (opcode < 0x9000)
+	{
+		// [Rs, #Imm], the offset is scaled by the access size
+		static const void *const funcs[3][2] =
+		{
+			{ (const void *)thumbJitStr,  (const void *)thumbJitLdr  },
+			{ (const void *)thumbJitStrb, (const void *)thumbJitLdrb },
+			{ (const void *)thumbJitStrh, (const void *)thumbJitLdrh }
+		};
+		static const int shift[3] = { 2, 0, 1 };
+		int				 size	  = (opcode >> 12) - 6;
+		u32				 offset	  = ((opcode >> 6) & 31) << shift[size];
+		thumbJitLoad(JIT_ARG0, &reg[(opcode >> 3) & 7].I);
+		if (offset)
+			thumbJitOpImm(0, JIT_ARG0, offset);
+		func = funcs[size][store ? 0 : 1];
+	}
+	else
+	{
+		// [SP, #Imm]
+		dest = (opcode >> 8) & 7;
+		thumbJitLoad(JIT_ARG0, &reg[13].I);
+		thumbJitOpImm(0, JIT_ARG0, (opcode & 255) << 2);
+		func = store ? (const void *)thumbJitStr : (const void *)thumbJitLdrSp;
+	}
+
+	if (store)
+		thumbJitLoad(JIT_ARG1, &reg[dest].I);
+	else
+		thumbJitMovImm(JIT_ARG1, dest);
+	thumbJitCall(func);
+}
+
+// Bcc: jumps to the returned offsets when the condition fails
+static int thumbJitCondition(int cond, u8 **fail)
+{
+	bool8 *flag = cond < 2 ? &Z_FLAG : cond < 4 ? &C_FLAG : cond < 6 ? &N_FLAG : &V_FLAG;
+	u8	  *taken;
+
+	switch (cond)
+	{
+	case 8:  // HI: C && !Z
+		thumbJitCmp8(&C_FLAG, 0);
+		fail[0] = thumbJitJcc(JIT_CC_Z);
+		thumbJitCmp8(&Z_FLAG, 0);
+		fail[1] = thumbJitJcc(JIT_CC_NZ);
+		return 2;
+	case 9:  // LS: !C || Z
+		thumbJitCmp8(&C_FLAG, 0);
+		taken = thumbJitJcc(JIT_CC_Z);
+		thumbJitCmp8(&Z_FLAG, 0);
+		fail[0] = thumbJitJcc(JIT_CC_Z);
+		thumbJitPatch(taken, thumbJitPtr);
+		return 1;
+	case 10: // GE: N == V
+	case 11: // LT: N != V
+		thumbJitOp0F(0xB6, JIT_EAX, &N_FLAG);
+		thumbJitOp(0x3A, JIT_EAX, &V_FLAG); // cmp al, [V_FLAG]
+		fail[0] = thumbJitJcc(cond == 10 ? JIT_CC_NZ : JIT_CC_Z);
+		return 1;
+	case 12: // GT: !Z && N == V
+		thumbJitCmp8(&Z_FLAG, 0);
+		fail[0] = thumbJitJcc(JIT_CC_NZ);
+		thumbJitOp0F(0xB6, JIT_EAX, &N_FLAG);
+		thumbJitOp(0x3A, JIT_EAX, &V_FLAG);
+		fail[1] = thumbJitJcc(JIT_CC_NZ);
+		return 2;
+	case 13: // LE: Z || N != V
+		thumbJitCmp8(&Z_FLAG, 0);
+		taken = thumbJitJcc(JIT_CC_NZ);
+		thumbJitOp0F(0xB6, JIT_EAX, &N_FLAG);
+		thumbJitOp(0x3A, JIT_EAX, &V_FLAG);
+		fail[0] = thumbJitJcc(JIT_CC_Z);
+		thumbJitPatch(taken, thumbJitPtr);
+		return 1;
+	default: // EQ/NE, CS/CC, MI/PL, VS/VC
+		thumbJitCmp8(flag, 0);
+		fail[0] = thumbJitJcc((cond & 1) ? JIT_CC_NZ : JIT_CC_Z);
+		return 1;
+	}
+}
+
+static u8 *thumbJitCompile(ThumbBlock *block)
+{
+	if (thumbJitBufferUsed + THUMB_JIT_BLOCK_MAX > THUMB_JIT_BUFFER_SIZE)
+	{
+		// out of space: throw away all the generated code
+		thumbJitBufferUsed = 0;
+		thumbJitEpoch++;
+	}
+
+	u8 *code = thumbJitBuffer + thumbJitBufferUsed;
+	thumbJitPtr = code;
+	thumbJitFar = false;
+
+	u8 *exits[THUMB_BLOCK_INSNS];
+	u8 *stops[THUMB_BLOCK_INSNS];
+	int numExits = 0;
+	int numStops = 0;
+
+	// push rbx; sub rsp, 32 (keeps the stack aligned, with room for the Win64
+	// shadow space); mov rbx, &reg
+	thumbJitEmit8(0x53);
+	thumbJitEmit8(0x48);
+	thumbJitEmit8(0x83);
+	thumbJitEmit8(0xEC);
+	thumbJitEmit8(0x20);
+	thumbJitEmit8(0x48);
+	thumbJitEmit8(0xBB);
+	u64 base = (u64)(size_t)reg;
+	thumbJitEmit32((u32)base);
+	thumbJitEmit32((u32)(base >> 32));
+
+	for (int i = 0; i < block->count; i++)
+	{
+		u32	 pc		= block->address + (i << 1);
+		u32	 opcode = block->insn[i].opcode;
+		bool last	= (i + 1 == block->count);
+		int	 kind	= thumbJitKind(opcode);
+		int	 page	= (pc >> 24) & 15;
+
+		// cpuPrefetch[0] = cpuPrefetch[1], which still holds the next opcode
+		if (!last)
+			thumbJitStore32(&cpuPrefetch[0], block->insn[i + 1].opcode);
+		else
+		{
+			thumbJitLoad(JIT_EAX, &cpuPrefetch[1]);
+			thumbJitStore(JIT_EAX, &cpuPrefetch[0]);
+		}
+
+		thumbJitStore8(&busPrefetch, 0);
+		// codeTicksAccessSeq16() clears the count outside of the cartridge space
+		if (kind != THUMB_JIT_ALU || (page >= 0x08 && page <= 0x0D))
+			thumbJitPrefetchCount();
+
+		thumbJitStore32(&armNextPC, pc + 2);
+		thumbJitStore32(&reg[15].I, pc + 4);
+		if (i + 2 < block->count)
+			thumbJitStore32(&cpuPrefetch[1], block->insn[i + 2].opcode);
+		else
+			thumbJitCall((const void *)thumbJitPrefetchNext);
+
+		switch (kind)
+		{
+		case THUMB_JIT_ALU:
+		{
+			thumbJitAlu(opcode, pc);
+			// BLL is timed at armNextPC
+			thumbJitSeqTicks(opcode >= 0xF000 ? pc + 2 : pc);
+			u8 *exit = thumbJitAddTicks(last);
+			if (exit)
+				exits[numExits++] = exit;
+			break;
+		}
+		case THUMB_JIT_LOAD:
+		case THUMB_JIT_STORE:
+			thumbJitMemory(opcode, pc, kind == THUMB_JIT_STORE);
+			if (!last)
+			{
+				thumbJitOpReg(0x85, JIT_EAX, JIT_EAX);
+				exits[numExits++] = thumbJitJcc(JIT_CC_NZ);
+			}
+			break;
+		case THUMB_JIT_BRANCH:
+		{
+			// always the last instruction of the block
+			u8 *fail[2];
+			int numFails = 0;
+			u32 target;
+			if (opcode < 0xE000)
+			{
+				numFails = thumbJitCondition((opcode >> 8) & 15, fail);
+				target	 = pc + 4 + ((s8)(opcode & 0xFF)) * 2;
+			}
+			else
+			{
+				int offset = (opcode & 0x3FF) << 1;
+				if (opcode & 0x0400)
+					offset |= 0xFFFFF800;
+				target = pc + 4 + offset;
+			}
+
+			thumbJitMovImm(JIT_ARG0, target);
+			thumbJitCall((const void *)thumbJitBranch);
+			if (numFails)
+			{
+				thumbJitReturn(1);
+				for (int j = 0; j < numFails; j++)
+					thumbJitPatch(fail[j], thumbJitPtr);
+				thumbJitSeqTicks(pc);
+				thumbJitAddTicks(true);
+			}
+			break;
+		}
+		default:
+		{
+			thumbJitStore32(&clockTicks, 0);
+			thumbJitMovImm(JIT_ARG0, opcode);
+			thumbJitCall((const void *)block->insn[i].func);
+
+			// if (clockTicks < 0) return 0
+			thumbJitLoad(JIT_ECX, &clockTicks);
+			thumbJitOpReg(0x85, JIT_ECX, JIT_ECX);
+			stops[numStops++] = thumbJitJcc(JIT_CC_S);
+
+			thumbJitMovImm(JIT_ARG0, pc);
+			thumbJitCall((const void *)thumbJitEndInsn);
+			if (!last)
+			{
+				thumbJitOpReg(0x85, JIT_EAX, JIT_EAX);
+				exits[numExits++] = thumbJitJcc(JIT_CC_NZ);
+			}
+			break;
+		}
+		}
+	}
+
+	for (int i = 0; i < numExits; i++)
+		thumbJitPatch(exits[i], thumbJitPtr);
+	thumbJitReturn(1);
+	for (int i = 0; i < numStops; i++)
+		thumbJitPatch(stops[i], thumbJitPtr);
+	thumbJitReturn(0);
+
+	if (thumbJitFar)
+	{
+		// the displacements don't fit, leave the blocks to the interpreter
+		thumbJitFailed = true;
+		return NULL;
+	}
+
+	thumbJitBufferUsed += (u32)(thumbJitPtr - code);
+	return code;
+}
+
+// Runs the block at armNextPC if it matches the prefetch queue; returns -1
+// when it can't
+static int thumbJitRun()
+{
+	u32 address = armNextPC;
+	int page	= CPUBlockCachePage(address);
+	if (page == CPU_BLOCK_CACHE_UNCACHED || !thumbJitAlloc())
+		return -1;
+
+	u32			   pageGeneration = (page == CPU_BLOCK_CACHE_ROM) ? 0 : cpuBlockCachePageGen[page];
+	ThumbJitEntry *entry		  = &thumbJitCache[((address >> 1) ^ (address >> 20)) & (THUMB_JIT_CACHE_SIZE - 1)];
+	if (entry->address != address || entry->epoch != thumbJitEpoch || entry->generation != cpuBlockCacheGeneration ||
+	    entry->pageGeneration != pageGeneration)
+	{
+		ThumbBlock *block = thumbGetBlock(address);
+
+		// compiling may start a new epoch
+		u8 *code = thumbJitCompile(block);
+		if (!code)
+			return -1;
+		entry->address		  = address;
+		entry->generation	  = block->generation;
+		entry->pageGeneration = block->pageGeneration;
+		entry->epoch		  = thumbJitEpoch;
+		entry->opcode[0]	  = block->insn[0].opcode;
+		entry->opcode[1]	  = block->insn[1].opcode;
+		entry->count		  = block->count;
+		entry->code			  = code;
+	}
+
+	if (entry->opcode[0] != cpuPrefetch[0] || (entry->count > 1 && entry->opcode[1] != cpuPrefetch[1]))
+		return -1;
+
+	thumbJitInvalidations = cpuBlockCacheInvalidations;
+	return ((thumbjitfunc_t)entry->code)();
+}
+#endif
+
+// Same as thumbExecuteLoop(), but fetches and decodes from the block cache.
+// The prefetch queue is still maintained, so both loops can be mixed freely.
+template <int features>
+static int thumbExecuteCached()
+{
+	do
+	{
+#ifdef THUMB_JIT
+		if (features == 0 && cpuThumbJitEnabled)
+		{
+			int result = thumbJitRun();
+			if (result == 0)
+				return 0;
+			if (result > 0)
+				continue;
+		}
+#endif
+
+		ThumbBlock *block = thumbGetBlock(armNextPC);
+		int			count = 0;
+		if (block && block->insn[0].opcode == cpuPrefetch[0] &&
+		    (block->count == 1 || block->insn[1].opcode == cpuPrefetch[1]))
+			count = block->count;
+
+		if (!count)
+		{
+			// not cacheable or modified since it was prefetched
+			if (features & CPU_FEATURE_CHEATS)
+				CPUMasterCodeCheck();
+
+			u32 opcode = cpuPrefetch[0];
+			cpuPrefetch[0] = cpuPrefetch[1];
+
+			busPrefetch = false;
+			if (busPrefetchCount & 0xFFFFFF00)
+				busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF);
+
+			clockTicks = 0;
+			u32 oldArmNextPC = armNextPC;
+
+			if (features & CPU_FEATURE_EXEC_HOOK)
+			{
+#ifndef FINAL_VERSION
+				if (armNextPC == armStopAddr)
+				{
+					armNextPC++;
+				}
+#endif
+
+				CallRegisteredLuaMemHook(armNextPC, 2, CPUReadHalfWordQuick(armNextPC), LUAMEMHOOK_EXEC);
+			}
+
+			armNextPC  = reg[15].I;
+			reg[15].I += 2;
+			THUMB_PREFETCH_NEXT;
+
+			(*thumbInsnTable[opcode >> 6])(opcode);
+
+			if (clockTicks < 0)
+				return 0;
+			if (clockTicks == 0)
+				clockTicks = codeTicksAccessSeq16(oldArmNextPC) + 1;
+			cpuTotalTicks += clockTicks;
+
+			if ((features & CPU_FEATURE_IDLE_LOOP) && armNextPC != oldArmNextPC + 2)
+				thumbIdleBranch(oldArmNextPC);
+			continue;
+		}
+
+		u32 invalidations = cpuBlockCacheInvalidations;
+		for (int i = 0; i < count; i++)
+		{
+			if (features & CPU_FEATURE_CHEATS)
+				CPUMasterCodeCheck();
+
+			u32 opcode = block->insn[i].opcode;
+			cpuPrefetch[0] = cpuPrefetch[1];
+
+			busPrefetch = false;
+			if (busPrefetchCount & 0xFFFFFF00)
+				busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF);
+
+			clockTicks = 0;
+			u32 oldArmNextPC = armNextPC;
+
+			if (features & CPU_FEATURE_EXEC_HOOK)
+			{
+#ifndef FINAL_VERSION
+				if (armNextPC == armStopAddr)
+				{
+					armNextPC++;
+				}
+#endif
+
+				CallRegisteredLuaMemHook(armNextPC, 2, opcode, LUAMEMHOOK_EXEC);
+			}
+
+			armNextPC  = reg[15].I;
+			reg[15].I += 2;
+			if (i + 2 < count)
+				cpuPrefetch[1] = block->insn[i + 2].opcode;
+			else
+				THUMB_PREFETCH_NEXT;
+
+			(*block->insn[i].func)(opcode);
+
+			if (clockTicks < 0)
+				return 0;
+			if (clockTicks == 0)
+				clockTicks = codeTicksAccessSeq16(oldArmNextPC) + 1;
+			cpuTotalTicks += clockTicks;
+
+			if ((features & CPU_FEATURE_IDLE_LOOP) && armNextPC != oldArmNextPC + 2)
+				thumbIdleBranch(oldArmNextPC);
+
+			// leave the block on jumps, mode changes, events and code writes
+			if (armNextPC != oldArmNextPC + 2 || invalidations != cpuBlockCacheInvalidations ||
+			    cpuTotalTicks >= cpuNextEvent || armState || holdState || SWITicks)
+				break;
+		}
+	}
+	while (cpuTotalTicks < cpuNextEvent && !armState && !holdState && !SWITicks);
+
+	return 1;
+}
+
 // Wrapper routine (execution loop) ///////////////////////////////////////
 
-int thumbExecute()
+// features is a mask of CPU_FEATURE_*; every combination gets its own copy
+// of the loop so that unused features cost nothing per instruction
+template <int features>
+static int thumbExecuteLoop()
 {
 	do
 	{
-		CPUMasterCodeCheck();
+		if (features & CPU_FEATURE_CHEATS)
+			CPUMasterCodeCheck();
 
 		//if ((armNextPC & 0x0803FFFF) == 0x08020000)
 		//    busPrefetchCount=0x100;
@@ -2344,14 +3867,17 @@ int thumbExecute()
 		clockTicks = 0;
 		u32 oldArmNextPC = armNextPC;
 
-#ifndef FINAL_VERSION
-		if (armNextPC == armStopAddr)
+		if (features & CPU_FEATURE_EXEC_HOOK)
 		{
-			armNextPC++;
-		}
+#ifndef FINAL_VERSION
+			if (armNextPC == armStopAddr)
+			{
+				armNextPC++;
+			}
 #endif
 
-		CallRegisteredLuaMemHook(armNextPC, 2, CPUReadHalfWordQuick(armNextPC), LUAMEMHOOK_EXEC);
+			CallRegisteredLuaMemHook(armNextPC, 2, CPUReadHalfWordQuick(armNextPC), LUAMEMHOOK_EXEC);
+		}
 
 		armNextPC  = reg[15].I;
 		reg[15].I += 2;
@@ -2364,9 +3890,53 @@ int thumbExecute()
 		if (clockTicks == 0)
 			clockTicks = codeTicksAccessSeq16(oldArmNextPC) + 1;
 		cpuTotalTicks += clockTicks;
+
+		if ((features & CPU_FEATURE_IDLE_LOOP) && armNextPC != oldArmNextPC + 2)
+			thumbIdleBranch(oldArmNextPC);
 	}
 	while (cpuTotalTicks < cpuNextEvent && !armState && !holdState && !SWITicks);
 
 	return 1;
 }
 
+static int (*const thumbExecuteLoops[CPU_FEATURE_MASK + 1])() =
+{
+	thumbExecuteLoop<0>,
+	thumbExecuteLoop<1>,
+	thumbExecuteLoop<2>,
+	thumbExecuteLoop<3>,
+	thumbExecuteLoop<4>,
+	thumbExecuteLoop<5>,
+	thumbExecuteLoop<6>,
+	thumbExecuteLoop<7>,
+};
+
+static int (*const thumbExecuteCachedLoops[CPU_FEATURE_MASK + 1])() =
+{
+	thumbExecuteCached<0>,
+	thumbExecuteCached<1>,
+	thumbExecuteCached<2>,
+	thumbExecuteCached<3>,
+	thumbExecuteCached<4>,
+	thumbExecuteCached<5>,
+	thumbExecuteCached<6>,
+	thumbExecuteCached<7>,
+};
+
+int thumbExecute()
+{
+	// anything may have happened since the last run
+	thumbIdle.loop = NULL;
+
+	if (cpuBlockCacheEnabled || cpuThumbJitEnabled)
+		return thumbExecuteCachedLoops[CPUExecFeatures()]();
+
+	return thumbExecuteLoops[CPUExecFeatures()]();
+}
+
+void thumbCleanUp()
+{
+#ifdef THUMB_JIT
+	thumbJitFree();
+#endif
+}
@@ -2,6 +2,11 @@
 #include <cstdlib>
 #include <cstdarg>
 #include <cstring>
+#ifdef MULTI_INSTANCE
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 
 #include "../../Port.h"
 #include "../../NLS.h"
@@ -22,6 +27,7 @@
 #include "../../common/System.h"
 #include "../../common/SystemGlobals.h"
 #include "../../common/Util.h"
+#include "../../common/ColorConvert.h"
 #include "../../common/movie.h"
 #include "../../common/vbalua.h"
 
@@ -36,97 +42,122 @@
 static inline void interp_rate()
 { /* empty for now */ }
 
-int32 SWITicks = 0;
-int32 IRQTicks = 0;
-
-u32	  mastercode = 0;
-int32 layerEnableDelay	= 0;
-
-bool8 busPrefetch		= false;
-bool8 busPrefetchEnable	= false;
-u32	  busPrefetchCount	= 0;
-u32	  cpuPrefetch[2];
-
-int32 cpuDmaTicksToUpdate = 0;
-int32 cpuDmaCount		  = 0;
-bool8 cpuDmaHack		  = 0;
-u32	  cpuDmaLast		  = 0;
-int32 dummyAddress		  = 0;
-
-int32 gbaSaveType = 0;      // used to remember the save type on reset
-bool8 intState	  = false;
-bool8 stopState	  = false;
-bool8 holdState	  = false;
-int32 holdType	  = 0;
-bool8 cpuSramEnabled		 = true;
-bool8 cpuFlashEnabled		 = true;
-bool8 cpuEEPROMEnabled		 = true;
-bool8 cpuEEPROMSensorEnabled = false;
+INSTANCE_LOCAL int32 SWITicks = 0;
+INSTANCE_LOCAL int32 IRQTicks = 0;
+
+INSTANCE_LOCAL u32	  mastercode = 0;
+INSTANCE_LOCAL int32 layerEnableDelay	= 0;
+
+INSTANCE_LOCAL bool8 busPrefetch		= false;
+INSTANCE_LOCAL bool8 busPrefetchEnable	= false;
+INSTANCE_LOCAL u32	  busPrefetchCount	= 0;
+INSTANCE_LOCAL u32	  cpuPrefetch[2];
+
+INSTANCE_LOCAL u32 cpuBlockCacheGeneration	   = 1;
+INSTANCE_LOCAL u32 cpuBlockCacheInvalidations = 0;
+INSTANCE_LOCAL u8	cpuBlockCachePageCode[CPU_BLOCK_CACHE_PAGES];
+INSTANCE_LOCAL u32 cpuBlockCachePageGen[CPU_BLOCK_CACHE_PAGES];
+
+INSTANCE_LOCAL u8			cpuDirtyPages[CPU_DIRTY_PAGES];
+INSTANCE_LOCAL u8			cpuVideoDirtyPages[CPU_DIRTY_PAGES - CPU_DIRTY_PALETTE_RAM];
+INSTANCE_LOCAL bool8		cpuVideoDirty = false;
+static INSTANCE_LOCAL char *cpuDirtyBase = NULL; // buffer of the last uncompressed state
+
+#ifdef MULTI_INSTANCE
+struct CPURenderThread;
+static INSTANCE_LOCAL CPURenderThread *cpuRenderThread		= NULL;
+static INSTANCE_LOCAL int32			   cpuRenderClearLayers = 0; // line buffers cleared since the last line
+static void CPURenderThreadSync();
+static void CPURenderThreadStop();
+#endif
+
+INSTANCE_LOCAL u32		   cpuEventClock = 0;
+INSTANCE_LOCAL u32		   cpuEventWhen[CPU_EVENT_COUNT];
+static INSTANCE_LOCAL u8  cpuEventHeap[CPU_EVENT_COUNT];
+static INSTANCE_LOCAL u8  cpuEventSlot[CPU_EVENT_COUNT];
+static INSTANCE_LOCAL int cpuEventCount = 0;
+static INSTANCE_LOCAL u32 cpuSoundWhen	= 0; // deadline of the next sound tick
+
+INSTANCE_LOCAL int32 cpuDmaTicksToUpdate = 0;
+INSTANCE_LOCAL int32 cpuDmaCount		  = 0;
+INSTANCE_LOCAL bool8 cpuDmaHack		  = 0;
+INSTANCE_LOCAL u32	  cpuDmaLast		  = 0;
+INSTANCE_LOCAL int32 dummyAddress		  = 0;
+
+INSTANCE_LOCAL int32 gbaSaveType = 0;      // used to remember the save type on reset
+INSTANCE_LOCAL bool8 intState	  = false;
+INSTANCE_LOCAL bool8 stopState	  = false;
+INSTANCE_LOCAL bool8 holdState	  = false;
+INSTANCE_LOCAL int32 holdType	  = 0;
+INSTANCE_LOCAL bool8 cpuSramEnabled		 = true;
+INSTANCE_LOCAL bool8 cpuFlashEnabled		 = true;
+INSTANCE_LOCAL bool8 cpuEEPROMEnabled		 = true;
+INSTANCE_LOCAL bool8 cpuEEPROMSensorEnabled = false;
 
 #ifdef SDL
-bool8 cpuBreakLoop = false;
+INSTANCE_LOCAL bool8 cpuBreakLoop = false;
 #endif
 
 // These don't seem to affect determinism
-int32 cpuNextEvent = 0;
-int32 cpuTotalTicks = 0;
+INSTANCE_LOCAL int32 cpuNextEvent = 0;
+INSTANCE_LOCAL int32 cpuTotalTicks = 0;
 
 #ifdef PROFILING
-int profilingTicks		 = 0;
-int profilingTicksReload = 0;
-static profile_segment *profilSegment = NULL;
+INSTANCE_LOCAL int profilingTicks		 = 0;
+INSTANCE_LOCAL int profilingTicksReload = 0;
+static INSTANCE_LOCAL profile_segment *profilSegment = NULL;
 #endif
 
 #ifdef BKPT_SUPPORT
-u8	 freezeWorkRAM[0x40000];
-u8	 freezeInternalRAM[0x8000];
-u8	 freezeVRAM[0x18000];
-u8	 freezePRAM[0x400];
-u8	 freezeOAM[0x400];
-bool debugger_last;
+INSTANCE_LOCAL u8	 freezeWorkRAM[0x40000];
+INSTANCE_LOCAL u8	 freezeInternalRAM[0x8000];
+INSTANCE_LOCAL u8	 freezeVRAM[0x18000];
+INSTANCE_LOCAL u8	 freezePRAM[0x400];
+INSTANCE_LOCAL u8	 freezeOAM[0x400];
+INSTANCE_LOCAL bool debugger_last;
 #endif
 
-int32 lcdTicks = (useBios && !skipBios) ? 1008 : 208;
-u8	  timerOnOffDelay	= 0;
-u16	  timer0Value		= 0;
-bool8 timer0On			= false;
-int32 timer0Ticks		= 0;
-int32 timer0Reload		= 0;
-int32 timer0ClockReload = 0;
-u16	  timer1Value		= 0;
-bool8 timer1On			= false;
-int32 timer1Ticks		= 0;
-int32 timer1Reload		= 0;
-int32 timer1ClockReload = 0;
-u16	  timer2Value		= 0;
-bool8 timer2On			= false;
-int32 timer2Ticks		= 0;
-int32 timer2Reload		= 0;
-int32 timer2ClockReload = 0;
-u16	  timer3Value		= 0;
-bool8 timer3On			= false;
-int32 timer3Ticks		= 0;
-int32 timer3Reload		= 0;
-int32 timer3ClockReload = 0;
-u32	  dma0Source		= 0;
-u32	  dma0Dest			= 0;
-u32	  dma1Source		= 0;
-u32	  dma1Dest			= 0;
-u32	  dma2Source		= 0;
-u32	  dma2Dest			= 0;
-u32	  dma3Source		= 0;
-u32	  dma3Dest			= 0;
-void  (*cpuSaveGameFunc)(u32, u8) = flashSaveDecide;
-void  (*renderLine)() = mode0RenderLine;
-bool8 fxOn			 = false;
-bool8 windowOn		 = false;
-
-char  buffer[1024];
-FILE *out = NULL;
+INSTANCE_LOCAL int32 lcdTicks = (useBios && !skipBios) ? 1008 : 208;
+INSTANCE_LOCAL u8	  timerOnOffDelay	= 0;
+INSTANCE_LOCAL u16	  timer0Value		= 0;
+INSTANCE_LOCAL bool8 timer0On			= false;
+INSTANCE_LOCAL int32 timer0Ticks		= 0;
+INSTANCE_LOCAL int32 timer0Reload		= 0;
+INSTANCE_LOCAL int32 timer0ClockReload = 0;
+INSTANCE_LOCAL u16	  timer1Value		= 0;
+INSTANCE_LOCAL bool8 timer1On			= false;
+INSTANCE_LOCAL int32 timer1Ticks		= 0;
+INSTANCE_LOCAL int32 timer1Reload		= 0;
+INSTANCE_LOCAL int32 timer1ClockReload = 0;
+INSTANCE_LOCAL u16	  timer2Value		= 0;
+INSTANCE_LOCAL bool8 timer2On			= false;
+INSTANCE_LOCAL int32 timer2Ticks		= 0;
+INSTANCE_LOCAL int32 timer2Reload		= 0;
+INSTANCE_LOCAL int32 timer2ClockReload = 0;
+INSTANCE_LOCAL u16	  timer3Value		= 0;
+INSTANCE_LOCAL bool8 timer3On			= false;
+INSTANCE_LOCAL int32 timer3Ticks		= 0;
+INSTANCE_LOCAL int32 timer3Reload		= 0;
+INSTANCE_LOCAL int32 timer3ClockReload = 0;
+INSTANCE_LOCAL u32	  dma0Source		= 0;
+INSTANCE_LOCAL u32	  dma0Dest			= 0;
+INSTANCE_LOCAL u32	  dma1Source		= 0;
+INSTANCE_LOCAL u32	  dma1Dest			= 0;
+INSTANCE_LOCAL u32	  dma2Source		= 0;
+INSTANCE_LOCAL u32	  dma2Dest			= 0;
+INSTANCE_LOCAL u32	  dma3Source		= 0;
+INSTANCE_LOCAL u32	  dma3Dest			= 0;
+INSTANCE_LOCAL void  (*cpuSaveGameFunc)(u32, u8) = flashSaveDecide;
+INSTANCE_LOCAL void  (*renderLine)() = mode0RenderLine;
+INSTANCE_LOCAL bool8 fxOn			 = false;
+INSTANCE_LOCAL bool8 windowOn		 = false;
+
+INSTANCE_LOCAL char  buffer[1024];
+INSTANCE_LOCAL FILE *out = NULL;
 
 const int32 TIMER_TICKS[4] = { 0, 6, 8, 10 };
 
-extern bool8 cpuIsMultiBoot;
+extern INSTANCE_LOCAL bool8 cpuIsMultiBoot;
 extern const u32 objTilesAddress[3] = { 0x010000, 0x014000, 0x014000 };
 
 const u8	gamepakRamWaitState[4] = { 4, 3, 2, 8 };
@@ -138,13 +169,13 @@ const bool8 isInRom[16] =
 { false, false,	 false, false, false, false, false,	 false,
   true,	 true,	 true,	true,  true,  true,	 false,	 false };
 
-u8 memoryWait[16] =
+INSTANCE_LOCAL u8 memoryWait[16] =
 { 0, 0, 2, 0, 0, 0, 0, 0, 4, 4, 4, 4, 4, 4, 4, 0 };
-u8 memoryWait32[16] =
+INSTANCE_LOCAL u8 memoryWait32[16] =
 { 0, 0, 5, 0, 0, 1, 1, 0, 7, 7, 9, 9, 13, 13, 4, 0 };
-u8 memoryWaitSeq[16] =
+INSTANCE_LOCAL u8 memoryWaitSeq[16] =
 { 0, 0, 2, 0, 0, 0, 0, 0, 2, 2, 4, 4, 8, 8, 4, 0 };
-u8 memoryWaitSeq32[16] =
+INSTANCE_LOCAL u8 memoryWaitSeq32[16] =
 { 0, 0, 5, 0, 0, 1, 1, 0, 5, 5, 9, 9, 17, 17, 4, 0 };
 
 // The videoMemoryWait constants are used to add some waitstates
@@ -154,15 +185,15 @@ u8 memoryWaitSeq32[16] =
 //const u8 videoMemoryWait[16] =
 //  {0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
-static int32 romSize = 0x2000000;
+static INSTANCE_LOCAL int32 romSize = 0x2000000;
 
-u8 biosProtected[4];
+INSTANCE_LOCAL u8 biosProtected[4];
 
-u8 cpuBitsSet[256];
-u8 cpuLowestBitSet[256];
+INSTANCE_LOCAL u8 cpuBitsSet[256];
+INSTANCE_LOCAL u8 cpuLowestBitSet[256];
 
 #ifdef WORDS_BIGENDIAN
-bool8 cpuBiosSwapped = false;
+INSTANCE_LOCAL bool8 cpuBiosSwapped = false;
 #endif
 
 u32 myROM[] = {
@@ -341,7 +372,7 @@ u32 myROM[] = {
 	0x03007FE0
 };
 
-variable_desc saveGameStruct[] = {
+INSTANCE_LOCAL variable_desc saveGameStruct[] = {
 	{ &DISPCNT,			  sizeof(u16) },
 	{ &DISPSTAT,		  sizeof(u16) },
 	{ &VCOUNT,			  sizeof(u16) },
@@ -478,29 +509,150 @@ void cpuEnableProfiling(int hz)
 
 #endif
 
-inline int CPUUpdateTicks()
+/////////////////////////////////////////////
+// Event scheduler
+// The scheduled events are kept in a binary min-heap ordered by deadline,
+// events due on the same tick being ordered by type.
+
+#define CPU_EVENT_NONE 0xFF
+
+static inline bool CPUEventBefore(int a, int b)
 {
-	int cpuLoopTicks = lcdTicks;
+	int32 diff = (int32)(cpuEventWhen[a] - cpuEventWhen[b]);
+	return diff < 0 || (diff == 0 && a < b);
+}
+
+static void CPUEventSiftUp(int slot)
+{
+	int type = cpuEventHeap[slot];
+	while (slot > 0)
+	{
+		int parent = (slot - 1) >> 1;
+		if (!CPUEventBefore(type, cpuEventHeap[parent]))
+			break;
+		cpuEventHeap[slot] = cpuEventHeap[parent];
+		cpuEventSlot[cpuEventHeap[slot]] = slot;
+		slot = parent;
+	}
+	cpuEventHeap[slot] = type;
+	cpuEventSlot[type] = slot;
+}
+
+static void CPUEventSiftDown(int slot)
+{
+	int type = cpuEventHeap[slot];
+	for (;;)
+	{
+		int child = slot * 2 + 1;
+		if (child >= cpuEventCount)
+			break;
+		if (child + 1 < cpuEventCount && CPUEventBefore(cpuEventHeap[child + 1], cpuEventHeap[child]))
+			child++;
+		if (!CPUEventBefore(cpuEventHeap[child], type))
+			break;
+		cpuEventHeap[slot] = cpuEventHeap[child];
+		cpuEventSlot[cpuEventHeap[slot]] = slot;
+		slot = child;
+	}
+	cpuEventHeap[slot] = type;
+	cpuEventSlot[type] = slot;
+}
 
-	if (soundTicks < cpuLoopTicks)
-		cpuLoopTicks = soundTicks;
+static inline bool CPUEventScheduled(int type)
+{
+	return cpuEventSlot[type] != CPU_EVENT_NONE;
+}
 
-	if (timer0On && (timer0Ticks < cpuLoopTicks))
+// schedules the event in ticks counted from the last event boundary
+static void CPUEventSchedule(int type, int32 ticks)
+{
+	cpuEventWhen[type] = cpuEventClock + ticks;
+	if (!CPUEventScheduled(type))
 	{
-		cpuLoopTicks = timer0Ticks;
+		cpuEventHeap[cpuEventCount] = type;
+		CPUEventSiftUp(cpuEventCount++);
 	}
-	if (timer1On && !(TM1CNT & 4) && (timer1Ticks < cpuLoopTicks))
+	else
 	{
-		cpuLoopTicks = timer1Ticks;
+		CPUEventSiftUp(cpuEventSlot[type]);
+		CPUEventSiftDown(cpuEventSlot[type]);
 	}
-	if (timer2On && !(TM2CNT & 4) && (timer2Ticks < cpuLoopTicks))
+}
+
+// next occurrence of a periodic event, counted from its previous deadline
+static inline void CPUEventRepeat(int type, int32 period)
+{
+	CPUEventSchedule(type, CPUEventTicks(type) + period);
+}
+
+static void CPUEventCancel(int type)
+{
+	int slot = cpuEventSlot[type];
+	if (slot == CPU_EVENT_NONE)
+		return;
+	cpuEventSlot[type] = CPU_EVENT_NONE;
+	if (slot != --cpuEventCount)
 	{
-		cpuLoopTicks = timer2Ticks;
+		int last = cpuEventHeap[cpuEventCount];
+		cpuEventHeap[slot] = last;
+		CPUEventSiftUp(slot);
+		CPUEventSiftDown(cpuEventSlot[last]);
 	}
-	if (timer3On && !(TM3CNT & 4) && (timer3Ticks < cpuLoopTicks))
+}
+
+// A timer has an event only while it counts on its own; a stopped or count-up
+// timer keeps its remaining ticks in the timerXTicks variable.
+static void CPUTimerSchedule(int type, bool running, int32 &ticks)
+{
+	if (running && !CPUEventScheduled(type))
+		CPUEventSchedule(type, ticks);
+	else if (!running && CPUEventScheduled(type))
 	{
-		cpuLoopTicks = timer3Ticks;
+		ticks = CPUEventTicks(type);
+		CPUEventCancel(type);
 	}
+}
+
+static void CPUTimerUpdateSchedule()
+{
+	CPUTimerSchedule(CPU_EVENT_TIMER0, timer0On != 0, timer0Ticks);
+	CPUTimerSchedule(CPU_EVENT_TIMER1, timer1On && !(TM1CNT & 4), timer1Ticks);
+	CPUTimerSchedule(CPU_EVENT_TIMER2, timer2On && !(TM2CNT & 4), timer2Ticks);
+	CPUTimerSchedule(CPU_EVENT_TIMER3, timer3On && !(TM3CNT & 4), timer3Ticks);
+}
+
+// rebuilds the schedule from lcdTicks, soundTicks and timerXTicks
+static void CPUEventReset()
+{
+	cpuEventClock = 0;
+	cpuEventCount = 0;
+	memset(cpuEventSlot, CPU_EVENT_NONE, sizeof(cpuEventSlot));
+
+	CPUEventSchedule(CPU_EVENT_LCD, lcdTicks);
+	cpuSoundWhen = soundTicks;
+	CPUTimerUpdateSchedule();
+}
+
+// copies the pending ticks back into the variables of the save states; the
+// sound ticks due must have been counted
+static void CPUEventSaveTicks()
+{
+	lcdTicks   = CPUEventTicks(CPU_EVENT_LCD);
+	soundTicks = (int32)(cpuSoundWhen - cpuEventClock);
+	if (CPUEventScheduled(CPU_EVENT_TIMER0))
+		timer0Ticks = CPUEventTicks(CPU_EVENT_TIMER0);
+	if (CPUEventScheduled(CPU_EVENT_TIMER1))
+		timer1Ticks = CPUEventTicks(CPU_EVENT_TIMER1);
+	if (CPUEventScheduled(CPU_EVENT_TIMER2))
+		timer2Ticks = CPUEventTicks(CPU_EVENT_TIMER2);
+	if (CPUEventScheduled(CPU_EVENT_TIMER3))
+		timer3Ticks = CPUEventTicks(CPU_EVENT_TIMER3);
+}
+
+inline int CPUUpdateTicks()
+{
+	int cpuLoopTicks = CPUEventTicks(cpuEventHeap[0]);
+
 #ifdef PROFILING
 	if (profilingTicksReload != 0)
 	{
@@ -578,6 +730,10 @@ void CPUUpdateWindow1()
 
 void CPUUpdateRenderBuffers(bool force)
 {
+#ifdef MULTI_INSTANCE
+	if (cpuRenderThread)
+		cpuRenderClearLayers |= force ? 0x0F00 : (~layerEnable & 0x0F00);
+#endif
 	if (!(layerEnable & 0x0100) || force)
 	{
 		CLEAR_ARRAY(line0);
@@ -600,6 +756,12 @@ void CPUUpdateRenderBuffers(bool force)
 
 bool CPUWriteStateToStream(gzFile gzFile)
 {
+#ifdef MULTI_INSTANCE
+	CPURenderThreadSync();
+#endif
+	soundFlush();
+	CPUEventSaveTicks();
+
 	utilWriteInt(gzFile, SAVE_GAME_VERSION);
 	utilGzWrite(gzFile, &rom[0xa0], 16);
 	utilWriteInt(gzFile, useBios);
@@ -611,11 +773,13 @@ bool CPUWriteStateToStream(gzFile gzFile)
 	// new to version 0.8
 	utilWriteInt(gzFile, intState);
 
-	utilGzWrite(gzFile, internalRAM, 0x8000);
-	utilGzWrite(gzFile, paletteRAM, 0x400);
-	utilGzWrite(gzFile, workRAM, 0x40000);
-	utilGzWrite(gzFile, vram, 0x20000);
-	utilGzWrite(gzFile, oam, 0x400);
+	// everything before the memory has a fixed size, so that an incremental
+	// state finds the pages at the same place as in the previous one
+	utilGzWritePages(gzFile, internalRAM, 0x8000, &cpuDirtyPages[CPU_BLOCK_CACHE_IWRAM_BASE]);
+	utilGzWritePages(gzFile, paletteRAM, 0x400, &cpuDirtyPages[CPU_DIRTY_PALETTE_RAM]);
+	utilGzWritePages(gzFile, workRAM, 0x40000, &cpuDirtyPages[0]);
+	utilGzWritePages(gzFile, vram, 0x20000, &cpuDirtyPages[CPU_DIRTY_VRAM]);
+	utilGzWritePages(gzFile, oam, 0x400, &cpuDirtyPages[CPU_DIRTY_OAM]);
 	utilGzWrite(gzFile, pix, 4 * 241 * 162);
 	utilGzWrite(gzFile, ioMem, 0x400);
 
@@ -716,8 +880,44 @@ bool CPUWriteMemState(char *memory, int available)
 	return res;
 }
 
+static int CPUWriteMemStateRawStream(gzFile gzFile, char *memory)
+{
+	bool res  = CPUWriteStateToStream(gzFile);
+	int	 size = utilGzTell(gzFile);
+
+	if (utilGzClose(gzFile) != Z_OK)
+		res = false;
+
+	// the buffer holds every page now, only the next writes matter
+	memset(cpuDirtyPages, 0, sizeof(cpuDirtyPages));
+	cpuDirtyBase = res ? memory : NULL;
+
+	return res ? size : 0;
+}
+
+// Uncompressed memory states, for tools saving and loading states at a high
+// rate; returns the size of the state, or 0 if it didn't fit
+int CPUWriteMemStateRaw(char *memory, int available)
+{
+	return CPUWriteMemStateRawStream(utilMemRawOpen(memory, available), memory);
+}
+
+// Same as CPUWriteMemStateRaw, but when the buffer still holds the state the
+// previous call of either function wrote, only the memory pages written since
+// then are copied
+int CPUWriteMemStateIncremental(char *memory, int available)
+{
+	if (memory != cpuDirtyBase)
+		return CPUWriteMemStateRaw(memory, available);
+
+	return CPUWriteMemStateRawStream(utilMemRawReopen(memory, available), memory);
+}
+
 bool CPUReadStateFromStream(gzFile gzFile)
 {
+#ifdef MULTI_INSTANCE
+	CPURenderThreadSync();
+#endif
 	char tempBackupName[128];
 	if (tempSaveSafe)
 	{
@@ -848,9 +1048,14 @@ bool CPUReadStateFromStream(gzFile gzFile)
 		interp_rate();
 	}
 
+	CPUEventReset();
+	CPUDirtyAll();
+
 	// set pointers!
 	layerEnable = layerSettings & DISPCNT;
 
+	CPUBlockCacheFlush();
+
 	CPUUpdateRender();
 	CPUUpdateRenderBuffers(true);
 	CPUUpdateWindow0();
@@ -1020,6 +1225,20 @@ bool CPUReadMemState(char *memory, int available)
 	return res;
 }
 
+bool CPUReadMemStateRaw(char *memory, int size)
+{
+	gzFile gzFile = utilMemRawOpen(memory, size);
+
+	tempSaveSafe = false;
+	bool res = CPUReadStateFromStream(gzFile);
+	tempSaveSafe = true;
+
+	if (utilGzClose(gzFile) != Z_OK)
+		res = false;
+
+	return res;
+}
+
 bool CPUReadState(const char *file)
 {
 	gzFile gzFile = utilGzOpen(file, "rb");
@@ -1386,16 +1605,26 @@ bool CPUReadBatteryFile(const char *fileName)
 
 bool CPUWritePNGFile(const char *fileName)
 {
+#ifdef MULTI_INSTANCE
+	CPURenderThreadSync();
+#endif
 	return utilWritePNGFile(fileName, 240, 160, pix);
 }
 
 bool CPUWriteBMPFile(const char *fileName)
 {
+#ifdef MULTI_INSTANCE
+	CPURenderThreadSync();
+#endif
 	return utilWriteBMPFile(fileName, 240, 160, pix);
 }
 
 void CPUCleanUp()
 {
+#ifdef MULTI_INSTANCE
+	CPURenderThreadStop();
+#endif
+
 #ifdef PROFILING
 	if (profilingTicksReload)
 	{
@@ -1430,6 +1659,9 @@ void CPUCleanUp()
 	free(ioMem);
 	ioMem = NULL;
 
+	gfxTileCacheCleanUp();
+	thumbCleanUp();
+
 #if 0
 	eepromErase();
 	flashErase();
@@ -1569,6 +1801,13 @@ int CPULoadRom(const char *szFile)
 		CPUCleanUp();
 		return 0;
 	}
+	if (!gfxTileCacheInit())
+	{
+		systemMessage(MSG_OUT_OF_MEMORY, N_("Failed to allocate memory for %s"),
+		              "tile cache");
+		CPUCleanUp();
+		return 0;
+	}
 
 	flashInit();
 	eepromInit();
@@ -1577,6 +1816,9 @@ int CPULoadRom(const char *szFile)
 
 	romSize = size;
 
+	CPUBlockCacheFlush();
+	CPUDirtyAll();
+
 	return size;
 }
 
@@ -1594,6 +1836,7 @@ void CPUDoMirroring(bool b)
 			memcpy((u16 *)(rom + mirroredRomAddress), (u16 *)(rom), mirroredRomSize);
 			mirroredRomAddress += mirroredRomSize;
 		}
+		CPUBlockCacheFlush();
 	}
 }
 
@@ -1613,6 +1856,109 @@ void CPUMasterCodeCheck()
 	}
 }
 
+int CPUExecFeatures()
+{
+	int features = 0;
+	if (cheatsEnabled && mastercode)
+		features |= CPU_FEATURE_CHEATS;
+	if (VBALuaHasMemHook(LUAMEMHOOK_EXEC))
+		features |= CPU_FEATURE_EXEC_HOOK;
+	// skipping an idle loop would hide the reads it polls from a read hook
+	if (cpuIdleLoopSkip && !features && !VBALuaHasMemHook(LUAMEMHOOK_READ))
+		features |= CPU_FEATURE_IDLE_LOOP;
+	return features;
+}
+
+// The features changed while running: end the current run of instructions so
+// that the next one picks the matching loop
+void CPUExecFeaturesChanged()
+{
+	cpuNextEvent = cpuTotalTicks;
+}
+
+void CPUBlockCacheInvalidatePage(int page)
+{
+	cpuBlockCachePageCode[page] = 0;
+	cpuBlockCachePageGen[page]++;
+	cpuBlockCacheInvalidations++;
+}
+
+// Throws away every decoded block; needed whenever memory is changed without
+// going through the CPUWrite* functions (loading ROMs or states, Lua, tools)
+void CPUBlockCacheFlush()
+{
+	memset(cpuBlockCachePageCode, 0, sizeof(cpuBlockCachePageCode));
+	cpuBlockCacheGeneration++;
+	cpuBlockCacheInvalidations++;
+}
+
+void CPUBlockCacheInvalidate(u32 address, u32 size)
+{
+	int first = CPUBlockCachePage(address);
+	int last  = CPUBlockCachePage(address + size - 1);
+
+	if (first == CPU_BLOCK_CACHE_ROM || last == CPU_BLOCK_CACHE_ROM)
+	{
+		CPUBlockCacheFlush();
+		return;
+	}
+	if (first >= 0 && last >= first && (address >> 24) == ((address + size - 1) >> 24))
+	{
+		for (int page = first; page <= last; page++)
+			CPUBlockCacheWrite(page);
+		return;
+	}
+	if (first >= 0)
+		CPUBlockCacheWrite(first);
+	if (last >= 0 && last != first)
+		CPUBlockCacheWrite(last);
+}
+
+void CPUDirtyAll()
+{
+	memset(cpuDirtyPages, 1, sizeof(cpuDirtyPages));
+	memset(cpuVideoDirtyPages, 1, sizeof(cpuVideoDirtyPages));
+	cpuVideoDirty = true;
+}
+
+static int CPUDirtyPage(u32 address)
+{
+	switch (address >> 24)
+	{
+	case 0x02:
+	case 0x03:
+		return CPUBlockCachePage(address);
+	case 0x05:
+		return CPU_DIRTY_PALETTE_RAM + ((address & 0x3FF) >> 8);
+	case 0x06:
+		address &= 0x1FFFF;
+		if ((address & 0x18000) == 0x18000)
+			address &= 0x17FFF;
+		return CPU_DIRTY_VRAM + (address >> 8);
+	case 0x07:
+		return CPU_DIRTY_OAM + ((address & 0x3FF) >> 8);
+	default:
+		return -1;
+	}
+}
+
+// Memory was changed without going through the CPUWrite* functions (Lua,
+// debuggers, BIOS emulation)
+void CPUExternalWrite(u32 address, u32 size)
+{
+	CPUBlockCacheInvalidate(address, size);
+
+	u32 end = address + size;
+	for (u32 page = address & ~0xFF; page < end; page += 0x100)
+	{
+		int dirty = CPUDirtyPage(page);
+		if (dirty >= CPU_DIRTY_PALETTE_RAM)
+			CPUDirtyVideoWrite(dirty);
+		else if (dirty >= 0)
+			CPUDirtyWrite(dirty);
+	}
+}
+
 void CPUUpdateRender()
 {
 	switch (DISPCNT & 7)
@@ -1981,6 +2327,7 @@ void CPUSoftwareInterrupt(int comment)
 			    VCOUNT);
 		}
 #endif
+		soundCatchUp();
 		holdState	 = true;
 		holdType	 = -1;
 		stopState	 = true;
@@ -2233,6 +2580,115 @@ void CPUCompareVCOUNT()
 	}
 }
 
+// Returns the host memory behind [address, address + size) if the whole range
+// lies in one plain RAM/ROM region that the CPUWrite*/CPURead* functions would
+// access without any side effect, NULL otherwise.
+static u8 *CPUDmaBulkPointer(u32 address, u32 size, bool write)
+{
+	u32 offset;
+	switch (address >> 24)
+	{
+	case 0x02:
+		offset = address & 0x3FFFF;
+		return offset + size <= 0x40000 ? &workRAM[offset] : NULL;
+	case 0x03:
+		offset = address & 0x7FFF;
+		return offset + size <= 0x8000 ? &internalRAM[offset] : NULL;
+	case 0x05:
+		offset = address & 0x3FF;
+		return offset + size <= 0x400 ? &paletteRAM[offset] : NULL;
+	case 0x06:
+		// the last 32K are mirrored and partly unwritable in bitmap modes
+		offset = address & 0x1FFFF;
+		return offset + size <= 0x18000 ? &vram[offset] : NULL;
+	case 0x07:
+		offset = address & 0x3FF;
+		return offset + size <= 0x400 ? &oam[offset] : NULL;
+	case 0x08:
+	case 0x09:
+	case 0x0A:
+	case 0x0B:
+		if (write)
+			return NULL;
+		offset = address & 0x1FFFFFF;
+		return offset + size <= 0x2000000 ? &rom[offset] : NULL;
+	case 0x0C:
+		// 0x0D000000 up is the EEPROM window
+		if (write)
+			return NULL;
+		offset = address & 0xFFFFFF;
+		return offset + size <= 0x1000000 ? &rom[offset] : NULL;
+	default:
+		return NULL;
+	}
+}
+
+// Block copy for the incrementing (or fixed source) transfers between plain
+// memory regions, which would otherwise decode every unit's address twice.
+// Returns false, leaving s and d alone, if the transfer needs the unit loop.
+static bool CPUDmaBulkTransfer(u32 &s, u32 &d, u32 si, u32 di, u32 c, u32 unit)
+{
+#if defined(BKPT_SUPPORT) && defined(SDL)
+	// frozen addresses are written through the cheat functions
+	return false;
+#else
+	if (c == 0 || di != unit || (si != unit && si != 0))
+		return false;
+	if (VBALuaHasMemHook(LUAMEMHOOK_READ) || VBALuaHasMemHook(LUAMEMHOOK_WRITE))
+		return false;
+
+	u32 dest	 = d & ~(unit - 1);
+	u32 size	 = c * unit;
+	u32 fromSize = si ? size : unit;
+
+	// halfword reads of these ROM addresses go to the RTC
+	if (unit == 2 && s < 0x80000ca && s + fromSize > 0x80000c4)
+		return false;
+
+	u8 *from = CPUDmaBulkPointer(s, fromSize, false);
+	u8 *to	 = CPUDmaBulkPointer(dest, size, true);
+	if (from == NULL || to == NULL)
+		return false;
+
+	// the unit loop would propagate data forward through overlapping ranges
+	if (from < to + size && to < from + fromSize)
+		return false;
+
+	if (si)
+	{
+		memcpy(to, from, size);
+	}
+	else if (unit == 4)
+	{
+		u32 value = READ32LE((u32 *)from);
+		for (u32 i = 0; i < size; i += 4)
+			WRITE32LE((u32 *)&to[i], value);
+	}
+	else
+	{
+		u16 value = READ16LE((u16 *)from);
+		for (u32 i = 0; i < size; i += 2)
+			WRITE16LE((u16 *)&to[i], value);
+	}
+
+	if (unit == 4)
+	{
+		cpuDmaLast = READ32LE((u32 *)&from[fromSize - 4]);
+	}
+	else
+	{
+		cpuDmaLast	= READ16LE((u16 *)&from[fromSize - 2]);
+		cpuDmaLast |= (cpuDmaLast << 16);
+	}
+
+	CPUExternalWrite(dest, size);
+
+	s += si * c;
+	d += di * c;
+	return true;
+#endif
+}
+
 static void doDMA(u32 &s, u32 &d, u32 si, u32 di, u32 c, int transfer32)
 {
 	int sm = s >> 24;
@@ -2263,7 +2719,7 @@ static void doDMA(u32 &s, u32 &d, u32 si, u32 di, u32 c, int transfer32)
 				c--;
 			}
 		}
-		else
+		else if (!CPUDmaBulkTransfer(s, d, si, di, c, 4))
 		{
 			while (c != 0)
 			{
@@ -2289,7 +2745,7 @@ static void doDMA(u32 &s, u32 &d, u32 si, u32 di, u32 c, int transfer32)
 				c--;
 			}
 		}
-		else
+		else if (!CPUDmaBulkTransfer(s, d, si, di, c, 2))
 		{
 			while (c != 0)
 			{
@@ -2653,7 +3109,7 @@ void CPUUpdateRegister(u32 address, u16 value)
 		{
 			if (!(DISPSTAT & 1))
 			{
-				lcdTicks = 1008;
+				CPUEventSchedule(CPU_EVENT_LCD, 1008);
 				//      VCOUNT = 0;
 				//      UPDATE_REG(0x06, VCOUNT);
 				DISPSTAT &= 0xFFFC;
@@ -3213,6 +3669,7 @@ void applyTimer()
 		TM3CNT	 = timer3Value & 0xC7;
 		UPDATE_REG(0x10E, TM3CNT);
 	}
+	CPUTimerUpdateSchedule();
 	cpuNextEvent	= CPUUpdateTicks();
 	timerOnOffDelay = 0;
 }
@@ -3305,6 +3762,9 @@ void CPUInit()
 
 void CPUReset()
 {
+#ifdef MULTI_INSTANCE
+	CPURenderThreadSync();
+#endif
 	systemReset();
 
 	if (gbaSaveType == 0)
@@ -3615,7 +4075,11 @@ void CPUReset()
 	SWITicks = 0;
 	IRQTicks = 0;
 
+	CPUBlockCacheFlush();
+
 	soundReset();
+	CPUEventReset();
+	CPUDirtyAll();
 	systemRefreshScreen();
 }
 
@@ -3649,105 +4113,296 @@ static inline void CPUDrawPixLine()
 	case 16:
 	{
 		u16 *dest = (u16 *)pix + 241 * (VCOUNT + 1);
-		for (int x = 0; x < 240; )
-		{
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap16[lineMix[x++] & 0xFFFF];
-		}
+		colorConvertLine16(dest, lineMix, 240);
 		// for filters that read past the screen
-		*dest++ = 0;
+		dest[240] = 0;
 		break;
 	}
 	case 24:
+		colorConvertLine24((u8 *)pix + 240 * VCOUNT * 3, lineMix, 240);
+		break;
+	case 32:
+		colorConvertLine32((u32 *)pix + 241 * (VCOUNT + 1), lineMix, 240);
+		break;
+	}
+}
+
+#ifdef MULTI_INSTANCE
+// Optional render thread. With per-thread emulation state, the worker has its
+// own video memory, I/O registers and line buffers, so the mode renderers run
+// there unchanged: every visible line, the CPU thread posts the registers and
+// the palette, VRAM and OAM pages written since the previous line, and goes
+// on emulating while the worker draws the line into pix.
+#define CPU_RENDER_JOBS	 16
+#define CPU_RENDER_PAGES (CPU_DIRTY_PAGES - CPU_DIRTY_PALETTE_RAM)
+
+#define CPU_RENDER_REGS(R) \
+	R(DISPCNT) R(VCOUNT) \
+	R(BG0CNT) R(BG1CNT) R(BG2CNT) R(BG3CNT) \
+	R(BG0HOFS) R(BG0VOFS) R(BG1HOFS) R(BG1VOFS) \
+	R(BG2HOFS) R(BG2VOFS) R(BG3HOFS) R(BG3VOFS) \
+	R(BG2PA) R(BG2PB) R(BG2PC) R(BG2PD) R(BG2X_L) R(BG2X_H) R(BG2Y_L) R(BG2Y_H) \
+	R(BG3PA) R(BG3PB) R(BG3PC) R(BG3PD) R(BG3X_L) R(BG3X_H) R(BG3Y_L) R(BG3Y_H) \
+	R(WIN0H) R(WIN1H) R(WIN0V) R(WIN1V) R(WININ) R(WINOUT) \
+	R(MOSAIC) R(BLDMOD) R(COLEV) R(COLY)
+
+struct CPURenderJob
+{
+	void (*renderLine)();
+	u8 *  pix;
+#define CPU_RENDER_REG_DECLARE(r) u16 r;
+	CPU_RENDER_REGS(CPU_RENDER_REG_DECLARE)
+#undef CPU_RENDER_REG_DECLARE
+	int32 layerEnable;
+	int32 clearLayers;
+	int	  bg2Changed;
+	int	  bg3Changed;
+	bool  inWin0[240];
+	bool  inWin1[240];
+	int	  pageCount;
+	u16	  pages[CPU_RENDER_PAGES];
+	u8	  pageData[CPU_RENDER_PAGES][0x100];
+};
+
+// the renderer state that lasts from one line to the next, handed over when
+// the thread starts and when it stops
+struct CPURenderState
+{
+	u32 line[4][240];
+	int bg2Changed, bg3Changed;
+	int bg2X, bg2Y, bg3X, bg3Y;
+	int lastVCOUNT;
+};
+
+struct CPURenderThread
+{
+	std::thread				thread;
+	std::mutex				lock;
+	std::condition_variable posted;
+	std::condition_variable done;
+	int						head; // jobs [tail, head) are waiting or being drawn
+	int						tail;
+	bool					quit;
+	CPURenderState			state;
+	CPURenderJob			jobs[CPU_RENDER_JOBS];
+};
+
+static u8 *CPURenderPage(int page)
+{
+	if (page < CPU_DIRTY_VRAM - CPU_DIRTY_PALETTE_RAM)
+		return &paletteRAM[page << 8];
+	if (page < CPU_DIRTY_OAM - CPU_DIRTY_PALETTE_RAM)
+		return &vram[(page - (CPU_DIRTY_VRAM - CPU_DIRTY_PALETTE_RAM)) << 8];
+	return &oam[(page - (CPU_DIRTY_OAM - CPU_DIRTY_PALETTE_RAM)) << 8];
+}
+
+// moves the calling thread's renderer state out to state
+static void CPURenderStateSave(CPURenderState &state)
+{
+	memcpy(state.line[0], line0, sizeof(line0));
+	memcpy(state.line[1], line1, sizeof(line1));
+	memcpy(state.line[2], line2, sizeof(line2));
+	memcpy(state.line[3], line3, sizeof(line3));
+	state.bg2Changed = gfxBG2Changed;
+	state.bg3Changed = gfxBG3Changed;
+	state.bg2X		 = gfxBG2X;
+	state.bg2Y		 = gfxBG2Y;
+	state.bg3X		 = gfxBG3X;
+	state.bg3Y		 = gfxBG3Y;
+	state.lastVCOUNT = gfxLastVCOUNT;
+	gfxBG2Changed	 = 0;
+	gfxBG3Changed	 = 0;
+}
+
+static void CPURenderStateLoad(const CPURenderState &state)
+{
+	memcpy(line0, state.line[0], sizeof(line0));
+	memcpy(line1, state.line[1], sizeof(line1));
+	memcpy(line2, state.line[2], sizeof(line2));
+	memcpy(line3, state.line[3], sizeof(line3));
+	gfxBG2Changed |= state.bg2Changed;
+	gfxBG3Changed |= state.bg3Changed;
+	gfxBG2X		   = state.bg2X;
+	gfxBG2Y		   = state.bg2Y;
+	gfxBG3X		   = state.bg3X;
+	gfxBG3Y		   = state.bg3Y;
+	gfxLastVCOUNT  = state.lastVCOUNT;
+}
+
+static void CPURenderThreadDraw(const CPURenderJob &job)
+{
+	for (int i = 0; i < job.pageCount; i++)
+	{
+		memcpy(CPURenderPage(job.pages[i]), job.pageData[i], 0x100);
+		CPUDirtyVideoWrite(CPU_DIRTY_PALETTE_RAM + job.pages[i]);
+	}
+
+#define CPU_RENDER_REG_LOAD(r) r = job.r;
+	CPU_RENDER_REGS(CPU_RENDER_REG_LOAD)
+#undef CPU_RENDER_REG_LOAD
+	layerEnable	   = job.layerEnable;
+	gfxBG2Changed |= job.bg2Changed;
+	gfxBG3Changed |= job.bg3Changed;
+	memcpy(gfxInWin0, job.inWin0, sizeof(gfxInWin0));
+	memcpy(gfxInWin1, job.inWin1, sizeof(gfxInWin1));
+	pix = job.pix;
+
+	// what CPUUpdateRenderBuffers() did on the CPU thread since the last line
+	if (job.clearLayers & 0x0100)
+		gfxClearArray(line0);
+	if (job.clearLayers & 0x0200)
+		gfxClearArray(line1);
+	if (job.clearLayers & 0x0400)
+		gfxClearArray(line2);
+	if (job.clearLayers & 0x0800)
+		gfxClearArray(line3);
+
+	(*job.renderLine)();
+
+	CPUDrawPixLine();
+}
+
+static void CPURenderThreadMain(CPURenderThread *t)
+{
+	paletteRAM = (u8 *)calloc(1, 0x400);
+	vram	   = (u8 *)calloc(1, 0x20000);
+	oam		   = (u8 *)calloc(1, 0x400);
+	bool ok	   = paletteRAM && vram && oam && gfxTileCacheInit();
+	CPURenderStateLoad(t->state);
+
+	for (;;)
 	{
-		u8 *dest = (u8 *)pix + 240 * VCOUNT * 3;
-		for (int x = 0; x < 240; )
+		const CPURenderJob *job;
 		{
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
-			*((u32 *)dest) = systemColorMap32[lineMix[x++] & 0xFFFF];
-			dest += 3;
+			std::unique_lock<std::mutex> lock(t->lock);
+			while (t->tail == t->head && !t->quit)
+				t->posted.wait(lock);
+			if (t->tail == t->head)
+				break;
+			job = &t->jobs[t->tail % CPU_RENDER_JOBS];
 		}
-		break;
+
+		if (ok)
+			CPURenderThreadDraw(*job);
+
+		std::lock_guard<std::mutex> lock(t->lock);
+		t->tail++;
+		t->done.notify_one();
 	}
-	case 32:
+
+	CPURenderStateSave(t->state);
+	gfxTileCacheCleanUp();
+	free(paletteRAM);
+	free(vram);
+	free(oam);
+}
+
+static void CPURenderThreadStart()
+{
+	CPURenderThread *t = new CPURenderThread;
+	t->head = t->tail = 0;
+	t->quit = false;
+	CPURenderStateSave(t->state);
+	t->thread = std::thread(CPURenderThreadMain, t);
+
+	// the first line brings the whole video memory over
+	memset(cpuVideoDirtyPages, 1, sizeof(cpuVideoDirtyPages));
+	cpuVideoDirty		 = true;
+	cpuRenderClearLayers = 0;
+	cpuRenderThread		 = t;
+}
+
+// Waits until every posted line is in pix
+static void CPURenderThreadSync()
+{
+	CPURenderThread *t = cpuRenderThread;
+	if (t == NULL)
+		return;
+
+	std::unique_lock<std::mutex> lock(t->lock);
+	while (t->tail != t->head)
+		t->done.wait(lock);
+}
+
+static void CPURenderThreadStop()
+{
+	CPURenderThread *t = cpuRenderThread;
+	if (t == NULL)
+		return;
+
 	{
-		u32 *dest = (u32 *)pix + 241 * (VCOUNT + 1);
-		for (int x = 0; x < 240; )
+		std::lock_guard<std::mutex> lock(t->lock);
+		t->quit = true;
+		t->posted.notify_one();
+	}
+	t->thread.join();
+	CPURenderStateLoad(t->state);
+	delete t;
+	cpuRenderThread = NULL;
+
+	// this thread's tile cache missed the writes shipped to the worker
+	memset(cpuVideoDirtyPages, 1, sizeof(cpuVideoDirtyPages));
+	cpuVideoDirty = true;
+}
+
+static void CPURenderThreadLine()
+{
+	CPURenderThread *t = cpuRenderThread;
+	{
+		std::unique_lock<std::mutex> lock(t->lock);
+		while (t->head - t->tail == CPU_RENDER_JOBS)
+			t->done.wait(lock);
+	}
+
+	CPURenderJob &job = t->jobs[t->head % CPU_RENDER_JOBS];
+	job.renderLine = renderLine;
+	job.pix		   = pix;
+#define CPU_RENDER_REG_SAVE(r) job.r = r;
+	CPU_RENDER_REGS(CPU_RENDER_REG_SAVE)
+#undef CPU_RENDER_REG_SAVE
+	job.layerEnable		 = layerEnable;
+	job.clearLayers		 = cpuRenderClearLayers;
+	job.bg2Changed		 = gfxBG2Changed;
+	job.bg3Changed		 = gfxBG3Changed;
+	cpuRenderClearLayers = 0;
+	gfxBG2Changed		 = 0;
+	gfxBG3Changed		 = 0;
+	memcpy(job.inWin0, gfxInWin0, sizeof(gfxInWin0));
+	memcpy(job.inWin1, gfxInWin1, sizeof(gfxInWin1));
+
+	job.pageCount = 0;
+	if (cpuVideoDirty)
+	{
+		cpuVideoDirty = false;
+		for (int i = 0; i < CPU_RENDER_PAGES; i++)
 		{
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
-			*dest++ = systemColorMap32[lineMix[x++] & 0xFFFF];
+			if (cpuVideoDirtyPages[i])
+			{
+				cpuVideoDirtyPages[i] = 0;
+				job.pages[job.pageCount] = i;
+				memcpy(job.pageData[job.pageCount++], CPURenderPage(i), 0x100);
+			}
 		}
-		break;
-	}
 	}
+
+	std::lock_guard<std::mutex> lock(t->lock);
+	t->head++;
+	t->posted.notify_one();
 }
 
+// At the end of the visible lines: the frontend is about to show pix, and the
+// thread is started or stopped here when the setting changed
+static void CPURenderThreadFrame()
+{
+	if (cpuRenderThreadEnabled && !cpuRenderThread)
+		CPURenderThreadStart();
+	else if (!cpuRenderThreadEnabled && cpuRenderThread)
+		CPURenderThreadStop();
+	else
+		CPURenderThreadSync();
+}
+#endif
+
 static inline u32 CPUGetUserInput()
 {
 	// update joystick information
@@ -3809,6 +4464,8 @@ static inline void CPUBeforeEmulation()
 
 static inline void CPUFrameBoundaryWork()
 {
+	soundFlush();
+
 	// HACK: some special "buttons"
 	if (cheatsEnabled)
 		cheatsCheckKeys(P1 ^ 0x3FF, extButtons);
@@ -3816,14 +4473,306 @@ static inline void CPUFrameBoundaryWork()
 	systemFrameBoundaryWork();
 }
 
+static INSTANCE_LOCAL bool8 newVideoFrame = false;
+static INSTANCE_LOCAL int32 timerOverflow = 0;
+
+static void CPUEventLcd()
+{
+	if (DISPSTAT & 1) // V-BLANK
+	{ // if in V-Blank mode, keep computing...
+		if (DISPSTAT & 2)
+		{
+			CPUEventRepeat(CPU_EVENT_LCD, 1008);
+			VCOUNT++;
+			UPDATE_REG(0x06, VCOUNT);
+			DISPSTAT &= 0xFFFD;
+			UPDATE_REG(0x04, DISPSTAT);
+			CPUCompareVCOUNT();
+		}
+		else
+		{
+			CPUEventRepeat(CPU_EVENT_LCD, 224);
+			DISPSTAT |= 2;
+			UPDATE_REG(0x04, DISPSTAT);
+			if (DISPSTAT & 16)
+			{
+				IF |= 2;
+				UPDATE_REG(0x202, IF);
+			}
+		}
+
+		if (VCOUNT >= 228) //Reaching last line
+		{
+			DISPSTAT &= 0xFFFC;
+			UPDATE_REG(0x04, DISPSTAT);
+			VCOUNT = 0;
+			UPDATE_REG(0x06, VCOUNT);
+			CPUCompareVCOUNT();
+		}
+	}
+	else
+	{
+		if (DISPSTAT & 2)
+		{
+			// if in H-Blank, leave it and move to drawing mode
+			VCOUNT++;
+			UPDATE_REG(0x06, VCOUNT);
+
+			CPUEventRepeat(CPU_EVENT_LCD, 1008);
+			DISPSTAT &= 0xFFFD;
+			if (VCOUNT == 160)
+			{
+				DISPSTAT |= 1;
+				DISPSTAT &= 0xFFFD;
+				UPDATE_REG(0x04, DISPSTAT);
+				if (DISPSTAT & 0x0008)
+				{
+					IF |= 1;
+					UPDATE_REG(0x202, IF);
+				}
+				CPUCheckDMA(1, 0x0f);
+
+				newVideoFrame = true;
+			}
+
+			UPDATE_REG(0x04, DISPSTAT);
+			CPUCompareVCOUNT();
+		}
+		else
+		{
+			if (systemFrameDrawingRequired())
+			{
+#ifdef MULTI_INSTANCE
+				if (cpuRenderThread)
+					CPURenderThreadLine();
+				else
+#endif
+				{
+					(*renderLine)();
+
+					CPUDrawPixLine();
+				}
+			}
+			// entering H-Blank
+			DISPSTAT |= 2;
+			UPDATE_REG(0x04, DISPSTAT);
+			CPUEventRepeat(CPU_EVENT_LCD, 224);
+			CPUCheckDMA(2, 0x0f);
+			if (DISPSTAT & 16)
+			{
+				IF |= 2;
+				UPDATE_REG(0x202, IF);
+			}
+		}
+	}
+}
+
+// The sound ticks aren't events: GBASound asks how many are due when it has
+// to run them, see soundCatchUp(). They go on in stop state, producing mute
+// sound, as the sound would lose synchronization otherwise.
+int CPUSoundTicksDue()
+{
+	int32 late = (int32)(cpuEventClock + cpuTotalTicks - cpuSoundWhen);
+	if (late < 0 || soundTickStep == 0) // or the sound isn't reset yet
+		return 0;
+
+	int ticks = late / soundTickStep + 1;
+	cpuSoundWhen += ticks * soundTickStep;
+	return ticks;
+}
+
+static void CPUEventTimer0()
+{
+	CPUEventRepeat(CPU_EVENT_TIMER0, (0x10000 - timer0Reload) << timer0ClockReload);
+	timerOverflow |= 1;
+	soundTimerOverflow(0);
+	if (TM0CNT & 0x40)
+	{
+		IF |= 0x08;
+		UPDATE_REG(0x202, IF);
+	}
+}
+
+static void CPUEventTimer1()
+{
+	CPUEventRepeat(CPU_EVENT_TIMER1, (0x10000 - timer1Reload) << timer1ClockReload);
+	timerOverflow |= 2;
+	soundTimerOverflow(1);
+	if (TM1CNT & 0x40)
+	{
+		IF |= 0x10;
+		UPDATE_REG(0x202, IF);
+	}
+}
+
+static void CPUEventTimer2()
+{
+	CPUEventRepeat(CPU_EVENT_TIMER2, (0x10000 - timer2Reload) << timer2ClockReload);
+	timerOverflow |= 4;
+	if (TM2CNT & 0x40)
+	{
+		IF |= 0x20;
+		UPDATE_REG(0x202, IF);
+	}
+}
+
+static void CPUEventTimer3()
+{
+	CPUEventRepeat(CPU_EVENT_TIMER3, (0x10000 - timer3Reload) << timer3ClockReload);
+	if (TM3CNT & 0x40)
+	{
+		IF |= 0x40;
+		UPDATE_REG(0x202, IF);
+	}
+}
+
+static void (*const cpuEventHandlers[CPU_EVENT_COUNT])() =
+{
+	CPUEventLcd,
+	CPUEventTimer0,
+	CPUEventTimer1,
+	CPUEventTimer2,
+	CPUEventTimer3
+};
+
+// count-up timers and the TMxD registers of the running timers
+static void CPUTimerUpdate()
+{
+	if (timer0On)
+	{
+		TM0D = 0xFFFF - (CPUEventTicks(CPU_EVENT_TIMER0) >> timer0ClockReload) & 0xFFFF;
+		UPDATE_REG(0x100, TM0D);
+	}
+
+	if (timer1On)
+	{
+		if (TM1CNT & 4)
+		{
+			if (timerOverflow & 1)
+			{
+				TM1D++;
+				if (TM1D == 0)
+				{
+					TM1D += timer1Reload;
+					timerOverflow |= 2;
+					soundTimerOverflow(1);
+					if (TM1CNT & 0x40)
+					{
+						IF |= 0x10;
+						UPDATE_REG(0x202, IF);
+					}
+				}
+				UPDATE_REG(0x104, TM1D);
+			}
+		}
+		else
+		{
+			TM1D = 0xFFFF - (CPUEventTicks(CPU_EVENT_TIMER1) >> timer1ClockReload) & 0xFFFF;
+			UPDATE_REG(0x104, TM1D);
+		}
+	}
+
+	if (timer2On)
+	{
+		if (TM2CNT & 4)
+		{
+			if (timerOverflow & 2)
+			{
+				TM2D++;
+				if (TM2D == 0)
+				{
+					TM2D += timer2Reload;
+					timerOverflow |= 4;
+					if (TM2CNT & 0x40)
+					{
+						IF |= 0x20;
+						UPDATE_REG(0x202, IF);
+					}
+				}
+				UPDATE_REG(0x108, TM2D);
+			}
+		}
+		else
+		{
+			TM2D = 0xFFFF - (CPUEventTicks(CPU_EVENT_TIMER2) >> timer2ClockReload) & 0xFFFF;
+			UPDATE_REG(0x108, TM2D);
+		}
+	}
+
+	if (timer3On)
+	{
+		if (TM3CNT & 4)
+		{
+			if (timerOverflow & 4)
+			{
+				TM3D++;
+				if (TM3D == 0)
+				{
+					TM3D += timer3Reload;
+					if (TM3CNT & 0x40)
+					{
+						IF |= 0x40;
+						UPDATE_REG(0x202, IF);
+					}
+				}
+				UPDATE_REG(0x10C, TM3D);
+			}
+		}
+		else
+		{
+			TM3D = 0xFFFF - (CPUEventTicks(CPU_EVENT_TIMER3) >> timer3ClockReload) & 0xFFFF;
+			UPDATE_REG(0x10C, TM3D);
+		}
+	}
+}
+
+// Moves the event clock forward and runs the handlers of the due events, in
+// the order of their types, so that a tick shared by several events gives
+// the same results whatever their deadlines were.
+static void CPUEventDispatch(int32 clockTicks)
+{
+	cpuEventClock += clockTicks;
+
+	// the timers don't count in stop state
+	if (stopState)
+	{
+		for (int type = CPU_EVENT_TIMER0; type <= CPU_EVENT_TIMER3; type++)
+		{
+			if (CPUEventScheduled(type))
+				CPUEventSchedule(type, CPUEventTicks(type) + clockTicks);
+		}
+	}
+
+	int due = 0;
+	while (cpuEventCount && CPUEventTicks(cpuEventHeap[0]) <= 0)
+	{
+		int type = cpuEventHeap[0];
+		due |= 1 << type;
+		CPUEventCancel(type);
+	}
+
+	for (int type = 0; due; type++, due >>= 1)
+	{
+		if (!(due & 1))
+			continue;
+		if (type >= CPU_EVENT_TIMER0 && stopState)
+			CPUEventSchedule(type, CPUEventTicks(type));
+		else
+			(*cpuEventHandlers[type])();
+	}
+
+	if (!stopState)
+		CPUTimerUpdate();
+
+	timerOverflow = 0;
+}
+
 void CPULoop(int _ticks)
 {
 	CPUBeforeEmulation();
 
 	int32 ticks = _ticks;
 	int32 clockTicks;
-	int32 timerOverflow = 0;
-	bool newVideoFrame = false;
 
 	// variable used by the CPU core
 	cpuTotalTicks = 0;
@@ -3943,238 +4892,7 @@ updateLoop:
 					IRQTicks = 0;
 			}
 
-			lcdTicks -= clockTicks;
-
-			if (lcdTicks <= 0)
-			{
-				if (DISPSTAT & 1) // V-BLANK
-				{ // if in V-Blank mode, keep computing...
-					if (DISPSTAT & 2)
-					{
-						lcdTicks += 1008;
-						VCOUNT++;
-						UPDATE_REG(0x06, VCOUNT);
-						DISPSTAT &= 0xFFFD;
-						UPDATE_REG(0x04, DISPSTAT);
-						CPUCompareVCOUNT();
-					}
-					else
-					{
-						lcdTicks += 224;
-						DISPSTAT |= 2;
-						UPDATE_REG(0x04, DISPSTAT);
-						if (DISPSTAT & 16)
-						{
-							IF |= 2;
-							UPDATE_REG(0x202, IF);
-						}
-					}
-
-					if (VCOUNT >= 228) //Reaching last line
-					{
-						DISPSTAT &= 0xFFFC;
-						UPDATE_REG(0x04, DISPSTAT);
-						VCOUNT = 0;
-						UPDATE_REG(0x06, VCOUNT);
-						CPUCompareVCOUNT();
-					}
-				}
-				else
-				{
-					if (DISPSTAT & 2)
-					{
-						// if in H-Blank, leave it and move to drawing mode
-						VCOUNT++;
-						UPDATE_REG(0x06, VCOUNT);
-
-						lcdTicks += 1008;
-						DISPSTAT &= 0xFFFD;
-						if (VCOUNT == 160)
-						{
-							DISPSTAT |= 1;
-							DISPSTAT &= 0xFFFD;
-							UPDATE_REG(0x04, DISPSTAT);
-							if (DISPSTAT & 0x0008)
-							{
-								IF |= 1;
-								UPDATE_REG(0x202, IF);
-							}
-							CPUCheckDMA(1, 0x0f);
-
-							newVideoFrame = true;
-						}
-
-						UPDATE_REG(0x04, DISPSTAT);
-						CPUCompareVCOUNT();
-					}
-					else
-					{
-						if (systemFrameDrawingRequired())
-						{
-							(*renderLine)();
-
-							CPUDrawPixLine();
-						}
-						// entering H-Blank
-						DISPSTAT |= 2;
-						UPDATE_REG(0x04, DISPSTAT);
-						lcdTicks += 224;
-						CPUCheckDMA(2, 0x0f);
-						if (DISPSTAT & 16)
-						{
-							IF |= 2;
-							UPDATE_REG(0x202, IF);
-						}
-					}
-				}
-			}
-
-			// we shouldn't be doing sound in stop state, but we lose synchronization
-			// if sound is disabled, so in stop state, soundTick will just produce
-			// mute sound
-			soundTicks -= clockTicks;
-			if (soundTicks <= 0)
-			{
-				soundTick();
-				soundTicks += soundTickStep;
-			}
-
-			if (!stopState)
-			{
-				if (timer0On)
-				{
-					timer0Ticks -= clockTicks;
-					if (timer0Ticks <= 0)
-					{
-						timer0Ticks	  += (0x10000 - timer0Reload) << timer0ClockReload;
-						timerOverflow |= 1;
-						soundTimerOverflow(0);
-						if (TM0CNT & 0x40)
-						{
-							IF |= 0x08;
-							UPDATE_REG(0x202, IF);
-						}
-					}
-					TM0D = 0xFFFF - (timer0Ticks >> timer0ClockReload) & 0xFFFF;
-					UPDATE_REG(0x100, TM0D);
-				}
-
-				if (timer1On)
-				{
-					if (TM1CNT & 4)
-					{
-						if (timerOverflow & 1)
-						{
-							TM1D++;
-							if (TM1D == 0)
-							{
-								TM1D += timer1Reload;
-								timerOverflow |= 2;
-								soundTimerOverflow(1);
-								if (TM1CNT & 0x40)
-								{
-									IF |= 0x10;
-									UPDATE_REG(0x202, IF);
-								}
-							}
-							UPDATE_REG(0x104, TM1D);
-						}
-					}
-					else
-					{
-						timer1Ticks -= clockTicks;
-						if (timer1Ticks <= 0)
-						{
-							timer1Ticks	  += (0x10000 - timer1Reload) << timer1ClockReload;
-							timerOverflow |= 2;
-							soundTimerOverflow(1);
-							if (TM1CNT & 0x40)
-							{
-								IF |= 0x10;
-								UPDATE_REG(0x202, IF);
-							}
-						}
-						TM1D = 0xFFFF - (timer1Ticks >> timer1ClockReload) & 0xFFFF;
-						UPDATE_REG(0x104, TM1D);
-					}
-				}
-
-				if (timer2On)
-				{
-					if (TM2CNT & 4)
-					{
-						if (timerOverflow & 2)
-						{
-							TM2D++;
-							if (TM2D == 0)
-							{
-								TM2D += timer2Reload;
-								timerOverflow |= 4;
-								if (TM2CNT & 0x40)
-								{
-									IF |= 0x20;
-									UPDATE_REG(0x202, IF);
-								}
-							}
-							UPDATE_REG(0x108, TM2D);
-						}
-					}
-					else
-					{
-						timer2Ticks -= clockTicks;
-						if (timer2Ticks <= 0)
-						{
-							timer2Ticks	  += (0x10000 - timer2Reload) << timer2ClockReload;
-							timerOverflow |= 4;
-							if (TM2CNT & 0x40)
-							{
-								IF |= 0x20;
-								UPDATE_REG(0x202, IF);
-							}
-						}
-						TM2D = 0xFFFF - (timer2Ticks >> timer2ClockReload) & 0xFFFF;
-						UPDATE_REG(0x108, TM2D);
-					}
-				}
-
-				if (timer3On)
-				{
-					if (TM3CNT & 4)
-					{
-						if (timerOverflow & 4)
-						{
-							TM3D++;
-							if (TM3D == 0)
-							{
-								TM3D += timer3Reload;
-								if (TM3CNT & 0x40)
-								{
-									IF |= 0x40;
-									UPDATE_REG(0x202, IF);
-								}
-							}
-							UPDATE_REG(0x10C, TM3D);
-						}
-					}
-					else
-					{
-						timer3Ticks -= clockTicks;
-						if (timer3Ticks <= 0)
-						{
-							timer3Ticks += (0x10000 - timer3Reload) << timer3ClockReload;
-							if (TM3CNT & 0x40)
-							{
-								IF |= 0x40;
-								UPDATE_REG(0x202, IF);
-							}
-						}
-						TM3D = 0xFFFF - (timer3Ticks >> timer3ClockReload) & 0xFFFF;
-						UPDATE_REG(0x10C, TM3D);
-					}
-				}
-			}
-
-			timerOverflow = 0;
+			CPUEventDispatch(clockTicks);
 
 #ifdef PROFILING
 			profilingTicks -= clockTicks;
@@ -4204,6 +4922,9 @@ updateLoop:
 			if (newVideoFrame)
 			{
 				newVideoFrame = false;
+#ifdef MULTI_INSTANCE
+				CPURenderThreadFrame();
+#endif
 				CPUFrameBoundaryWork();
 			}
 
@@ -4232,6 +4953,8 @@ updateLoop:
 					{
 						if (!IRQTicks)
 						{
+							if (stopState)
+								soundCatchUp();
 							CPUInterrupt();
 							intState  = false;
 							holdState = false;
@@ -4250,6 +4973,8 @@ updateLoop:
 						}
 						else
 						{
+							if (stopState)
+								soundCatchUp();
 							CPUInterrupt();
 							holdState = false;
 							stopState = false;
@@ -4286,6 +5011,7 @@ updateLoop:
 			if (newFrame || useOldFrameTiming && ticks <= 0)
 #endif
 			{
+				soundFlush();
 				break;
 			}
 		}
@@ -4320,6 +5046,12 @@ struct EmulatedSystem GBASystem =
 	CPUReadMemState,
 	// emuWriteMemState
 	CPUWriteMemState,
+	// emuReadMemStateRaw
+	CPUReadMemStateRaw,
+	// emuWriteMemStateRaw
+	CPUWriteMemStateRaw,
+	// emuWriteMemStateIncremental
+	CPUWriteMemStateIncremental,
 	// emuWritePNG
 	CPUWritePNGFile,
 	// emuWriteBMP
@@ -183,28 +183,28 @@
 #define countof(a)  (sizeof(a) / sizeof(a[0]))
 #endif
 
-CheatsData cheatsList[100];
-int		   cheatsNumber = 0;
-u32		   rompatch2addr [4];
-u16		   rompatch2val [4];
-u16		   rompatch2oldval [4];
-
-u8		   cheatsCBASeedBuffer[0x30];
-u32		   cheatsCBASeed[4];
-u32		   cheatsCBATemporaryValue = 0;
-u16		   cheatsCBATable[256];
-bool	   cheatsCBATableGenerated = false;
-u16		   super = 0;
-extern u32 mastercode;
-
-u8 cheatsCBACurrentSeed[12] = {
+INSTANCE_LOCAL CheatsData cheatsList[100];
+INSTANCE_LOCAL int		   cheatsNumber = 0;
+INSTANCE_LOCAL u32		   rompatch2addr [4];
+INSTANCE_LOCAL u16		   rompatch2val [4];
+INSTANCE_LOCAL u16		   rompatch2oldval [4];
+
+INSTANCE_LOCAL u8		   cheatsCBASeedBuffer[0x30];
+INSTANCE_LOCAL u32		   cheatsCBASeed[4];
+INSTANCE_LOCAL u32		   cheatsCBATemporaryValue = 0;
+INSTANCE_LOCAL u16		   cheatsCBATable[256];
+INSTANCE_LOCAL bool	   cheatsCBATableGenerated = false;
+INSTANCE_LOCAL u16		   super = 0;
+extern INSTANCE_LOCAL u32 mastercode;
+
+INSTANCE_LOCAL u8 cheatsCBACurrentSeed[12] = {
 	0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00
 };
 
-u32 seeds_v1[4];
-u32 seeds_v3[4];
+INSTANCE_LOCAL u32 seeds_v1[4];
+INSTANCE_LOCAL u32 seeds_v3[4];
 
 u32 seed_gen(u8 upper, u8 seed, u8 *deadtable1, u8 *deadtable2);
 
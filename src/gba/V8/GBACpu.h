@@ -7,6 +7,7 @@
 
 extern int armExecute();
 extern int thumbExecute();
+extern void thumbCleanUp();
 
 #ifdef __GNUC__
 # define INSN_REGPARM __attribute__((regparm(1)))
@@ -41,21 +42,21 @@ extern int thumbExecute();
 #define THUMB_PREFETCH_NEXT \
 	cpuPrefetch[1] = CPUReadHalfWordQuick(armNextPC + 2);
 
-extern int32 SWITicks;
-extern u32	 mastercode;
-extern bool8 busPrefetch;
-extern bool8 busPrefetchEnable;
-extern u32	 busPrefetchCount;
-extern int32 cpuNextEvent;
-extern bool8 holdState;
-extern u32	 cpuPrefetch[2];
-extern int32 cpuTotalTicks;
-extern u8	 memoryWait[16];
-extern u8	 memoryWait32[16];
-extern u8	 memoryWaitSeq[16];
-extern u8	 memoryWaitSeq32[16];
-extern u8	 cpuBitsSet[256];
-extern u8	 cpuLowestBitSet[256];
+extern INSTANCE_LOCAL int32 SWITicks;
+extern INSTANCE_LOCAL u32	 mastercode;
+extern INSTANCE_LOCAL bool8 busPrefetch;
+extern INSTANCE_LOCAL bool8 busPrefetchEnable;
+extern INSTANCE_LOCAL u32	 busPrefetchCount;
+extern INSTANCE_LOCAL int32 cpuNextEvent;
+extern INSTANCE_LOCAL bool8 holdState;
+extern INSTANCE_LOCAL u32	 cpuPrefetch[2];
+extern INSTANCE_LOCAL int32 cpuTotalTicks;
+extern INSTANCE_LOCAL u8	 memoryWait[16];
+extern INSTANCE_LOCAL u8	 memoryWait32[16];
+extern INSTANCE_LOCAL u8	 memoryWaitSeq[16];
+extern INSTANCE_LOCAL u8	 memoryWaitSeq32[16];
+extern INSTANCE_LOCAL u8	 cpuBitsSet[256];
+extern INSTANCE_LOCAL u8	 cpuLowestBitSet[256];
 
 extern void CPUSwitchMode(int mode, bool saveState, bool breakLoop);
 extern void CPUSwitchMode(int mode, bool saveState);
@@ -66,6 +67,107 @@ extern void CPUUndefinedException();
 extern void CPUSoftwareInterrupt();
 extern void CPUSoftwareInterrupt(int comment);
 
+// Optional per-instruction work of the execution loops, as returned by
+// CPUExecFeatures(); the loops are instantiated for every combination
+#define CPU_FEATURE_CHEATS	  1 // cheats master code
+#define CPU_FEATURE_EXEC_HOOK 2 // Lua exec hooks and the debugger stop address
+#define CPU_FEATURE_IDLE_LOOP 4 // skipping of busy-wait loops, only without the above
+#define CPU_FEATURE_MASK	  7
+
+extern int CPUExecFeatures();
+
+// Event scheduler
+// Deadlines are absolute values of cpuEventClock, which moves forward at
+// every event boundary; the CPU core counts cpuTotalTicks from there. The
+// sound ticks are no events, see CPUSoundTicksDue().
+#define CPU_EVENT_LCD	 0
+#define CPU_EVENT_TIMER0 1
+#define CPU_EVENT_TIMER1 2
+#define CPU_EVENT_TIMER2 3
+#define CPU_EVENT_TIMER3 4
+#define CPU_EVENT_COUNT	 5
+
+extern INSTANCE_LOCAL u32 cpuEventClock;
+extern INSTANCE_LOCAL u32 cpuEventWhen[CPU_EVENT_COUNT];
+
+// ticks left until the event, counted from the last event boundary
+inline int32 CPUEventTicks(int type)
+{
+	return (int32)(cpuEventWhen[type] - cpuEventClock);
+}
+
+// Dirty pages
+// The pages of EWRAM, IWRAM, palette RAM, VRAM and OAM written since the last
+// uncompressed state was written; EWRAM and IWRAM use the page numbers of the
+// block cache.
+#define CPU_DIRTY_PALETTE_RAM 0x480
+#define CPU_DIRTY_VRAM		  0x484
+#define CPU_DIRTY_OAM		  0x684
+#define CPU_DIRTY_PAGES		  0x688
+
+extern INSTANCE_LOCAL u8 cpuDirtyPages[CPU_DIRTY_PAGES];
+
+extern void CPUDirtyAll();
+
+inline void CPUDirtyWrite(int page)
+{
+	cpuDirtyPages[page] = 1;
+}
+
+// The palette RAM, VRAM and OAM pages are also noted for the renderer: its
+// tile cache and sprite bins clear these flags in gfxVideoCacheUpdate(), or
+// the render thread ships the pages with each line.
+extern INSTANCE_LOCAL u8	cpuVideoDirtyPages[CPU_DIRTY_PAGES - CPU_DIRTY_PALETTE_RAM];
+extern INSTANCE_LOCAL bool8 cpuVideoDirty;
+
+inline void CPUDirtyVideoWrite(int page)
+{
+	cpuDirtyPages[page] = 1;
+	cpuVideoDirtyPages[page - CPU_DIRTY_PALETTE_RAM] = 1;
+	cpuVideoDirty = true;
+}
+
+// Pre-decoded block cache
+// Blocks never cross a 256 bytes page, so that a write into EWRAM/IWRAM only
+// has to throw away the blocks decoded from the written page.
+#define CPU_BLOCK_CACHE_UNCACHED   (-2)
+#define CPU_BLOCK_CACHE_ROM        (-1)
+#define CPU_BLOCK_CACHE_IWRAM_BASE 0x400
+#define CPU_BLOCK_CACHE_PAGES      0x480
+
+extern INSTANCE_LOCAL u32 cpuBlockCacheGeneration;
+extern INSTANCE_LOCAL u32 cpuBlockCacheInvalidations;
+extern INSTANCE_LOCAL u8  cpuBlockCachePageCode[CPU_BLOCK_CACHE_PAGES];
+extern INSTANCE_LOCAL u32 cpuBlockCachePageGen[CPU_BLOCK_CACHE_PAGES];
+
+extern void CPUBlockCacheInvalidatePage(int page);
+extern void CPUBlockCacheInvalidate(u32 address, u32 size);
+
+inline int CPUBlockCachePage(u32 address)
+{
+	switch (address >> 24)
+	{
+	case 0x02:
+		return (address & 0x3FFFF) >> 8;
+	case 0x03:
+		return CPU_BLOCK_CACHE_IWRAM_BASE + ((address & 0x7FFF) >> 8);
+	case 0x08:
+	case 0x09:
+	case 0x0A:
+	case 0x0C:
+		return CPU_BLOCK_CACHE_ROM;
+	default:
+		return CPU_BLOCK_CACHE_UNCACHED;
+	}
+}
+
+// called for every write into EWRAM/IWRAM
+inline void CPUBlockCacheWrite(int page)
+{
+	if (cpuBlockCachePageCode[page])
+		CPUBlockCacheInvalidatePage(page);
+}
+
 // Waitstates when accessing data
 inline int dataTicksAccess16(u32 address) // DATA 8/16bits NON SEQ
 {
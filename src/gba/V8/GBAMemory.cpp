@@ -10,6 +10,7 @@
 #include "../EEprom.h"
 #include "../Flash.h"
 #include "../RTC.h"
+#include "GBACpu.h"
 
 #ifdef BKPT_SUPPORT
 void cheatsWriteMemory(u32 *address, u32 value, u32 mask);
@@ -19,7 +20,7 @@ void cheatsWriteByte(u8 *address, u8 value);
 
 #ifdef BKPT_SUPPORT
 #ifdef SDL
-extern int cpuNextEvent;
+extern INSTANCE_LOCAL int cpuNextEvent;
 extern void debuggerBreakOnWrite(u32, u32, u32, int, int);
 
 static u8 cheatsGetType(u32 address)
@@ -90,36 +91,32 @@ void cheatsWriteByte(u32 address, u8 value)
 #endif
 #endif
 
-extern bool8 stopState;
-extern bool8 holdState;
-extern int32 holdType;
-extern bool8 cpuSramEnabled;
-extern bool8 cpuFlashEnabled;
-extern bool8 cpuEEPROMEnabled;
-extern bool8 cpuEEPROMSensorEnabled;
-extern bool8 cpuDmaHack;
-extern u32	 cpuDmaLast;
-extern int32 cpuDmaCount;
-
-extern int32 cpuTotalTicks;
-extern int32 cpuNextEvent;
-
-extern bool8 timer0On;
-extern int32 timer0Ticks;
-extern int32 timer0ClockReload;
-extern bool8 timer1On;
-extern int32 timer1Ticks;
-extern int32 timer1ClockReload;
-extern bool8 timer2On;
-extern int32 timer2Ticks;
-extern int32 timer2ClockReload;
-extern bool8 timer3On;
-extern int32 timer3Ticks;
-extern int32 timer3ClockReload;
+extern INSTANCE_LOCAL bool8 stopState;
+extern INSTANCE_LOCAL bool8 holdState;
+extern INSTANCE_LOCAL int32 holdType;
+extern INSTANCE_LOCAL bool8 cpuSramEnabled;
+extern INSTANCE_LOCAL bool8 cpuFlashEnabled;
+extern INSTANCE_LOCAL bool8 cpuEEPROMEnabled;
+extern INSTANCE_LOCAL bool8 cpuEEPROMSensorEnabled;
+extern INSTANCE_LOCAL bool8 cpuDmaHack;
+extern INSTANCE_LOCAL u32	 cpuDmaLast;
+extern INSTANCE_LOCAL int32 cpuDmaCount;
+
+extern INSTANCE_LOCAL int32 cpuTotalTicks;
+extern INSTANCE_LOCAL int32 cpuNextEvent;
+
+extern INSTANCE_LOCAL bool8 timer0On;
+extern INSTANCE_LOCAL int32 timer0ClockReload;
+extern INSTANCE_LOCAL bool8 timer1On;
+extern INSTANCE_LOCAL int32 timer1ClockReload;
+extern INSTANCE_LOCAL bool8 timer2On;
+extern INSTANCE_LOCAL int32 timer2ClockReload;
+extern INSTANCE_LOCAL bool8 timer3On;
+extern INSTANCE_LOCAL int32 timer3ClockReload;
 
 extern const u32 objTilesAddress[3];
 
-MemoryMap memoryMap[256];
+INSTANCE_LOCAL MemoryMap memoryMap[256];
 
 u32 CPUReadMemoryWrapped(u32 address)
 {
@@ -167,6 +164,9 @@ u32 CPUReadMemoryWrapped(u32 address)
 	case 4:
 		if ((address < 0x4000400) && ioReadable[address & 0x3fc])
 		{
+			// the channels only update NR52 and the sweep when they catch up
+			if (address >= 0x4000060 && address < 0x4000090)
+				soundCatchUp();
 			if (ioReadable[(address & 0x3fc) + 2])
 			{
 				if (address >= 0x400012d && address <= 0x4000131)
@@ -316,22 +316,25 @@ u32 CPUReadHalfWordWrapped(u32 address)
 	case 4:
 		if ((address < 0x4000400) && ioReadable[address & 0x3fe])
 		{
+			// the channels only update NR52 and the sweep when they catch up
+			if (address >= 0x4000060 && address < 0x4000090)
+				soundCatchUp();
 			if (address >= 0x400012f && address <= 0x4000131)
 				systemCounters.lagged = false;
 			value =  READ16LE(((u16 *)&ioMem[address & 0x3fe]));
 			if (((address & 0x3fe) > 0xFF) && ((address & 0x3fe) < 0x10E))
 			{
 				if (((address & 0x3fe) == 0x100) && timer0On)
-					value = 0xFFFF - ((timer0Ticks - cpuTotalTicks) >> timer0ClockReload);
+					value = 0xFFFF - ((CPUEventTicks(CPU_EVENT_TIMER0) - cpuTotalTicks) >> timer0ClockReload);
 				else
 					if (((address & 0x3fe) == 0x104) && timer1On && !(TM1CNT & 4))
-						value = 0xFFFF - ((timer1Ticks - cpuTotalTicks) >> timer1ClockReload);
+						value = 0xFFFF - ((CPUEventTicks(CPU_EVENT_TIMER1) - cpuTotalTicks) >> timer1ClockReload);
 					else
 						if (((address & 0x3fe) == 0x108) && timer2On && !(TM2CNT & 4))
-							value = 0xFFFF - ((timer2Ticks - cpuTotalTicks) >> timer2ClockReload);
+							value = 0xFFFF - ((CPUEventTicks(CPU_EVENT_TIMER2) - cpuTotalTicks) >> timer2ClockReload);
 						else
 							if (((address & 0x3fe) == 0x10C) && timer3On && !(TM3CNT & 4))
-								value = 0xFFFF - ((timer3Ticks - cpuTotalTicks) >> timer3ClockReload);
+								value = 0xFFFF - ((CPUEventTicks(CPU_EVENT_TIMER3) - cpuTotalTicks) >> timer3ClockReload);
 			}
 		}
 		else
@@ -446,6 +449,9 @@ u8 CPUReadByteWrapped(u32 address)
 	case 4:
 		if ((address < 0x4000400) && ioReadable[address & 0x3ff])
 		{
+			// the channels only update NR52 and the sweep when they catch up
+			if (address >= 0x4000060 && address < 0x4000090)
+				soundCatchUp();
 			if (address == 0x4000130 || address == 0x4000131)
 				systemCounters.lagged = false;
 			return ioMem[address & 0x3ff];
@@ -537,6 +543,8 @@ void CPUWriteMemoryWrapped(u32 address, u32 value)
 	switch (address >> 24)
 	{
 	case 0x02:
+		CPUBlockCacheWrite((address & 0x3FFFF) >> 8);
+		CPUDirtyWrite((address & 0x3FFFF) >> 8);
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u32 *)&freezeWorkRAM[address & 0x3FFFC]))
@@ -547,6 +555,8 @@ void CPUWriteMemoryWrapped(u32 address, u32 value)
 		WRITE32LE(((u32 *)&workRAM[address & 0x3FFFC]), value);
 		break;
 	case 0x03:
+		CPUBlockCacheWrite(CPU_BLOCK_CACHE_IWRAM_BASE + ((address & 0x7FFF) >> 8));
+		CPUDirtyWrite(CPU_BLOCK_CACHE_IWRAM_BASE + ((address & 0x7FFF) >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u32 *)&freezeInternalRAM[address & 0x7ffc]))
@@ -566,6 +576,7 @@ void CPUWriteMemoryWrapped(u32 address, u32 value)
 			goto unwritable;
 		break;
 	case 0x05:
+		CPUDirtyVideoWrite(CPU_DIRTY_PALETTE_RAM + ((address & 0x3FC) >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u32 *)&freezePRAM[address & 0x3fc]))
@@ -581,6 +592,7 @@ void CPUWriteMemoryWrapped(u32 address, u32 value)
 			return;
 		if ((address & 0x18000) == 0x18000)
 			address &= 0x17fff;
+		CPUDirtyVideoWrite(CPU_DIRTY_VRAM + (address >> 8));
 
 #ifdef BKPT_SUPPORT
 #ifdef SDL
@@ -593,6 +605,7 @@ void CPUWriteMemoryWrapped(u32 address, u32 value)
 		WRITE32LE(((u32 *)&vram[address]), value);
 		break;
 	case 0x07:
+		CPUDirtyVideoWrite(CPU_DIRTY_OAM + ((address & 0x3fc) >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u32 *)&freezeOAM[address & 0x3fc]))
@@ -649,6 +662,8 @@ void CPUWriteHalfWordWrapped(u32 address, u16 value)
 	switch (address >> 24)
 	{
 	case 2:
+		CPUBlockCacheWrite((address & 0x3FFFF) >> 8);
+		CPUDirtyWrite((address & 0x3FFFF) >> 8);
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u16 *)&freezeWorkRAM[address & 0x3FFFE]))
@@ -659,6 +674,8 @@ void CPUWriteHalfWordWrapped(u32 address, u16 value)
 		WRITE16LE(((u16 *)&workRAM[address & 0x3FFFE]), value);
 		break;
 	case 3:
+		CPUBlockCacheWrite(CPU_BLOCK_CACHE_IWRAM_BASE + ((address & 0x7FFF) >> 8));
+		CPUDirtyWrite(CPU_BLOCK_CACHE_IWRAM_BASE + ((address & 0x7FFF) >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u16 *)&freezeInternalRAM[address & 0x7ffe]))
@@ -675,6 +692,7 @@ void CPUWriteHalfWordWrapped(u32 address, u16 value)
 			goto unwritable;
 		break;
 	case 5:
+		CPUDirtyVideoWrite(CPU_DIRTY_PALETTE_RAM + ((address & 0x3fe) >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u16 *)&freezePRAM[address & 0x03fe]))
@@ -690,6 +708,7 @@ void CPUWriteHalfWordWrapped(u32 address, u16 value)
 			return;
 		if ((address & 0x18000) == 0x18000)
 			address &= 0x17fff;
+		CPUDirtyVideoWrite(CPU_DIRTY_VRAM + (address >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u16 *)&freezeVRAM[address]))
@@ -700,6 +719,7 @@ void CPUWriteHalfWordWrapped(u32 address, u16 value)
 		WRITE16LE(((u16 *)&vram[address]), value);
 		break;
 	case 7:
+		CPUDirtyVideoWrite(CPU_DIRTY_OAM + ((address & 0x3fe) >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (*((u16 *)&freezeOAM[address & 0x03fe]))
@@ -753,6 +773,8 @@ void CPUWriteByteWrapped(u32 address, u8 b)
 	switch (address >> 24)
 	{
 	case 2:
+		CPUBlockCacheWrite((address & 0x3FFFF) >> 8);
+		CPUDirtyWrite((address & 0x3FFFF) >> 8);
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (freezeWorkRAM[address & 0x3FFFF])
@@ -763,6 +785,8 @@ void CPUWriteByteWrapped(u32 address, u8 b)
 		workRAM[address & 0x3FFFF] = b;
 		break;
 	case 3:
+		CPUBlockCacheWrite(CPU_BLOCK_CACHE_IWRAM_BASE + ((address & 0x7FFF) >> 8));
+		CPUDirtyWrite(CPU_BLOCK_CACHE_IWRAM_BASE + ((address & 0x7FFF) >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 		if (freezeInternalRAM[address & 0x7fff])
@@ -821,7 +845,10 @@ void CPUWriteByteWrapped(u32 address, u8 b)
 				break;
 			case 0x301: // HALTCNT, undocumented
 				if (b == 0x80)
+				{
+					soundCatchUp();
 					stopState = true;
+				}
 				holdState	 = true;
 				holdType	 = -1;
 				cpuNextEvent = cpuTotalTicks;
@@ -844,6 +871,7 @@ void CPUWriteByteWrapped(u32 address, u8 b)
 		break;
 	case 5:
 		// no need to switch
+		CPUDirtyVideoWrite(CPU_DIRTY_PALETTE_RAM + ((address & 0x3FE) >> 8));
 		*((u16 *)&paletteRAM[address & 0x3FE]) = (b << 8) | b;
 		break;
 	case 6:
@@ -857,6 +885,7 @@ void CPUWriteByteWrapped(u32 address, u8 b)
 		// byte writes to OBJ VRAM are ignored
 		if ((address) < objTilesAddress[((DISPCNT & 7) + 1) >> 2])
 		{
+			CPUDirtyVideoWrite(CPU_DIRTY_VRAM + (address >> 8));
 #ifdef BKPT_SUPPORT
 #ifdef SDL
 			if (freezeVRAM[address])
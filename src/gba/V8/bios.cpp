@@ -7,6 +7,142 @@
 #include "../GBA.h"
 #include "../GBAinline.h"
 #include "../GBAGlobals.h"
+#include "../../common/vbalua.h"
+
+// A plain memory region resolved once through memoryMap, so that the
+// copy and decompression functions can access it directly on the host.
+// Addresses outside of it still go through CPURead*/CPUWrite*.
+struct BIOSMemory
+{
+	u8 *host;
+	u32 start;
+	u32 size;
+};
+
+enum
+{
+	BIOS_READ,
+	BIOS_WRITE,
+	BIOS_WRITE_BYTE
+};
+
+static void BIOSMapMemory(BIOSMemory &memory, u32 address, u32 size, int access)
+{
+	memory.host	 = NULL;
+	memory.start = 0;
+	memory.size	 = 0;
+
+	// frozen addresses are written through the cheat functions
+#if !(defined(BKPT_SUPPORT) && defined(SDL))
+	if (VBALuaHasMemHook(LUAMEMHOOK_READ) || VBALuaHasMemHook(LUAMEMHOOK_WRITE))
+		return;
+
+	u32 region = address >> 24;
+	switch (region)
+	{
+	case 2:
+	case 3:
+		break;
+	case 5:
+	case 6:
+	case 7:
+		// byte writes are duplicated or ignored there
+		if (access == BIOS_WRITE_BYTE)
+			return;
+		break;
+	case 8:
+	case 9:
+	case 10:
+	case 12:
+		if (access != BIOS_READ)
+			return;
+		break;
+	default:
+		return;
+	}
+
+	memory.host	 = memoryMap[region].address;
+	memory.start = address & ~memoryMap[region].mask;
+	memory.size	 = memoryMap[region].mask + 1;
+
+	if (region == 6)
+	{
+		// the last 32K are mirrored and partly unwritable in bitmap modes
+		memory.size = 0x18000;
+	}
+	else if (region == 8)
+	{
+		// halfword reads of 0x80000c4-0x80000c9 go to the RTC
+		memory.host	 += 0xCC;
+		memory.start += 0xCC;
+		memory.size	 -= 0xCC;
+	}
+	else if (region == 12)
+	{
+		// 0x0D000000 up is the EEPROM window
+		memory.size = 0x1000000;
+	}
+
+	if (access != BIOS_READ)
+	{
+		// mark everything the caller may write up front
+		u32 offset = address - memory.start;
+		if (offset < memory.size)
+			CPUExternalWrite(address, size < memory.size - offset ? size : memory.size - offset);
+	}
+#endif
+}
+
+static inline u8 BIOSReadByte(const BIOSMemory &memory, u32 address)
+{
+	u32 offset = address - memory.start;
+	if (offset < memory.size)
+		return memory.host[offset];
+	return CPUReadByte(address);
+}
+
+static inline u16 BIOSReadHalfWord(const BIOSMemory &memory, u32 address)
+{
+	u32 offset = address - memory.start;
+	if (!(address & 1) && offset < memory.size)
+		return READ16LE(&memory.host[offset]);
+	return CPUReadHalfWord(address);
+}
+
+static inline u32 BIOSReadMemory(const BIOSMemory &memory, u32 address)
+{
+	u32 offset = address - memory.start;
+	if (!(address & 3) && offset < memory.size)
+		return READ32LE(&memory.host[offset]);
+	return CPUReadMemory(address);
+}
+
+static inline void BIOSWriteByte(const BIOSMemory &memory, u32 address, u8 b)
+{
+	u32 offset = address - memory.start;
+	if (offset < memory.size)
+		memory.host[offset] = b;
+	else
+		CPUWriteByte(address, b);
+}
+
+static inline void BIOSWriteHalfWord(const BIOSMemory &memory, u32 address, u16 value)
+{
+	u32 offset = (address & ~1) - memory.start;
+	if (offset < memory.size)
+		WRITE16LE(&memory.host[offset], value);
+	else
+		CPUWriteHalfWord(address, value);
+}
+
+static inline void BIOSWriteMemory(const BIOSMemory &memory, u32 address, u32 value)
+{
+	u32 offset = (address & ~3) - memory.start;
+	if (offset < memory.size)
+		WRITE32LE(&memory.host[offset], value);
+	else
+		CPUWriteMemory(address, value);
+}
 
 s16 sineTable[256] = {
 	(s16)0x0000, (s16)0x0192, (s16)0x0323, (s16)0x04B5, (s16)0x0645, (s16)0x07D5, (s16)0x0964, (s16)0x0AF1,
@@ -283,6 +419,11 @@ void BIOS_CpuSet()
 		return;
 
 	int count = cnt & 0x1FFFFF;
+	u32 unit  = ((cnt >> 26) & 1) ? 4 : 2;
+
+	BIOSMemory from, to;
+	BIOSMapMemory(from, source, 0, BIOS_READ);
+	BIOSMapMemory(to, dest & ~(unit - 1), count * unit, BIOS_WRITE);
 
 	// 32-bit ?
 	if ((cnt >> 26) & 1)
@@ -293,10 +434,10 @@ void BIOS_CpuSet()
 		// fill ?
 		if ((cnt >> 24) & 1)
 		{
-			u32 value = (source > 0x0EFFFFFF ? 0x1CAD1CAD : CPUReadMemory(source));
+			u32 value = (source > 0x0EFFFFFF ? 0x1CAD1CAD : BIOSReadMemory(from, source));
 			while (count)
 			{
-				CPUWriteMemory(dest, value);
+				BIOSWriteMemory(to, dest, value);
 				dest += 4;
 				count--;
 			}
@@ -306,7 +447,7 @@ void BIOS_CpuSet()
 			// copy
 			while (count)
 			{
-				CPUWriteMemory(dest, (source > 0x0EFFFFFF ? 0x1CAD1CAD : CPUReadMemory(source)));
+				BIOSWriteMemory(to, dest, (source > 0x0EFFFFFF ? 0x1CAD1CAD : BIOSReadMemory(from, source)));
 				source += 4;
 				dest   += 4;
 				count--;
@@ -318,10 +459,10 @@ void BIOS_CpuSet()
 		// 16-bit fill?
 		if ((cnt >> 24) & 1)
 		{
-			u16 value = (source > 0x0EFFFFFF ? 0x1CAD : CPUReadHalfWord(source));
+			u16 value = (source > 0x0EFFFFFF ? 0x1CAD : BIOSReadHalfWord(from, source));
 			while (count)
 			{
-				CPUWriteHalfWord(dest, value);
+				BIOSWriteHalfWord(to, dest, value);
 				dest += 2;
 				count--;
 			}
@@ -331,7 +472,7 @@ void BIOS_CpuSet()
 			// copy
 			while (count)
 			{
-				CPUWriteHalfWord(dest, (source > 0x0EFFFFFF ? 0x1CAD : CPUReadHalfWord(source)));
+				BIOSWriteHalfWord(to, dest, (source > 0x0EFFFFFF ? 0x1CAD : BIOSReadHalfWord(from, source)));
 				source += 2;
 				dest   += 2;
 				count--;
@@ -364,16 +505,20 @@ void BIOS_CpuFastSet()
 
 	int count = cnt & 0x1FFFFF;
 
+	BIOSMemory from, to;
+	BIOSMapMemory(from, source, 0, BIOS_READ);
+	BIOSMapMemory(to, dest, ((count + 7) & ~7) << 2, BIOS_WRITE);
+
 	// fill?
 	if ((cnt >> 24) & 1)
 	{
 		while (count > 0)
 		{
 			// BIOS always transfers 32 bytes at a time
-			u32 value = (source > 0x0EFFFFFF ? 0xBAFFFFFB : CPUReadMemory(source));
+			u32 value = (source > 0x0EFFFFFF ? 0xBAFFFFFB : BIOSReadMemory(from, source));
 			for (int i = 0; i < 8; i++)
 			{
-				CPUWriteMemory(dest, value);
+				BIOSWriteMemory(to, dest, value);
 				dest += 4;
 			}
 			count -= 8;
@@ -387,7 +532,7 @@ void BIOS_CpuFastSet()
 			// BIOS always transfers 32 bytes at a time
 			for (int i = 0; i < 8; i++)
 			{
-				CPUWriteMemory(dest, (source > 0x0EFFFFFF ? 0xBAFFFFFB : CPUReadMemory(source)));
+				BIOSWriteMemory(to, dest, (source > 0x0EFFFFFF ? 0xBAFFFFFB : BIOSReadMemory(from, source)));
 				source += 4;
 				dest   += 4;
 			}
@@ -588,20 +733,24 @@ void BIOS_HuffUnComp()
 	    ((source + ((header >> 8) & 0x1fffff)) & 0xe000000) == 0)
 		return;
 
-	u8 treeSize = CPUReadByte(source++);
+	int len = header >> 8;
+
+	BIOSMemory from, to;
+	BIOSMapMemory(from, source, 0, BIOS_READ);
+	BIOSMapMemory(to, dest & ~3, (len + 3) & ~3, BIOS_WRITE);
+
+	u8 treeSize = BIOSReadByte(from, source++);
 
 	u32 treeStart = source;
 
 	source += ((treeSize + 1) << 1) - 1; // minus because we already skipped one byte
 
-	int len = header >> 8;
-
 	u32 mask = 0x80000000;
-	u32 data = CPUReadMemory(source);
+	u32 data = BIOSReadMemory(from, source);
 	source += 4;
 
 	int	 pos		 = 0;
-	u8	 rootNode	 = CPUReadByte(treeStart);
+	u8	 rootNode	 = BIOSReadByte(from, treeStart);
 	u8	 currentNode = rootNode;
 	bool writeData	 = false;
 	int	 byteShift	 = 0;
@@ -623,14 +772,14 @@ void BIOS_HuffUnComp()
 				// right
 				if (currentNode & 0x40)
 					writeData = true;
-				currentNode = CPUReadByte(treeStart + pos + 1);
+				currentNode = BIOSReadByte(from, treeStart + pos + 1);
 			}
 			else
 			{
 				// left
 				if (currentNode & 0x80)
 					writeData = true;
-				currentNode = CPUReadByte(treeStart + pos);
+				currentNode = BIOSReadByte(from, treeStart + pos);
 			}
 
 			if (writeData)
@@ -647,7 +796,7 @@ void BIOS_HuffUnComp()
 				{
 					byteCount = 0;
 					byteShift = 0;
-					CPUWriteMemory(dest, writeValue);
+					BIOSWriteMemory(to, dest, writeValue);
 					writeValue = 0;
 					dest	  += 4;
 					len		  -= 4;
@@ -657,7 +806,7 @@ void BIOS_HuffUnComp()
 			if (mask == 0)
 			{
 				mask	= 0x80000000;
-				data	= CPUReadMemory(source);
+				data	= BIOSReadMemory(from, source);
 				source += 4;
 			}
 		}
@@ -679,14 +828,14 @@ void BIOS_HuffUnComp()
 				// right
 				if (currentNode & 0x40)
 					writeData = true;
-				currentNode = CPUReadByte(treeStart + pos + 1);
+				currentNode = BIOSReadByte(from, treeStart + pos + 1);
 			}
 			else
 			{
 				// left
 				if (currentNode & 0x80)
 					writeData = true;
-				currentNode = CPUReadByte(treeStart + pos);
+				currentNode = BIOSReadByte(from, treeStart + pos);
 			}
 
 			if (writeData)
@@ -710,7 +859,7 @@ void BIOS_HuffUnComp()
 					{
 						byteCount = 0;
 						byteShift = 0;
-						CPUWriteMemory(dest, writeValue);
+						BIOSWriteMemory(to, dest, writeValue);
 						dest	  += 4;
 						writeValue = 0;
 						len		  -= 4;
@@ -724,7 +873,7 @@ void BIOS_HuffUnComp()
 			if (mask == 0)
 			{
 				mask	= 0x80000000;
-				data	= CPUReadMemory(source);
+				data	= BIOSReadMemory(from, source);
 				source += 4;
 			}
 		}
@@ -753,15 +902,19 @@ void BIOS_LZ77UnCompVram()
 	    ((source + ((header >> 8) & 0x1fffff)) & 0xe000000) == 0)
 		return;
 
+	int len = header >> 8;
+
+	BIOSMemory from, to;
+	BIOSMapMemory(from, source, 0, BIOS_READ);
+	BIOSMapMemory(to, dest & ~1, len + 1, BIOS_WRITE);
+
 	int byteCount  = 0;
 	int byteShift  = 0;
 	u32 writeValue = 0;
 
-	int len = header >> 8;
-
 	while (len > 0)
 	{
-		u8 d = CPUReadByte(source++);
+		u8 d = BIOSReadByte(from, source++);
 
 		if (d)
 		{
@@ -769,20 +922,20 @@ void BIOS_LZ77UnCompVram()
 			{
 				if (d & 0x80)
 				{
-					u16 data = CPUReadByte(source++) << 8;
-					data |= CPUReadByte(source++);
+					u16 data = BIOSReadByte(from, source++) << 8;
+					data |= BIOSReadByte(from, source++);
 					int length		 = (data >> 12) + 3;
 					int offset		 = (data & 0x0FFF);
 					u32 windowOffset = dest + byteCount - offset - 1;
 					for (int j = 0; j < length; j++)
 					{
-						writeValue |= (CPUReadByte(windowOffset++) << byteShift);
+						writeValue |= (BIOSReadByte(to, windowOffset++) << byteShift);
 						byteShift  += 8;
 						byteCount++;
 
 						if (byteCount == 2)
 						{
-							CPUWriteHalfWord(dest, writeValue);
+							BIOSWriteHalfWord(to, dest, writeValue);
 							dest	  += 2;
 							byteCount  = 0;
 							byteShift  = 0;
@@ -795,12 +948,12 @@ void BIOS_LZ77UnCompVram()
 				}
 				else
 				{
-					writeValue |= (CPUReadByte(source++) << byteShift);
+					writeValue |= (BIOSReadByte(from, source++) << byteShift);
 					byteShift  += 8;
 					byteCount++;
 					if (byteCount == 2)
 					{
-						CPUWriteHalfWord(dest, writeValue);
+						BIOSWriteHalfWord(to, dest, writeValue);
 						dest	  += 2;
 						byteCount  = 0;
 						byteShift  = 0;
@@ -817,12 +970,12 @@ void BIOS_LZ77UnCompVram()
 		{
 			for (int i = 0; i < 8; i++)
 			{
-				writeValue |= (CPUReadByte(source++) << byteShift);
+				writeValue |= (BIOSReadByte(from, source++) << byteShift);
 				byteShift  += 8;
 				byteCount++;
 				if (byteCount == 2)
 				{
-					CPUWriteHalfWord(dest, writeValue);
+					BIOSWriteHalfWord(to, dest, writeValue);
 					dest	  += 2;
 					byteShift  = 0;
 					byteCount  = 0;
@@ -858,9 +1011,13 @@ void BIOS_LZ77UnCompWram()
 
 	int len = header >> 8;
 
+	BIOSMemory from, to;
+	BIOSMapMemory(from, source, 0, BIOS_READ);
+	BIOSMapMemory(to, dest, len, BIOS_WRITE_BYTE);
+
 	while (len > 0)
 	{
-		u8 d = CPUReadByte(source++);
+		u8 d = BIOSReadByte(from, source++);
 
 		if (d)
 		{
@@ -868,14 +1025,14 @@ void BIOS_LZ77UnCompWram()
 			{
 				if (d & 0x80)
 				{
-					u16 data = CPUReadByte(source++) << 8;
-					data |= CPUReadByte(source++);
+					u16 data = BIOSReadByte(from, source++) << 8;
+					data |= BIOSReadByte(from, source++);
 					int length		 = (data >> 12) + 3;
 					int offset		 = (data & 0x0FFF);
 					u32 windowOffset = dest - offset - 1;
 					for (int j = 0; j < length; j++)
 					{
-						CPUWriteByte(dest++, CPUReadByte(windowOffset++));
+						BIOSWriteByte(to, dest++, BIOSReadByte(to, windowOffset++));
 						len--;
 						if (len == 0)
 							return;
@@ -883,7 +1040,7 @@ void BIOS_LZ77UnCompWram()
 				}
 				else
 				{
-					CPUWriteByte(dest++, CPUReadByte(source++));
+					BIOSWriteByte(to, dest++, BIOSReadByte(from, source++));
 					len--;
 					if (len == 0)
 						return;
@@ -895,7 +1052,7 @@ void BIOS_LZ77UnCompWram()
 		{
 			for (int i = 0; i < 8; i++)
 			{
-				CPUWriteByte(dest++, CPUReadByte(source++));
+				BIOSWriteByte(to, dest++, BIOSReadByte(from, source++));
 				len--;
 				if (len == 0)
 					return;
@@ -964,26 +1121,31 @@ void BIOS_RegisterRamReset(u32 flags)
 		{
 			// clear work RAM
 			memset(workRAM, 0, 0x40000);
+			CPUExternalWrite(0x02000000, 0x40000);
 		}
 		if (flags & 0x02)
 		{
 			// clear internal RAM
 			memset(internalRAM, 0, 0x7e00); // don't clear 0x7e00-0x7fff
+			CPUExternalWrite(0x03000000, 0x7e00);
 		}
 		if (flags & 0x04)
 		{
 			// clear palette RAM
 			memset(paletteRAM, 0, 0x400);
+			CPUExternalWrite(0x05000000, 0x400);
 		}
 		if (flags & 0x08)
 		{
 			// clear VRAM
 			memset(vram, 0, 0x18000);
+			CPUExternalWrite(0x06000000, 0x18000);
 		}
 		if (flags & 0x10)
 		{
 			// clean OAM
 			memset(oam, 0, 0x400);
+			CPUExternalWrite(0x07000000, 0x400);
 		}
 
 		if (flags & 0x80)
@@ -1077,13 +1239,17 @@ void BIOS_RLUnCompVram()
 	int byteShift  = 0;
 	u32 writeValue = 0;
 
+	BIOSMemory from, to;
+	BIOSMapMemory(from, source, 0, BIOS_READ);
+	BIOSMapMemory(to, dest & ~1, len + 1, BIOS_WRITE);
+
 	while (len > 0)
 	{
-		u8	d = CPUReadByte(source++);
+		u8	d = BIOSReadByte(from, source++);
 		int l = d & 0x7F;
 		if (d & 0x80)
 		{
-			u8 data = CPUReadByte(source++);
+			u8 data = BIOSReadByte(from, source++);
 			l += 3;
 			for (int i = 0; i < l; i++)
 			{
@@ -1093,7 +1259,7 @@ void BIOS_RLUnCompVram()
 
 				if (byteCount == 2)
 				{
-					CPUWriteHalfWord(dest, writeValue);
+					BIOSWriteHalfWord(to, dest, writeValue);
 					dest	  += 2;
 					byteCount  = 0;
 					byteShift  = 0;
@@ -1109,12 +1275,12 @@ void BIOS_RLUnCompVram()
 			l++;
 			for (int i = 0; i < l; i++)
 			{
-				writeValue |= (CPUReadByte(source++) << byteShift);
+				writeValue |= (BIOSReadByte(from, source++) << byteShift);
 				byteShift  += 8;
 				byteCount++;
 				if (byteCount == 2)
 				{
-					CPUWriteHalfWord(dest, writeValue);
+					BIOSWriteHalfWord(to, dest, writeValue);
 					dest	  += 2;
 					byteCount  = 0;
 					byteShift  = 0;
@@ -1152,17 +1318,21 @@ void BIOS_RLUnCompWram()
 
 	int len = header >> 8;
 
+	BIOSMemory from, to;
+	BIOSMapMemory(from, source, 0, BIOS_READ);
+	BIOSMapMemory(to, dest, len, BIOS_WRITE_BYTE);
+
 	while (len > 0)
 	{
-		u8	d = CPUReadByte(source++);
+		u8	d = BIOSReadByte(from, source++);
 		int l = d & 0x7F;
 		if (d & 0x80)
 		{
-			u8 data = CPUReadByte(source++);
+			u8 data = BIOSReadByte(from, source++);
 			l += 3;
 			for (int i = 0; i < l; i++)
 			{
-				CPUWriteByte(dest++, data);
+				BIOSWriteByte(to, dest++, data);
 				len--;
 				if (len == 0)
 					return;
@@ -1173,7 +1343,7 @@ void BIOS_RLUnCompWram()
 			l++;
 			for (int i = 0; i < l; i++)
 			{
-				CPUWriteByte(dest++,  CPUReadByte(source++));
+				BIOSWriteByte(to, dest++, BIOSReadByte(from, source++));
 				len--;
 				if (len == 0)
 					return;
@@ -1207,6 +1377,7 @@ void BIOS_SoftReset()
 	u8 b = internalRAM[0x7ffa];
 
 	memset(&internalRAM[0x7e00], 0, 0x200);
+	CPUExternalWrite(0x03007e00, 0x200);
 
 	if (b)
 	{
@@ -221,27 +221,27 @@ struct ELFFrameState
 	int returnAddress;
 };
 
-bool8 cpuIsMultiBoot = false;
-bool8 parseDebug	 = true;
+INSTANCE_LOCAL bool8 cpuIsMultiBoot = false;
+INSTANCE_LOCAL bool8 parseDebug	 = true;
 
-Symbol *elfSymbols		 = NULL;
-char *	elfSymbolsStrTab = NULL;
-int		elfSymbolsCount	 = 0;
+INSTANCE_LOCAL Symbol *elfSymbols		 = NULL;
+INSTANCE_LOCAL char *	elfSymbolsStrTab = NULL;
+INSTANCE_LOCAL int		elfSymbolsCount	 = 0;
 
-ELFSectionHeader * *elfSectionHeaders = NULL;
-char *elfSectionHeadersStringTable	  = NULL;
-int	  elfSectionHeadersCount = 0;
-u8 *  elfFileData = NULL;
+INSTANCE_LOCAL ELFSectionHeader * *elfSectionHeaders = NULL;
+INSTANCE_LOCAL char *elfSectionHeadersStringTable	  = NULL;
+INSTANCE_LOCAL int	  elfSectionHeadersCount = 0;
+INSTANCE_LOCAL u8 *  elfFileData = NULL;
 
-CompileUnit *elfCompileUnits = NULL;
-DebugInfo *	 elfDebugInfo	 = NULL;
-char *		 elfDebugStrings = NULL;
+INSTANCE_LOCAL CompileUnit *elfCompileUnits = NULL;
+INSTANCE_LOCAL DebugInfo *	 elfDebugInfo	 = NULL;
+INSTANCE_LOCAL char *		 elfDebugStrings = NULL;
 
-ELFcie *  elfCies	  = NULL;
-ELFfde * *elfFdes	  = NULL;
-int		  elfFdeCount = 0;
+INSTANCE_LOCAL ELFcie *  elfCies	  = NULL;
+INSTANCE_LOCAL ELFfde * *elfFdes	  = NULL;
+INSTANCE_LOCAL int		  elfFdeCount = 0;
 
-CompileUnit *elfCurrentUnit = NULL;
+INSTANCE_LOCAL CompileUnit *elfCurrentUnit = NULL;
 
 u32 elfRead4Bytes(u8 *);
 u16 elfRead2Bytes(u8 *);
@@ -279,7 +279,7 @@ CompileUnit *elfGetCompileUnit(u32 addr)
 
 const char *elfGetAddressSymbol(u32 addr)
 {
-	static char buffer[256];
+	static INSTANCE_LOCAL char buffer[256];
 
 	CompileUnit *unit = elfGetCompileUnit(addr);
 	// found unit, need to find function
@@ -3013,7 +3013,7 @@ end:
 	return true;
 }
 
-extern bool8 parseDebug;
+extern INSTANCE_LOCAL bool8 parseDebug;
 
 bool elfRead(const char *name, int &siz, FILE *f)
 {
@@ -343,6 +343,9 @@ void remoteBinaryWrite(char *p)
 
 	p = strchr(p, ':');
 	p++;
+#ifndef USE_GBA_CORE_V7
+	CPUExternalWrite(address, count);
+#endif
 	for (int i = 0; i < count; i++)
 	{
 		u8 b = *p++;
@@ -372,6 +375,9 @@ void remoteMemoryWrite(char *p)
 
 	p = strchr(p, ':');
 	p++;
+#ifndef USE_GBA_CORE_V7
+	CPUExternalWrite(address, count);
+#endif
 	for (int i = 0; i < count; i++)
 	{
 		u8	 v = 0;
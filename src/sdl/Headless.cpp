@@ -0,0 +1,711 @@
+// VisualBoyAdvance - Nintendo Gameboy/GameboyAdvance (TM) emulator.
+// Copyright (C) 1999-2003 Forgotten
+// Copyright (C) 2004 Forgotten and the VBA development team
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2, or(at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+// vba-headless: runs a ROM without any window or audio device, optionally
+// playing back a movie, and prints CRC32 hashes of RAM, screen and audio at
+// a fixed frame interval.  The output of one run can be fed back with
+// --compare to detect desyncs between builds.
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#ifdef MULTI_INSTANCE
+#include <thread>
+#include <vector>
+#endif
+
+#include "Port.h"
+#include "gba/GBA.h"
+#include "gba/GBAGlobals.h"
+#include "gba/Flash.h"
+#include "gba/RTC.h"
+#include "gb/GB.h"
+#include "gb/gbGlobals.h"
+#include "common/Util.h"
+#include "common/movie.h"
+#include "common/System.h"
+#include "common/SystemGlobals.h"
+
+#ifndef __GNUC__
+# define HAVE_DECL_GETOPT 0
+# define __STDC__ 1
+# include "getopt.h"
+#else // ! __GNUC__
+# define HAVE_DECL_GETOPT 1
+# include "getopt.h"
+#endif // ! __GNUC__
+
+enum
+{
+	HEADLESS_EXIT_OK	  = 0,
+	HEADLESS_EXIT_LOAD	  = 1,
+	HEADLESS_EXIT_MOVIE	  = 2,
+	HEADLESS_EXIT_DESYNC  = 3
+};
+
+enum
+{
+	HEADLESS_HASH_RAM	 = 1,
+	HEADLESS_HASH_SCREEN = 2,
+	HEADLESS_HASH_AUDIO	 = 4
+};
+
+// settings the core and common/movie.cpp expect from the SDL frontend
+INSTANCE_LOCAL int systemCartridgeType = IMAGE_UNKNOWN;
+INSTANCE_LOCAL int systemSaveUpdateCounter = SYSTEM_SAVE_NOT_UPDATED;
+
+int	 systemSpeed	  = 0;
+bool systemSoundOn	  = false;
+u16	 systemColorMap16[0x10000];
+u32	 systemColorMap32[0x10000];
+u16	 systemGbPalette[24];
+int	 systemRedShift	  = 19;
+int	 systemGreenShift = 11;
+int	 systemBlueShift  = 3;
+int	 systemColorDepth = 32;
+int	 systemDebug	  = 0;
+int	 systemVerbose	  = 0;
+int	 systemFrameSkip  = 0;
+int	 RGB_LOW_BITS_MASK = 0x821;
+
+bool8 removeIntros = false;
+int	  sdlFlashSize = 0;
+int	  sdlRtcEnable = 0;
+
+char filename[2048];
+char saveDir[2048];
+char batteryDir[2048];
+
+static void headlessDebugOutput(const char *s, u32 addr);
+static void headlessDebugSignal(int sig, int number);
+
+void (*dbgSignal)(int, int) = headlessDebugSignal;
+void (*dbgOutput)(const char *, u32) = headlessDebugOutput;
+
+static INSTANCE_LOCAL int  headlessFrame	   = 0;
+static INSTANCE_LOCAL int  headlessFrameLimit  = 0;
+static INSTANCE_LOCAL int  headlessInterval	   = 0;
+static INSTANCE_LOCAL int  headlessHashes	   = 0;
+static INSTANCE_LOCAL bool headlessDrawFrame   = false;
+static INSTANCE_LOCAL u32  headlessAudioCrc	   = 0;
+static INSTANCE_LOCAL FILE *headlessOutput	   = NULL;
+static INSTANCE_LOCAL FILE *headlessReference  = NULL;
+static INSTANCE_LOCAL bool headlessDesynced	   = false;
+static INSTANCE_LOCAL bool headlessMovie	   = false;
+static INSTANCE_LOCAL u32  headlessReportCrc   = 0; // of every line reported
+
+static struct option headlessOptions[] =
+{
+	{ "audio",	  no_argument,		 0, 'a' },
+	{ "bios",	  required_argument, 0, 'b' },
+	{ "compare",  required_argument, 0, 'c' },
+	{ "frames",	  required_argument, 0, 'f' },
+	{ "help",	  no_argument,		 0, 'h' },
+	{ "interval", required_argument, 0, 'i' },
+	{ "movie",	  required_argument, 0, 'm' },
+	{ "instances", required_argument, 0, 'n' },
+	{ "output",	  required_argument, 0, 'o' },
+	{ "ram",	  no_argument,		 0, 'r' },
+	{ "screen",	  no_argument,		 0, 's' },
+	{ "render-thread", no_argument,	 0, 't' },
+	{ "verbose",  no_argument,		 0, 'v' },
+	{ NULL,		  no_argument,		 NULL, 0 }
+};
+
+static void usage(const char *cmd)
+{
+	printf("Usage: %s [options] rom-file\n\n", cmd);
+	printf("Options:\n"
+	       "  -a, --audio          hash the mixed audio output (synthesizes the sound)\n"
+	       "  -b, --bios=FILE      use the given GBA BIOS file\n"
+	       "  -c, --compare=FILE   compare the hashes against a previous output, exit %d on mismatch\n"
+	       "  -f, --frames=N       stop after N frames\n"
+	       "  -h, --help           print this help\n"
+	       "  -i, --interval=N     print the hashes every N frames (default: only at the end)\n"
+	       "  -m, --movie=FILE     play back a movie, stopping when it ends\n"
+	       "  -n, --instances=N    also run N-1 more copies on their own threads, exit %d unless\n"
+	       "                       they all report the same hashes (MULTI_INSTANCE builds)\n"
+	       "  -o, --output=FILE    write the hashes to FILE instead of stdout\n"
+	       "  -r, --ram            hash work RAM (default when no hash is selected)\n"
+	       "  -s, --screen         hash the screen (enables rendering of the hashed frames)\n"
+	       "  -t, --render-thread  draw the GBA screen on a second thread (MULTI_INSTANCE builds)\n"
+	       "  -v, --verbose        print the run time to stderr\n",
+	       HEADLESS_EXIT_DESYNC, HEADLESS_EXIT_DESYNC);
+}
+
+static u32 headlessHashRAM()
+{
+	u32 crc = crc32(0L, Z_NULL, 0);
+	if (systemCartridgeType == IMAGE_GBA)
+	{
+		crc = crc32(crc, workRAM, 0x40000);
+		crc = crc32(crc, internalRAM, 0x8000);
+	}
+	else
+	{
+		if (gbWram != NULL)
+			crc = crc32(crc, gbWram, 0x8000);
+		else
+			crc = crc32(crc, gbMemory + 0xc000, 0x2000);
+		crc = crc32(crc, gbMemory + 0xff80, 0x80);
+	}
+	return crc;
+}
+
+static u32 headlessHashScreen()
+{
+	u32 size = systemCartridgeType == IMAGE_GBA ? pixBufferSize : gbPixBufferSize;
+	return crc32(crc32(0L, Z_NULL, 0), pix, size);
+}
+
+static void headlessReport()
+{
+	char line[128];
+	int	 len = sprintf(line, "frame %d", headlessFrame);
+	if (headlessHashes & HEADLESS_HASH_RAM)
+		len += sprintf(line + len, " ram %08x", headlessHashRAM());
+	if (headlessHashes & HEADLESS_HASH_SCREEN)
+		len += sprintf(line + len, " screen %08x", headlessHashScreen());
+	if (headlessHashes & HEADLESS_HASH_AUDIO)
+		len += sprintf(line + len, " audio %08x", headlessAudioCrc);
+
+	headlessReportCrc = crc32(headlessReportCrc, (const Bytef *)line, len);
+	if (headlessOutput)
+		fprintf(headlessOutput, "%s\n", line);
+
+	if (headlessReference && !headlessDesynced)
+	{
+		char expected[128];
+		if (!fgets(expected, sizeof(expected), headlessReference))
+		{
+			fprintf(stderr, "Reference ended before frame %d\n", headlessFrame);
+			headlessDesynced = true;
+			return;
+		}
+
+		expected[strcspn(expected, "\r\n")] = '\0';
+		if (strcmp(expected, line))
+		{
+			fprintf(stderr, "Desync at frame %d\n  expected: %s\n  got:      %s\n", headlessFrame, expected, line);
+			headlessDesynced = true;
+		}
+	}
+}
+
+static bool headlessNeedsReport(int frame)
+{
+	if (frame == headlessFrameLimit)
+		return true;
+	return headlessInterval > 0 && frame % headlessInterval == 0;
+}
+
+static bool headlessFinished()
+{
+	if (headlessFrameLimit > 0 && headlessFrame >= headlessFrameLimit)
+		return true;
+	return headlessMovie && !VBAMovieIsPlaying();
+}
+
+static bool headlessLoadRom(const char *szFile, const char *biosFileName, bool useBiosFile)
+{
+	IMAGE_TYPE type = utilFindType(szFile);
+	if (type == IMAGE_UNKNOWN)
+	{
+		systemMessage(0, "Unknown file type %s", szFile);
+		return false;
+	}
+
+	systemCartridgeType = (int)type;
+	if (type == IMAGE_GB)
+	{
+		if (!gbLoadRom(szFile))
+			return false;
+
+		theEmulator = GBSystem;
+		useBios		= false;
+	}
+	else
+	{
+		if (CPULoadRom(szFile) == 0)
+			return false;
+
+		theEmulator = GBASystem;
+		CPUInit();
+		systemLoadBIOS(biosFileName, useBiosFile);
+		CPUReset();
+	}
+
+	return true;
+}
+
+// without an audio hash the GBA APU still runs, for the registers games read
+// back, but nothing is synthesized
+static void headlessStart()
+{
+	soundSilent = !systemSoundOn;
+	if (systemSoundOn)
+		systemSoundCleanInit();
+
+	emulating = 1;
+}
+
+// Runs until the frame limit or the end of the movie, returns the time taken
+static u32 headlessRun()
+{
+	headlessDrawFrame = (headlessHashes & HEADLESS_HASH_SCREEN) && headlessNeedsReport(1);
+
+	u32 startTime = systemGetClock();
+	while (!headlessFinished())
+	{
+		theEmulator.emuMain(theEmulator.emuCount);
+	}
+	u32 elapsed = systemGetClock() - startTime;
+
+	// a movie may end in the middle of an interval
+	if (!headlessNeedsReport(headlessFrame))
+		headlessReport();
+
+	return elapsed;
+}
+
+#ifdef MULTI_INSTANCE
+// One more copy of the emulation, run on its own thread with the settings of
+// the main one; its hashes are only compared, not printed
+struct HeadlessInstance
+{
+	const char *romName;
+	const char *biosFileName;
+	bool		useBiosFile;
+	int			frameLimit;
+	int			interval;
+	int			hashes;
+	bool8		renderThread;
+	bool		loaded;
+	u32			reportCrc;
+};
+
+static void headlessRunInstance(HeadlessInstance *instance)
+{
+	headlessFrameLimit	   = instance->frameLimit;
+	headlessInterval	   = instance->interval;
+	headlessHashes		   = instance->hashes;
+	cpuRenderThreadEnabled = instance->renderThread;
+
+	instance->loaded = headlessLoadRom(instance->romName, instance->biosFileName, instance->useBiosFile);
+	if (!instance->loaded)
+		return;
+
+	headlessStart();
+	headlessRun();
+	instance->reportCrc = headlessReportCrc;
+
+	theEmulator.emuCleanUp();
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	const char *biosFileName  = NULL;
+	const char *movieName	  = NULL;
+	const char *outputName	  = NULL;
+	const char *referenceName = NULL;
+	int			instances	  = 1;
+
+	int op;
+	while ((op = getopt_long(argc, argv, "ab:c:f:hi:m:n:o:rstv", headlessOptions, NULL)) != -1)
+	{
+		switch (op)
+		{
+		case 'a':
+			headlessHashes |= HEADLESS_HASH_AUDIO;
+			break;
+		case 'b':
+			biosFileName = optarg;
+			break;
+		case 'c':
+			referenceName = optarg;
+			break;
+		case 'f':
+			headlessFrameLimit = atoi(optarg);
+			break;
+		case 'h':
+			usage(argv[0]);
+			return HEADLESS_EXIT_OK;
+		case 'i':
+			headlessInterval = atoi(optarg);
+			break;
+		case 'm':
+			movieName = optarg;
+			break;
+		case 'n':
+			instances = atoi(optarg);
+			break;
+		case 'o':
+			outputName = optarg;
+			break;
+		case 'r':
+			headlessHashes |= HEADLESS_HASH_RAM;
+			break;
+		case 's':
+			headlessHashes |= HEADLESS_HASH_SCREEN;
+			break;
+		case 't':
+#ifdef MULTI_INSTANCE
+			cpuRenderThreadEnabled = true;
+#else
+			systemMessage(0, "--render-thread needs a build configured with --enable-multi-instance");
+			return HEADLESS_EXIT_LOAD;
+#endif
+			break;
+		case 'v':
+			systemVerbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return HEADLESS_EXIT_LOAD;
+		}
+	}
+
+	if (optind >= argc || (headlessFrameLimit <= 0 && movieName == NULL) || instances < 1)
+	{
+		usage(argv[0]);
+		return HEADLESS_EXIT_LOAD;
+	}
+
+	if (instances > 1)
+	{
+#ifdef MULTI_INSTANCE
+		// the other instances get no input
+		if (movieName)
+		{
+			systemMessage(0, "--instances can't be combined with --movie");
+			return HEADLESS_EXIT_LOAD;
+		}
+#else
+		systemMessage(0, "--instances needs a build configured with --enable-multi-instance");
+		return HEADLESS_EXIT_LOAD;
+#endif
+	}
+
+	if (headlessHashes == 0)
+		headlessHashes = HEADLESS_HASH_RAM;
+
+	headlessOutput = stdout;
+	if (outputName && (headlessOutput = fopen(outputName, "w")) == NULL)
+	{
+		systemMessage(0, "Cannot create %s", outputName);
+		return HEADLESS_EXIT_LOAD;
+	}
+
+	if (referenceName && (headlessReference = fopen(referenceName, "r")) == NULL)
+	{
+		systemMessage(0, "Cannot open %s", referenceName);
+		return HEADLESS_EXIT_LOAD;
+	}
+
+	for (int i = 0; i < 24; )
+	{
+		systemGbPalette[i++] = (0x1f) | (0x1f << 5) | (0x1f << 10);
+		systemGbPalette[i++] = (0x15) | (0x15 << 5) | (0x15 << 10);
+		systemGbPalette[i++] = (0x0c) | (0x0c << 5) | (0x0c << 10);
+		systemGbPalette[i++] = 0;
+	}
+	utilUpdateSystemColorMaps();
+
+	// a movie which was recorded with the BIOS must be played back with it
+	bool useBiosFile = biosFileName != NULL;
+	if (movieName)
+	{
+		SMovie info;
+		if (VBAMovieGetInfo(movieName, &info) != MOVIE_SUCCESS)
+		{
+			systemMessage(0, "Cannot read movie %s", movieName);
+			return HEADLESS_EXIT_MOVIE;
+		}
+		if (info.header.optionFlags & MOVIE_SETTING_USEBIOSFILE)
+		{
+			if (!biosFileName)
+			{
+				systemMessage(0, "This movie requires a GBA BIOS file (--bios)");
+				return HEADLESS_EXIT_MOVIE;
+			}
+			useBiosFile = true;
+		}
+	}
+
+	utilGetBaseName(argv[optind], filename);
+	char *p = strrchr(filename, '.');
+	if (p)
+		*p = 0;
+
+	if (!headlessLoadRom(argv[optind], biosFileName, useBiosFile))
+	{
+		systemMessage(0, "Failed to load file %s", argv[optind]);
+		return HEADLESS_EXIT_LOAD;
+	}
+
+	systemSoundOn = (headlessHashes & HEADLESS_HASH_AUDIO) != 0;
+	headlessStart();
+
+	if (movieName)
+	{
+		int code = VBAMovieOpen(movieName, true);
+		if (code != MOVIE_SUCCESS)
+		{
+			systemMessage(0, "Cannot play movie %s (error %d)", movieName, code);
+			return HEADLESS_EXIT_MOVIE;
+		}
+		headlessMovie = true;
+
+		if (systemCartridgeType == IMAGE_GBA)
+		{
+			rtcEnable(sdlRtcEnable != 0);
+			if (sdlFlashSize)
+				flashSetSize(sdlFlashSize);
+		}
+	}
+
+#ifdef MULTI_INSTANCE
+	std::vector<HeadlessInstance> others(instances - 1);
+	std::vector<std::thread>	  threads;
+	for (size_t i = 0; i < others.size(); i++)
+	{
+		HeadlessInstance &instance = others[i];
+		instance.romName	  = argv[optind];
+		instance.biosFileName = biosFileName;
+		instance.useBiosFile  = useBiosFile;
+		instance.frameLimit	  = headlessFrameLimit;
+		instance.interval	  = headlessInterval;
+		instance.hashes		  = headlessHashes;
+		instance.renderThread = cpuRenderThreadEnabled;
+		instance.loaded		  = false;
+		instance.reportCrc	  = 0;
+		threads.push_back(std::thread(headlessRunInstance, &instance));
+	}
+#endif
+
+	u32 elapsed = headlessRun();
+
+#ifdef MULTI_INSTANCE
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+		if (!others[i].loaded)
+		{
+			fprintf(stderr, "Instance %d failed to load the ROM\n", (int)i + 1);
+			headlessDesynced = true;
+		}
+		else if (others[i].reportCrc != headlessReportCrc)
+		{
+			fprintf(stderr, "Instance %d reported different hashes\n", (int)i + 1);
+			headlessDesynced = true;
+		}
+	}
+#endif
+
+	if (headlessReference && !headlessDesynced)
+	{
+		char extra[128];
+		if (fgets(extra, sizeof(extra), headlessReference))
+		{
+			fprintf(stderr, "Run ended at frame %d before the reference did\n", headlessFrame);
+			headlessDesynced = true;
+		}
+	}
+
+	if (systemVerbose)
+		fprintf(stderr, "%d frames in %u ms\n", headlessFrame, elapsed);
+
+	if (VBAMovieIsActive())
+		VBAMovieStop(true);
+	theEmulator.emuCleanUp();
+
+	if (headlessReference)
+		fclose(headlessReference);
+	if (headlessOutput != stdout)
+		fclose(headlessOutput);
+
+	return headlessDesynced ? HEADLESS_EXIT_DESYNC : HEADLESS_EXIT_OK;
+}
+
+static void headlessDebugOutput(const char *s, u32 addr)
+{
+	if (s)
+		fputs(s, stderr);
+}
+
+static void headlessDebugSignal(int sig, int number)
+{
+}
+
+void log(const char *msg, ...)
+{
+	va_list valist;
+	va_start(valist, msg);
+	vfprintf(stderr, msg, valist);
+	va_end(valist);
+}
+
+void systemMessage(int num, const char *msg, ...)
+{
+	va_list valist;
+	va_start(valist, msg);
+	vfprintf(stderr, msg, valist);
+	va_end(valist);
+	fputc('\n', stderr);
+}
+
+void systemScreenMessage(const char *msg, int slot, int duration, const char *colorList)
+{
+	if (systemVerbose)
+		fprintf(stderr, "%s\n", msg);
+}
+
+char *sdlGetFilename(char *name)
+{
+	static char filebuffer[2048];
+	utilGetBaseName(name, filebuffer);
+	return filebuffer;
+}
+
+// called by systemFrameBoundaryWork() before the frame is checked for drawing
+void systemFrame()
+{
+	++headlessFrame;
+
+	if (headlessNeedsReport(headlessFrame))
+		headlessReport();
+
+	// only render the frames whose screen is going to be hashed
+	headlessDrawFrame = (headlessHashes & HEADLESS_HASH_SCREEN) && headlessNeedsReport(headlessFrame + 1);
+
+	systemSaveUpdateCounter = SYSTEM_SAVE_NOT_UPDATED;
+}
+
+int systemFramesToSkip()
+{
+	return headlessDrawFrame ? 0 : 0x7fffffff;
+}
+
+void systemRenderFrame()
+{
+}
+
+void systemRenderLua(u8 *data, int pitch)
+{
+}
+
+void systemRefreshScreen()
+{
+}
+
+int systemScreenCapture(int captureNumber)
+{
+	return captureNumber;
+}
+
+void systemShowSpeed(int speed)
+{
+	systemSpeed = speed;
+}
+
+u32 systemGetClock()
+{
+	return (u32)((u64)clock() * 1000 / CLOCKS_PER_SEC);
+}
+
+bool systemReadJoypads()
+{
+	return true;
+}
+
+u32 systemGetOriginalJoypad(int which, bool sensor)
+{
+	return 0;
+}
+
+int systemGetDefaultJoypad()
+{
+	return 0;
+}
+
+bool systemIsEmulating()
+{
+	return emulating != 0;
+}
+
+bool systemIsRunningGBA()
+{
+	return systemCartridgeType == IMAGE_GBA;
+}
+
+bool systemIsPaused()
+{
+	return false;
+}
+
+void systemSetPause(bool pause)
+{
+}
+
+bool systemPausesNextFrame()
+{
+	return false;
+}
+
+void systemGbBorderOn()
+{
+}
+
+void systemGbPrint(u8 *data, int pages, int feed, int palette, int contrast)
+{
+}
+
+bool systemSoundInit()
+{
+	return true;
+}
+
+void systemSoundShutdown()
+{
+}
+
+void systemSoundPause()
+{
+}
+
+void systemSoundResume()
+{
+}
+
+bool systemSoundAppliesDSP()
+{
+	return false;
+}
+
+void systemSoundWriteToBuffer()
+{
+	headlessAudioCrc = crc32(headlessAudioCrc, (const Bytef *)soundFinalWave, soundBufferLen);
+}
+
+void systemSoundClearBuffer()
+{
+}
@@ -36,10 +36,12 @@
 #include "gba/GBASound.h"
 #include "gb/GB.h"
 #include "gb/gbGlobals.h"
+#include "common/ColorConvert.h"
 #include "common/Text.h"
 #include "common/unzip.h"
 #include "common/Util.h"
 #include "common/movie.h"
+#include "common/Rewind.h"
 #include "common/System.h"
 #include "common/inputGlobal.h"
 #include "../common/vbalua.h"
@@ -190,15 +192,13 @@ char captureDir[2048];
 char saveDir[2048];
 char batteryDir[2048];
 
-static char *rewindMemory = NULL;
-static int rewindPos = 0;
-static int rewindTopPos = 0;
+static bool rewindEnabled = false;
 static int rewindCounter = 0;
-static int rewindCount = 0;
 static bool rewindSaveNeeded = false;
 static int rewindTimer = 0;
-
-#define REWIND_SIZE 400000
+static int rewindFrames = 0;
+static int rewindSlots = 0x100;
+static int rewindBufferSize = 0x1000;
 
 #define _stricmp strcasecmp
 
@@ -236,6 +236,8 @@ int renderedFrames = 0;
 
 int throttle = 0;
 u32 throttleLastTime = 0;
+int dynamicRateControl = 0;
+double dynamicRateNextFrame = 0;
 u32 autoFrameSkipLastTime = 0;
 
 int showSpeed = 1;
@@ -323,6 +325,7 @@ struct option sdlOptions[] = {
   { "bios", required_argument, 0, 'b' },
   { "config", required_argument, 0, 'c' },
   { "debug", no_argument, 0, 'd' },
+  { "dynamic-rate", no_argument, &dynamicRateControl, 1 },
   { "filter", required_argument, 0, 'f' },
   { "filter-normal", no_argument, &filter, 0 },
   { "filter-tv-mode", no_argument, &filter, 1 },
@@ -352,6 +355,7 @@ struct option sdlOptions[] = {
   { "no-agb-print", no_argument, &sdlAgbPrint, 0 },
   { "no-auto-frameskip", no_argument, &autoFrameSkip, 0 },
   { "no-debug", no_argument, 0, 'N' },
+  { "no-dynamic-rate", no_argument, &dynamicRateControl, 0 },
   { "no-ips", no_argument, &sdlAutoIPS, 0 },
   { "no-mmx", no_argument, &disableMMX, 1 },
   { "no-pause-when-inactive", no_argument, &pauseWhenInactive, 0 },
@@ -1201,6 +1205,8 @@ void sdlReadPreferences(FILE *f)
       throttle = sdlFromHex(value);
       if(throttle != 0 && (throttle < 5 || throttle > 1000))
         throttle = 0;
+    } else if(!strcmp(key, "dynamicRateControl")) {
+      dynamicRateControl = sdlFromHex(value);
     } else if(!strcmp(key, "disableMMX")) {
 #ifdef MMX
       cpu_mmx = sdlFromHex(value) ? false : true;
@@ -1216,8 +1222,27 @@ void sdlReadPreferences(FILE *f)
       if(rewindTimer < 0 || rewindTimer > 600)
         rewindTimer = 0;
       rewindTimer *= 6;  // convert value to 10 frames multiple
+    } else if(!strcmp(key, "rewindFrames")) {
+      rewindFrames = sdlFromHex(value);
+    } else if(!strcmp(key, "rewindSlots")) {
+      rewindSlots = sdlFromHex(value);
+    } else if(!strcmp(key, "rewindBufferSize")) {
+      rewindBufferSize = sdlFromHex(value);
     } else if(!strcmp(key, "enhancedDetection")) {
       cpuEnhancedDetection = sdlFromHex(value) ? true : false;
+    } else if(!strcmp(key, "blockCache")) {
+      cpuBlockCacheEnabled = sdlFromHex(value) ? true : false;
+    } else if(!strcmp(key, "thumbJit")) {
+      cpuThumbJitEnabled = sdlFromHex(value) ? true : false;
+    } else if(!strcmp(key, "idleLoopSkip")) {
+      cpuIdleLoopSkip = sdlFromHex(value) ? true : false;
+    } else if(!strcmp(key, "renderThread")) {
+#ifdef MULTI_INSTANCE
+      cpuRenderThreadEnabled = sdlFromHex(value) ? true : false;
+#else
+      if(sdlFromHex(value))
+        fprintf(stderr, "renderThread needs a build configured with --enable-multi-instance, ignored\n");
+#endif
     } else {
       fprintf(stderr, "Unknown configuration key %s\n", key);
     }
@@ -1741,12 +1766,7 @@ void sdlPollEvents()
       case SDLK_b:
         if(!(event.key.keysym.mod & MOD_NOCTRL) &&
            (event.key.keysym.mod & KMOD_CTRL)) {
-          if(emulating && theEmulator.emuReadMemState && rewindMemory 
-             && rewindCount) {
-            rewindPos = --rewindPos & 7;
-            theEmulator.emuReadMemState(&rewindMemory[REWIND_SIZE*rewindPos], 
-                                     REWIND_SIZE);
-            rewindCount--;
+          if(emulating && rewindLoad(theEmulator)) {
             rewindCounter = 0;
             systemScreenMessage("Rewind");
           }
@@ -1939,11 +1959,13 @@ Options:\n\
 Long options only:\n\
       --agb-print              Enable AGBPrint support\n\
       --auto-frameskip         Enable auto frameskipping\n\
+      --dynamic-rate           Pace frames by the clock and stretch the sound\n\
       --ifb-none               No interframe blending\n\
       --ifb-motion-blur        Interframe motion blur\n\
       --ifb-smart              Smart interframe blending\n\
       --no-agb-print           Disable AGBPrint support\n\
       --no-auto-frameskip      Disable auto frameskipping\n\
+      --no-dynamic-rate        Pace frames by the sound buffer\n\
       --no-ips                 Do not apply IPS patch\n\
       --no-mmx                 Disable MMX support\n\
       --no-pause-when-inactive Don't pause when inactive\n\
@@ -2281,8 +2303,10 @@ int main(int argc, char **argv)
     cpu_mmx = 0;
 #endif
 
+  if(rewindFrames > 0)
+    rewindTimer = rewindFrames;
   if(rewindTimer)
-    rewindMemory = (char *)malloc(8*REWIND_SIZE);
+    rewindEnabled = rewindInit(rewindBufferSize << 10, rewindSlots);
 
   if(sdlFlashSize == 0)
     flashSetSize(0x10000);
@@ -2453,12 +2477,9 @@ int main(int argc, char **argv)
           (((i & 0x7c0) >> 6) << systemGreenShift) |
           (((i & 0xf800) >> 11) << systemRedShift);  
       }      
+      colorMapPlain = false;
     } else {
-      for(int i = 0; i < 0x10000; i++) {
-        systemColorMap16[i] = ((i & 0x1f) << systemRedShift) |
-          (((i & 0x3e0) >> 5) << systemGreenShift) |
-          (((i & 0x7c00) >> 10) << systemBlueShift);  
-      }
+      utilUpdateSystemColorMaps();
     }
     srcPitch = srcWidth * 2+4;
   } else {
@@ -2468,11 +2489,7 @@ int main(int argc, char **argv)
     if(systemColorDepth == 32) {
       Init_2xSaI(32);
     }
-    for(int i = 0; i < 0x10000; i++) {
-      systemColorMap32[i] = ((i & 0x1f) << systemRedShift) |
-        (((i & 0x3e0) >> 5) << systemGreenShift) |
-        (((i & 0x7c00) >> 10) << systemBlueShift);  
-    }
+    utilUpdateSystemColorMaps();
     if(systemColorDepth == 32)
       srcPitch = srcWidth*4 + 4;
     else
@@ -2651,18 +2668,8 @@ int main(int argc, char **argv)
         dbgMain();
       else {
         theEmulator.emuMain(theEmulator.emuCount);
-        if(rewindSaveNeeded && rewindMemory && theEmulator.emuWriteMemState) {
-          rewindCount++;
-          if(rewindCount > 8)
-            rewindCount = 8;
-          if(theEmulator.emuWriteMemState &&
-             theEmulator.emuWriteMemState(&rewindMemory[rewindPos*REWIND_SIZE], 
-                                       REWIND_SIZE)) {
-            rewindPos = ++rewindPos & 7;
-            if(rewindCount == 8)
-              rewindTopPos = ++rewindTopPos & 7;
-          }
-        }
+        if(rewindSaveNeeded)
+          rewindSave(theEmulator);
 
         rewindSaveNeeded = false;
       }
@@ -2687,6 +2694,8 @@ int main(int argc, char **argv)
     theEmulator.emuCleanUp();
   }
 
+  rewindCleanUp();
+
   if(delta) {
     free(delta);
     delta = NULL;
@@ -3021,7 +3030,20 @@ void systemFrame(/*int rate*/) //Looking at System.cpp, it looks like rate shoul
     throttleLastTime = systemGetClock();
     */
   }
-  if(rewindMemory) {
+  if(!wasPaused && dynamicRateControl && !speedup) {
+    // The sound driver no longer holds the emulator back in this mode, so
+    // pace the frames here (280896 cycles at 16.78 MHz, the same period
+    // on the GB) and let it stretch the sound to match
+    double period = (1000.0 * 280896 / 16777216) * 100 / (throttle ? throttle : 100);
+    double now = systemGetClock();
+
+    dynamicRateNextFrame += period;
+    if(dynamicRateNextFrame < now - 100 || dynamicRateNextFrame > now + 100)
+      dynamicRateNextFrame = now;
+    else if(dynamicRateNextFrame > now)
+      SDL_Delay((u32)(dynamicRateNextFrame - now));
+  }
+  if(rewindEnabled) {
     if(++rewindCounter >= rewindTimer) {
       rewindSaveNeeded = true;
       rewindCounter = 0;
@@ -3517,12 +3539,9 @@ void systemGbBorderOn()
           (((i & 0x7c0) >> 6) << systemGreenShift) |
           (((i & 0xf800) >> 11) << systemRedShift);  
       }      
+      colorMapPlain = false;
     } else {
-      for(int i = 0; i < 0x10000; i++) {
-        systemColorMap16[i] = ((i & 0x1f) << systemRedShift) |
-          (((i & 0x3e0) >> 5) << systemGreenShift) |
-          (((i & 0x7c00) >> 10) << systemBlueShift);  
-      }
+      utilUpdateSystemColorMaps();
     }
     srcPitch = srcWidth * 2+4;
   } else {
@@ -3532,11 +3551,7 @@ void systemGbBorderOn()
     if(systemColorDepth == 32) {
       Init_2xSaI(32);
     }
-    for(int i = 0; i < 0x10000; i++) {
-      systemColorMap32[i] = ((i & 0x1f) << systemRedShift) |
-        (((i & 0x3e0) >> 5) << systemGreenShift) |
-        (((i & 0x7c00) >> 10) << systemBlueShift);  
-    }
+    utilUpdateSystemColorMaps();
     if(systemColorDepth == 32)
       srcPitch = srcWidth*4 + 4;
     else
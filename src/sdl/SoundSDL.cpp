@@ -17,16 +17,30 @@
 
 #include "SoundSDL.h"
 
+// defined INSTANCE_LOCAL in common/SystemGlobals.cpp; Port.h can't be
+// included next to Types.h, so this mirrors its MULTI_INSTANCE switch
+#ifdef MULTI_INSTANCE
+extern thread_local int emulating;
+extern thread_local u8 speedup;
+#else
 extern int emulating;
-extern bool speedup;
+extern u8 speedup;
+#endif
+extern int dynamicRateControl;
 
 // Hold up to 100 ms of data in the ring buffer
 const float SoundSDL::_delay = 0.1f;
 
+// Stretch the sound by at most 0.5% when not syncing to audio
+const float SoundSDL::_maxRateDelta = 0.005f;
+
 SoundSDL::SoundSDL():
 	_rbuf(0),
+	_freq(SDL_SAMPLE_RATE),
+	_ratePos(0),
 	_initialized(false)
 {
+	_rateLast[0] = _rateLast[1] = 0;
 
 }
 
@@ -40,11 +54,7 @@ void SoundSDL::read(u16 * stream, int length)
 	if (!_initialized || length <= 0 || !emulating)
 		return;
 
-	SDL_mutexP(_mutex);
 	_rbuf.read(stream, std::min(static_cast<std::size_t>(length) / 2, _rbuf.used()));
-
-	SDL_CondSignal(_cond);
-	SDL_mutexV(_mutex);
 }
 
 void SoundSDL::write(u16 * finalWave, int length)
@@ -55,7 +65,11 @@ void SoundSDL::write(u16 * finalWave, int length)
 	if (SDL_GetAudioStatus() != SDL_AUDIO_PLAYING)
 		SDL_PauseAudio(0);
 
-	SDL_mutexP(_mutex);
+	if (dynamicRateControl)
+	{
+		writeResampled(finalWave, length / 4);
+		return;
+	}
 
 	unsigned int samples = length / 4;
 
@@ -71,19 +85,74 @@ void SoundSDL::write(u16 * finalWave, int length)
 		// by waiting till there is enough room in the buffer
 		if (emulating && !speedup)
 		{
-			SDL_CondWait(_cond,_mutex);
+			// Sleep for about as long as the callback needs to drain the
+			// rest, rather than polling it
+			SDL_Delay(std::max(1, static_cast<int>(samples * 1000 / _freq)));
 		}
 		else
 		{
 			// Drop the remaining of the audio data
-			SDL_mutexV(_mutex);
 			return;
 		}
 	}
 
 	_rbuf.write(finalWave, samples * 2);
+}
+
+void SoundSDL::writeResampled(const u16 * finalWave, unsigned int samples)
+{
+	if (samples == 0)
+		return;
+
+	const std::size_t capacity = _rbuf.size() / 2;
+	std::size_t       fill     = capacity - _rbuf.avail() / 2;
+
+	u16          out[2 * 256];
+	unsigned int n = 0;
+
+	// The callback ran dry (start up, or the emulator stalled). Put the
+	// fill back at the target with silence, the rate control alone would
+	// take seconds to get there
+	if (fill == 0)
+	{
+		memset(out, 0, sizeof(out));
+		for (fill = 0; fill < capacity / 2; fill += 256)
+			_rbuf.write(out, std::min<std::size_t>(256, capacity / 2 - fill) * 2);
+		fill = capacity - _rbuf.avail() / 2;
+	}
 
-	SDL_mutexV(_mutex);
+	// Produce a little more than we were given while the buffer is under
+	// half full, a little less above it
+	const double ratio = 1.0 + _maxRateDelta * (1.0 - 2.0 * fill / capacity);
+	const u32    step  = static_cast<u32>(65536.0 / ratio);
+
+	// Linear interpolation; position 0 is the last frame of the previous
+	// call, position k is frame k - 1 of this one
+	const s16 *in = reinterpret_cast<const s16 *>(finalWave);
+	while ((_ratePos >> 16) < samples)
+	{
+		const u32 i = _ratePos >> 16;
+		const int f = (_ratePos & 0xffff) >> 1;
+		for (int c = 0; c < 2; c++)
+		{
+			const int a = i ? in[(i - 1) * 2 + c] : _rateLast[c];
+			const int b = in[i * 2 + c];
+			out[n * 2 + c] = static_cast<u16>(a + (((b - a) * f) >> 15));
+		}
+		_ratePos += step;
+
+		if (++n == 256)
+		{
+			_rbuf.write(out, std::min<std::size_t>(n, _rbuf.avail() / 2) * 2);
+			n = 0;
+		}
+	}
+	// Whatever does not fit is dropped, this never waits for the callback
+	_rbuf.write(out, std::min<std::size_t>(n, _rbuf.avail() / 2) * 2);
+
+	_ratePos    -= samples << 16;
+	_rateLast[0] = in[(samples - 1) * 2];
+	_rateLast[1] = in[(samples - 1) * 2 + 1];
 }
 
 
@@ -105,8 +174,7 @@ bool SoundSDL::init()
 
 	_rbuf.reset(_delay * SDL_SAMPLE_RATE * 2);
 
-	_cond  = SDL_CreateCond();
-	_mutex = SDL_CreateMutex();
+	_freq = audio.freq;
 	_initialized = true;
 
 	return true;
@@ -117,21 +185,7 @@ SoundSDL::~SoundSDL()
 	if (!_initialized)
 		return;
 
-	SDL_mutexP(_mutex);
-	int iSave = emulating;
-	emulating = 0;
-	SDL_CondSignal(_cond);
-	SDL_mutexV(_mutex);
-
-	SDL_DestroyCond(_cond);
-	_cond = NULL;
-
-	SDL_DestroyMutex(_mutex);
-	_mutex = NULL;
-
 	SDL_CloseAudio();
-
-	emulating = iSave;
 }
 
 void SoundSDL::pause()
@@ -174,5 +228,6 @@ bool SoundSDL::setThrottle(unsigned short throttle){
 	audio.callback = soundCallback;
 	audio.userdata = this;
 	_rbuf.reset((_delay * SDL_SAMPLE_RATE * throttle * 2)/100);
+	_freq = audio.freq;
 	return !SDL_OpenAudio(&audio,NULL);
 }
@@ -19,7 +19,7 @@
 #define __VBA_SOUND_SDL_H__
 
 #include "SoundDriver.h"
-#include "RingBuffer.h"
+#include "SpscRingBuffer.h"
 
 #include <SDL.h>
 
@@ -39,18 +39,28 @@ public:
 	virtual bool setThrottle(unsigned short throttle);
 
 //private:
-	RingBuffer<u16> _rbuf;
+	// Filled by the emulator, drained by the audio callback
+	SpscRingBuffer<u16> _rbuf;
 
-	SDL_cond  * _cond;
-	SDL_mutex * _mutex;
+	// Rate the callback drains _rbuf at, in sample frames per second
+	int _freq;
+
+	// Resampler state for dynamic rate control: 16.16 position into the
+	// next block, and the last frame of the previous one
+	u32 _ratePos;
+	s16 _rateLast[2];
 
 	bool _initialized;
 
 	// Defines what delay in seconds we keep in the sound buffer
 	static const float _delay;
 
+	// Largest resampling ratio change used by dynamic rate control
+	static const float _maxRateDelta;
+
 	static void soundCallback(void *data, u8 *stream, int length);
 	virtual void read(u16 * stream, int length);
+	void writeResampled(const u16 * finalWave, unsigned int samples);
 };
 
 #endif // __VBA_SOUND_SDL_H__
@@ -0,0 +1,126 @@
+// VisualBoyAdvance - Nintendo Gameboy/GameboyAdvance (TM) emulator.
+// Copyright (C) 2008 VBA-M development team
+
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2, or(at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+#ifndef __VBA_SPSC_RING_BUFFER_H__
+#define __VBA_SPSC_RING_BUFFER_H__
+
+#include "Array.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+/**
+ * Ring buffer shared by exactly one writer thread and one reader thread
+ * without a lock. Each side owns one index and only publishes it after
+ * copying, so the other side never sees a slot before its data. The two
+ * indices sit on separate cache lines so that the audio callback moving
+ * the read index does not keep stealing the line the emulator writes.
+ *
+ * reset() must not race with read() or write().
+ */
+template<typename T>
+class SpscRingBuffer
+{
+	enum { CACHE_LINE = 64 };
+
+	Array<T>    buf;
+	std::size_t sz;
+
+	alignas(CACHE_LINE) std::atomic<std::size_t> wpos;
+	alignas(CACHE_LINE) std::atomic<std::size_t> rpos;
+	char pad[CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+
+	SpscRingBuffer(const SpscRingBuffer &);
+	SpscRingBuffer &operator=(const SpscRingBuffer &);
+
+	std::size_t distance(std::size_t from, std::size_t to) const
+	{
+		return (to < from ? sz : 0) + to - from;
+	}
+
+public:
+	SpscRingBuffer(const std::size_t sz_in = 0) : sz(1), wpos(0), rpos(0)
+	{
+		reset(sz_in);
+	}
+
+	/** Room left for the writer */
+	std::size_t avail() const
+	{
+		return sz - 1 - distance(rpos.load(std::memory_order_acquire), wpos.load(std::memory_order_relaxed));
+	}
+
+	/** Data waiting for the reader */
+	std::size_t used() const
+	{
+		return distance(rpos.load(std::memory_order_relaxed), wpos.load(std::memory_order_acquire));
+	}
+
+	std::size_t size() const
+	{
+		return sz - 1;
+	}
+
+	void reset(const std::size_t sz_in)
+	{
+		sz = sz_in + 1;
+		buf.reset(sz_in ? sz : 0);
+		wpos.store(0, std::memory_order_relaxed);
+		rpos.store(0, std::memory_order_relaxed);
+	}
+
+	/** Writer side; num must not exceed avail() */
+	void write(const T *in, std::size_t num)
+	{
+		std::size_t w = wpos.load(std::memory_order_relaxed);
+		if (w + num > sz)
+		{
+			const std::size_t n = sz - w;
+			std::memcpy(buf + w, in, n * sizeof(T));
+			w    = 0;
+			num -= n;
+			in  += n;
+		}
+
+		std::memcpy(buf + w, in, num * sizeof(T));
+		if ((w += num) == sz)
+			w = 0;
+		wpos.store(w, std::memory_order_release);
+	}
+
+	/** Reader side; num must not exceed used() */
+	void read(T *out, std::size_t num)
+	{
+		std::size_t r = rpos.load(std::memory_order_relaxed);
+		if (r + num > sz)
+		{
+			const std::size_t n = sz - r;
+			std::memcpy(out, buf + r, n * sizeof(T));
+			r    = 0;
+			num -= n;
+			out += n;
+		}
+
+		std::memcpy(out, buf + r, num * sizeof(T));
+		if ((r += num) == sz)
+			r = 0;
+		rpos.store(r, std::memory_order_release);
+	}
+};
+
+#endif // __VBA_SPSC_RING_BUFFER_H__
@@ -68,7 +68,7 @@ int systemGreenShift = 8;
 int systemColorDepth = 32;
 int systemDebug = 0;
 int systemVerbose = 0;
-int systemSaveUpdateCounter = SYSTEM_SAVE_NOT_UPDATED;
+INSTANCE_LOCAL int systemSaveUpdateCounter = SYSTEM_SAVE_NOT_UPDATED;
 
 int sensorX = 2047;
 int sensorY = 2047;
@@ -302,11 +302,7 @@ int main(int argc, char **argv)
   } else {
   }
 
-  for(int i = 0; i < 0x10000; i++) {
-    systemColorMap32[i] = ((i & 0x1f) << systemRedShift) |
-      (((i & 0x3e0) >> 5) << systemGreenShift) |
-      (((i & 0x7c00) >> 10) << systemBlueShift);  
-  }
+  utilUpdateSystemColorMaps();
 
   emulating = 1;
   soundInit();
@@ -30,12 +30,10 @@ extern "C" {
 #include "gba/armdis.h"
 #include "gba/elf.h"
 #include "common/System.h"
+#include "common/SystemGlobals.h"
 #include "exprNode.h"
 
 extern bool debugger;
-extern int emulating;
-
-extern struct EmulatedSystem theEmulator;
 
 #define debuggerReadMemory(addr) \
   READ32LE((&map[(addr)>>24].address[(addr) & map[(addr)>>24].mask]))
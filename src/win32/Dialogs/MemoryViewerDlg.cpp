@@ -10,6 +10,7 @@
 #include "../WinResUtil.h"
 #include "../VBA.h"
 
+#include "../../gba/GBA.h"
 #include "../../common/SystemGlobals.h"
 #include "../../gba/GBAinline.h"
 #include "../../gba/GBAGlobals.h"
@@ -62,6 +63,9 @@ void GBAMemoryViewer::editData(u32 address, int size, int mask, u32 value)
 		CPUWriteMemoryQuick(address, oldValue);
 		break;
 	}
+#ifndef USE_GBA_CORE_V7
+	CPUExternalWrite(address, size >> 3);
+#endif
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -425,6 +429,10 @@ void MemoryViewerDlg::OnLoad()
 				CPUWriteByteQuick(addr, c);
 				addr++;
 			}
+#ifndef USE_GBA_CORE_V7
+			if (addr != dlg.getAddress())
+				CPUExternalWrite(dlg.getAddress(), addr - dlg.getAddress());
+#endif
 			OnRefresh();
 		}
 		fclose(f);
@@ -9,6 +9,7 @@
 #include "../gba/GBAGlobals.h"
 #include "../gb/gbGlobals.h"
 #include "../common/SystemGlobals.h"
+#include "../common/Util.h"
 #include "../common/Text.h"
 #include "../version.h"
 
@@ -130,30 +131,7 @@ bool GDIDisplay::initialize()
 		cpu_mmx = 0;
 #endif
 
-	switch (systemColorDepth)
-	{
-	case 16:
-	{
-		for (int i = 0; i < 0x10000; i++)
-		{
-			systemColorMap16[i] = ((i & 0x1f) << systemRedShift) |
-			                      (((i & 0x3e0) >> 5) << systemGreenShift) |
-			                      (((i & 0x7c00) >> 10) << systemBlueShift);
-		}
-		break;
-	}
-	case 24:
-	case 32:
-	{
-		for (int i = 0; i < 0x10000; i++)
-		{
-			systemColorMap32[i] = ((i & 0x1f) << systemRedShift) |
-			                      (((i & 0x3e0) >> 5) << systemGreenShift) |
-			                      (((i & 0x7c00) >> 10) << systemBlueShift);
-		}
-		break;
-	}
-	}
+	utilUpdateSystemColorMaps();
 	theApp.updateFilter();
 	theApp.updateIFB();
 
@@ -1934,6 +1934,9 @@ void VBA::loadSettings()
 		winFlashSize = 0x10000;
 
 	cpuDisableSfx = regQueryDwordValue("disableSfx", 0) ? true : false;
+	cpuBlockCacheEnabled = regQueryDwordValue("blockCache", 0) ? true : false;
+	cpuThumbJitEnabled	 = regQueryDwordValue("thumbJit", 0) ? true : false;
+	cpuIdleLoopSkip		 = regQueryDwordValue("idleLoopSkip", 0) ? true : false;
 
 	// GBx
 	winGbPrinterEnabled = regQueryDwordValue("gbPrinter", false) ? true : false;
@@ -2158,6 +2161,9 @@ void VBA::saveSettings()
 	regSetDwordValue("flashSize", winFlashSize);
 
 	regSetDwordValue("disableSfx", cpuDisableSfx);
+	regSetDwordValue("blockCache", cpuBlockCacheEnabled);
+	regSetDwordValue("thumbJit", cpuThumbJitEnabled);
+	regSetDwordValue("idleLoopSkip", cpuIdleLoopSkip);
 
 	// GBx
 	regSetDwordValue("emulatorType", gbEmulatorType);